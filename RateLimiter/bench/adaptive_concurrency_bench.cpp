@@ -0,0 +1,176 @@
+// Static rate limit vs adaptive concurrency limit in front of a simulated
+// backend, on a simulated clock.
+//
+// Build: g++ -std=c++17 -O2 bench/adaptive_concurrency_bench.cpp -o adaptive_concurrency_bench
+// Usage: ./adaptive_concurrency_bench [workers=50] [serviceMs=10] [seed=23]
+//
+// The backend serves `workers` requests at a time, each taking an
+// exponentially distributed time (mean serviceMs), and queues the rest
+// FIFO, so its capacity is workers / serviceMs. Clients give up after
+// 1 s, but the backend still works through what it queued. Four 10 s
+// phases of Poisson arrivals, in multiples of normal capacity C:
+//
+//   normal     0.6 C offered
+//   spike      1.6 C offered
+//   slowdown   0.6 C offered, service time 2.5x (capacity 0.4 C)
+//   recovered  0.6 C offered
+//
+// Limiters, all fed every completion through RateLimiter::onComplete:
+//
+//   none       admits everything
+//   token      TokenBucketRateLimiter at 0.9 C per second, tuned for the
+//              healthy backend
+//   adaptive   AdaptiveConcurrencyLimiter, 1 s latency counts as a drop
+//
+// Per phase: admitted and goodput (answered within the 1 s timeout) per
+// second, and latency of the requests that completed in the phase.
+//
+// First it checks that a key rejected before its first batch has ended gets
+// a retry-after built from the latency floor (timeoutNanos, then the
+// completions seen so far) rather than 1 ns; main returns 1 if not.
+#include <bits/stdc++.h>
+#include "../include/TokenBucketRateLimiter.h"
+#include "../include/AdaptiveConcurrencyLimiter.h"
+using namespace std;
+
+static const int64_t MS = 1000000;
+static const int64_t SECOND = 1000 * MS;
+static const int64_t TIMEOUT = SECOND;
+static const int64_t PHASE = 10 * SECOND;
+static const char *PHASES[] = {"normal", "spike", "slowdown", "recovered"};
+
+struct PhaseStats
+{
+    uint64_t offered = 0, admitted = 0, good = 0, late = 0;
+    vector<int64_t> latencies;
+};
+
+struct Event
+{
+    int64_t at;
+    int64_t admittedAt;     // -1 for an arrival
+    bool operator>(const Event &other) const { return at > other.at; }
+};
+
+static array<PhaseStats, 4> simulate(RateLimiter &limiter, SimulatedClock &clock, int workers, double serviceMs,
+                                     uint64_t seed)
+{
+    mt19937_64 rng(seed);
+    double capacity = workers * 1000.0 / serviceMs;
+    const double offered[] = {0.6, 1.6, 0.6, 0.6};
+    const double slowdown[] = {1, 1, 2.5, 1};
+    auto phaseOf = [](int64_t t) { return min<int64_t>(t / PHASE, 3); };
+
+    array<PhaseStats, 4> stats;
+    priority_queue<Event, vector<Event>, greater<Event>> events;
+    deque<int64_t> waiting;     // admission times of queued requests
+    int busy = 0;
+    exponential_distribution<double> unit(1.0);
+
+    auto startService = [&](int64_t now, int64_t admittedAt)
+    {
+        busy++;
+        double mean = serviceMs * slowdown[phaseOf(now)] * MS;
+        events.push({now + static_cast<int64_t>(unit(rng) * mean), admittedAt});
+    };
+
+    events.push({0, -1});
+    while (!events.empty())
+    {
+        Event event = events.top();
+        events.pop();
+        clock.set(event.at);
+        if (event.admittedAt < 0)
+        {
+            if (event.at >= 4 * PHASE)
+                continue;
+            int phase = phaseOf(event.at);
+            stats[phase].offered++;
+            events.push({event.at + static_cast<int64_t>(unit(rng) / (offered[phase] * capacity) * SECOND), -1});
+            if (!limiter.allowRequest("backend"))
+                continue;
+            stats[phase].admitted++;
+            if (busy < workers)
+                startService(event.at, event.at);
+            else
+                waiting.push_back(event.at);
+            continue;
+        }
+        int64_t latency = event.at - event.admittedAt;
+        PhaseStats &done = stats[phaseOf(event.at)];
+        done.latencies.push_back(latency);
+        (latency < TIMEOUT ? done.good : done.late)++;
+        limiter.onComplete("backend", latency);
+        busy--;
+        if (!waiting.empty())
+        {
+            int64_t admittedAt = waiting.front();
+            waiting.pop_front();
+            startService(event.at, admittedAt);
+        }
+    }
+    return stats;
+}
+
+static bool coldRetryAfterIsFloored()
+{
+    AdaptiveLimitParams params;
+    params.initialLimit = params.minLimit = 2;
+    params.timeoutNanos = TIMEOUT;
+    AdaptiveConcurrencyLimiter limiter(params);
+    limiter.tryAcquire("cold", 2);
+    int64_t beforeAny = limiter.tryAcquire("cold", 1).retryAfterNanos;
+    limiter.onComplete("cold", 40 * MS);
+    int64_t afterOne = limiter.tryAcquire("cold", 2).retryAfterNanos;
+    if (beforeAny != TIMEOUT / 2 || afterOne != 40 * MS)
+    {
+        cerr << "cold retry-after " << beforeAny << " ns before any completion, " << afterOne
+             << " ns after one; want " << TIMEOUT / 2 << " and " << 40 * MS << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!coldRetryAfterIsFloored())
+        return 1;
+
+    int workers = argc > 1 ? stoi(argv[1]) : 50;
+    double serviceMs = argc > 2 ? stod(argv[2]) : 10;
+    uint64_t seed = argc > 3 ? stoull(argv[3]) : 23;
+    double capacity = workers * 1000.0 / serviceMs;
+
+    cout << "backend: " << workers << " workers, " << serviceMs << " ms mean service, capacity " << capacity
+         << "/s\n\n";
+    cout << left << setw(10) << "limiter" << setw(11) << "phase" << setw(10) << "offered" << setw(10) << "admitted"
+         << setw(10) << "goodput" << setw(8) << "late" << setw(9) << "p50 ms" << "p99 ms\n";
+    for (const string name : {"none", "token", "adaptive"})
+    {
+        SimulatedClock clock;
+        unique_ptr<RateLimiter> limiter;
+        if (name == "token")
+            limiter = make_unique<TokenBucketRateLimiter>(static_cast<int>(0.9 * capacity), 1, clock);
+        else
+        {
+            AdaptiveLimitParams params;
+            params.timeoutNanos = TIMEOUT;
+            if (name == "none")
+                params.initialLimit = params.minLimit = params.maxLimit = INT_MAX / 2;
+            limiter = make_unique<AdaptiveConcurrencyLimiter>(params);
+        }
+        array<PhaseStats, 4> stats = simulate(*limiter, clock, workers, serviceMs, seed);
+        for (int p = 0; p < 4; p++)
+        {
+            PhaseStats &s = stats[p];
+            sort(s.latencies.begin(), s.latencies.end());
+            auto at = [&](double q)
+            { return s.latencies.empty() ? 0.0 : s.latencies[static_cast<size_t>(q * (s.latencies.size() - 1))] / 1e6; };
+            double seconds = PHASE / 1e9;
+            cout << left << setw(10) << (p ? "" : name) << setw(11) << PHASES[p] << fixed << setprecision(0)
+                 << setw(10) << s.offered / seconds << setw(10) << s.admitted / seconds << setw(10)
+                 << s.good / seconds << setw(8) << s.late << setprecision(1) << setw(9) << at(0.5) << at(0.99) << "\n";
+        }
+    }
+    return 0;
+}
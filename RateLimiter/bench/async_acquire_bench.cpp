@@ -0,0 +1,91 @@
+// Many concurrent waiters shaped by one AsyncRateLimiter and its single
+// timer thread.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/async_acquire_bench.cpp -o async_acquire_bench
+// Usage: ./async_acquire_bench [waiters=20000] [keys=100] [ratePerKey=100] [tickUs=1000]
+//
+// Every key gets waiters / keys unit requests at once against an
+// AtomicTokenBucketRateLimiter of ratePerKey tokens per second (starting
+// full). The n-th request of a key can first be admitted at
+// max(0, n - ratePerKey + 1) / ratePerKey seconds; "late" is how long after
+// that it completed. "fifo" counts completions that overtook an earlier
+// request of the same key.
+#include <bits/stdc++.h>
+#include "../include/AsyncRateLimiter.h"
+#include "../include/AtomicTokenBucketRateLimiter.h"
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    size_t waiters = argc > 1 ? stoull(argv[1]) : 20000;
+    size_t keys = argc > 2 ? stoull(argv[2]) : 100;
+    int rate = argc > 3 ? stoi(argv[3]) : 100;
+    int64_t tickNanos = (argc > 4 ? stoll(argv[4]) : 1000) * 1000;
+    size_t perKey = max<size_t>(1, waiters / keys);
+
+    vector<string> names(keys);
+    for (size_t k = 0; k < keys; k++)
+        names[k] = "batch_" + to_string(k);
+
+    vector<int64_t> done(keys * perKey, 0);
+    vector<size_t> lastIndex(keys, 0);
+    atomic<size_t> completed{0};
+    size_t fifoViolations = 0, immediate = 0;
+    mutex doneMutex;
+    condition_variable allDone;
+
+    AsyncRateLimiter limiter(make_unique<AtomicTokenBucketRateLimiter>(rate, 1), systemClock(), tickNanos);
+    int64_t start = monotonicNanos();
+    for (size_t n = 0; n < perKey; n++)
+    {
+        for (size_t k = 0; k < keys; k++)
+        {
+            size_t slot = k * perKey + n;
+            auto finish = [&, k, n, slot](exception_ptr)
+            {
+                done[slot] = monotonicNanos();
+                if (n && n < lastIndex[k])
+                    fifoViolations++;
+                lastIndex[k] = n;
+                if (++completed == keys * perKey)
+                {
+                    lock_guard<mutex> lock(doneMutex);
+                    allDone.notify_one();
+                }
+            };
+            if (limiter.acquire(names[k], 1, finish))
+            {
+                immediate++;
+                finish(nullptr);
+            }
+        }
+    }
+    size_t peakWaiters = limiter.waiters();
+    {
+        unique_lock<mutex> lock(doneMutex);
+        allDone.wait(lock, [&] { return completed.load() == keys * perKey; });
+    }
+    double elapsed = (monotonicNanos() - start) / 1e9;
+
+    vector<double> late;
+    for (size_t k = 0; k < keys; k++)
+    {
+        for (size_t n = 0; n < perKey; n++)
+        {
+            double earliest = n + 1 > static_cast<size_t>(rate) ? double(n + 1 - rate) / rate : 0;
+            late.push_back(max(0.0, (done[k * perKey + n] - start) / 1e9 - earliest) * 1e3);
+        }
+    }
+    sort(late.begin(), late.end());
+    auto pct = [&](double p) { return late[min(late.size() - 1, static_cast<size_t>(p * late.size()))]; };
+
+    cout << keys * perKey << " waiters on " << keys << " keys at " << rate << "/s per key, tick "
+         << tickNanos / 1000 << " us\n"
+         << "admitted at once   " << immediate << "\n"
+         << "parked             " << peakWaiters << " (1 timer thread)\n"
+         << "elapsed            " << fixed << setprecision(3) << elapsed << " s (ideal "
+         << (perKey > static_cast<size_t>(rate) ? double(perKey - rate) / rate : 0) << " s)\n"
+         << "late ms p50/p99/max " << pct(0.5) << " / " << pct(0.99) << " / " << late.back() << "\n"
+         << "fifo violations    " << fifoViolations << "\n";
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Contended ns/decision of the packed-word token bucket.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/atomic_bucket_bench.cpp -o atomic_bucket_bench
+//
+// Every thread hammers the same key, which is the worst case for the CAS:
+//   bucket   - AtomicTokenBucket::tryConsume on one shared bucket
+//   limiter  - AtomicTokenBucketRateLimiter::allowRequest (adds key lookup)
+//   legacy   - TokenBucketRateLimiter::allowRequest behind a mutex
+// ns/decision is per thread: elapsed wall time / decisions made by a thread.
+//
+// It also checks that threads creating many keys at once through the
+// limiter's lock-free tables (which grow several times on the way) admit
+// exactly each key's burst; main returns 1 if not.
+#include <bits/stdc++.h>
+#include "../include/AtomicTokenBucketRateLimiter.h"
+#include "../include/TokenBucketRateLimiter.h"
+using namespace std;
+
+static const int DECISIONS_PER_THREAD = 2000000;
+
+template <typename Fn>
+static double run(int threads, Fn decide)
+{
+    atomic<bool> start{false};
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]
+        {
+            while (!start.load(memory_order_acquire))
+                this_thread::yield();
+            for (int i = 0; i < DECISIONS_PER_THREAD; i++)
+                decide();
+        });
+    }
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    for (auto &w : workers)
+        w.join();
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - begin).count() / DECISIONS_PER_THREAD;
+}
+
+static bool newKeysAreExact()
+{
+    const int keys = 200000, threads = 4, maxTokens = 3;
+    vector<string> names(keys);
+    for (int i = 0; i < keys; i++)
+        names[i] = "key_" + to_string(i);
+    AtomicTokenBucketRateLimiter limiter(maxTokens, 3600);
+    atomic<long> admitted{0};
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&, t]
+        {
+            long mine = 0;
+            for (int round = 0; round < maxTokens + 1; round++)
+                for (int i = 0; i < keys; i++)
+                    mine += limiter.allowRequest(names[(i + t * 7919) % keys]);
+            admitted += mine;
+        });
+    for (auto &w : workers)
+        w.join();
+    if (admitted != static_cast<long>(keys) * maxTokens)
+    {
+        cerr << "new keys: admitted " << admitted << ", expected " << static_cast<long>(keys) * maxTokens << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!newKeysAreExact())
+        return 1;
+
+    const int maxTokens = 60000;
+    const int window = 1;
+    const string key = "hot_user";
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << "\n";
+    cout << left << setw(10) << "threads" << setw(16) << "bucket ns"
+         << setw(16) << "limiter ns" << "legacy+mutex ns\n";
+
+    for (int threads : {1, 2, 4, 8})
+    {
+        TokenBucketParams params(maxTokens, (int64_t)window * 1000000000);
+        AtomicTokenBucket bucket(params, monotonicNanos());
+        double b = run(threads, [&] { bucket.tryConsume(monotonicNanos(), params); });
+
+        AtomicTokenBucketRateLimiter limiter(maxTokens, window);
+        double l = run(threads, [&] { limiter.allowRequest(key); });
+
+        TokenBucketRateLimiter legacy(maxTokens, window);
+        mutex legacyMutex;
+        double g = run(threads, [&]
+        {
+            lock_guard<mutex> lock(legacyMutex);
+            legacy.allowRequest(key);
+        });
+
+        cout << left << setw(10) << threads << fixed << setprecision(1)
+             << setw(16) << b << setw(16) << l << g << "\n";
+    }
+
+    // Fractional refill: 3 tokens per second checked every 10 ms must admit
+    // ~3 requests/s once the initial burst is spent, not 0 or 100.
+    AtomicTokenBucketRateLimiter slow(3, 1);
+    int admitted = 0;
+    auto until = chrono::steady_clock::now() + chrono::seconds(2);
+    while (chrono::steady_clock::now() < until)
+    {
+        admitted += slow.allowRequest("slow_user");
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    cout << "\n3 tokens/s over 2 s (3 burst + ~6 refilled): admitted " << admitted << "\n";
+    return 0;
+}
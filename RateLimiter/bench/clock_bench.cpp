@@ -0,0 +1,119 @@
+// Clock sources and sub-second windows.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/clock_bench.cpp -o clock_bench
+// Usage: ./clock_bench [users=100000] [decisions=5000000]
+//
+//   reads      ns per nowNanos() for each Clock
+//   decisions  RateLimiterService::handleRequest over a Zipf-skewed stream on
+//              a policy of 100 ms windows, once per clock. "reads" is the
+//              clock reads per decision (counted through a wrapper) and
+//              "clock %" their estimated share of the decision
+//   windows    every algorithm at 20 requests per 100 ms on a simulated
+//              clock, offered one request per millisecond for 10 s; a
+//              window-true limiter admits about 2000
+#include <bits/stdc++.h>
+#include "../include/RateLimiterService.h"
+using namespace std;
+
+class CountingClock : public Clock
+{
+public:
+    Clock &inner;
+    uint64_t reads = 0;
+
+    explicit CountingClock(Clock &inner) : inner(inner) {}
+    int64_t nowNanos() override
+    {
+        reads++;
+        return inner.nowNanos();
+    }
+};
+
+static double readCost(Clock &clock)
+{
+    const int calls = 20000000;
+    int64_t sink = 0;
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++)
+        sink += clock.nowNanos();
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / calls;
+    return sink == 42 ? 0 : ns;
+}
+
+int main(int argc, char **argv)
+{
+    size_t users = argc > 1 ? stoull(argv[1]) : 100000;
+    size_t decisions = argc > 2 ? stoull(argv[2]) : 5000000;
+
+    TscClock tsc;
+    CoarseClock coarse;
+    SimulatedClock simulated(1000000000);
+    vector<pair<string, Clock *>> clocks = {
+        {"system", &systemClock()}, {"tsc", &tsc}, {"coarse 1ms", &coarse}, {"simulated", &simulated}};
+
+    cout << "reads (ns/call)" << (tsc.usesTsc() ? "" : "  [no invariant TSC: tsc falls back to system]") << "\n";
+    map<string, double> cost;
+    for (auto &[name, clock] : clocks)
+    {
+        cost[name] = readCost(*clock);
+        cout << "  " << left << setw(12) << name << fixed << setprecision(1) << cost[name] << "\n";
+    }
+
+    stringstream policyText("FREE 5 100ms COUNTER\nPREMIUM_1 20 100ms SLIDING_WINDOW_COUNTER\n"
+                            "PREMIUM_2 50 100ms TOKEN_BUCKET\nPREMIUM_3 100 100ms TOKEN_BUCKET\n");
+    PolicyStore policies;
+    policies.update(PolicyStore::parse(policyText));
+
+    mt19937_64 rng(21);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> keys(users);
+    vector<UserType> types(users);
+    vector<double> cdf(users);
+    double sum = 0;
+    for (size_t i = 0; i < users; i++)
+    {
+        keys[i] = "user_" + to_string(i);
+        types[i] = static_cast<UserType>(tierMix(rng));
+        cdf[i] = sum += 1.0 / (i + 1);
+    }
+    vector<uint32_t> stream(1 << 20);
+    uniform_real_distribution<double> pick(0, sum);
+    for (uint32_t &u : stream)
+        u = static_cast<uint32_t>(min<size_t>(lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin(), users - 1));
+
+    cout << "\ndecisions\n  " << left << setw(12) << "clock" << setw(14) << "ns/decision" << setw(8) << "reads"
+         << "clock %\n";
+    for (auto &[name, clock] : clocks)
+    {
+        if (clock == &simulated)
+            continue;
+        CountingClock counting(*clock);
+        RateLimiterService service(RateLimiterService::defaultShardCount(), EvictionPolicy(), counting, policies);
+        for (size_t i = 0; i < users; i++)
+            service.handleRequest(keys[i], types[i]);
+        counting.reads = 0;
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < decisions; i++)
+        {
+            uint32_t u = stream[i & (stream.size() - 1)];
+            service.handleRequest(keys[u], types[u]);
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / decisions;
+        double reads = static_cast<double>(counting.reads) / decisions;
+        cout << "  " << left << setw(12) << name << setw(14) << fixed << setprecision(1) << ns << setw(8)
+             << setprecision(2) << reads << setprecision(1) << 100 * reads * cost[name] / ns << "\n";
+    }
+
+    cout << "\nwindows (20 per 100 ms, 10000 requests over 10 s)\n";
+    for (int a = 0; a < ALGORITHM_COUNT; a++)
+    {
+        SimulatedClock clock(1000000000);
+        RateLimitConfig config{20, chrono::milliseconds(100), static_cast<AlgorithmType>(a)};
+        unique_ptr<RateLimiter> limiter = RateLimiterFactory::createLimiter(config, clock);
+        int admitted = 0;
+        for (int i = 0; i < 10000; i++, clock.advance(1000000))
+            admitted += limiter->allowRequest("key");
+        cout << "  " << left << setw(24) << PolicyStore::ALGORITHM_NAMES[a] << admitted << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Multi-threaded throughput of RateLimiterService.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/concurrency_bench.cpp -o concurrency_bench
+//
+// Compares a single-shard service (equivalent to one global mutex around the
+// old maps) with the default lock-striped service at 1, 8, 32 and 64 threads.
+#include <bits/stdc++.h>
+#include "../include/RateLimiterService.h"
+using namespace std;
+
+static const int USERS = 100000;
+static const int DECISIONS_PER_THREAD = 100000;
+
+static vector<string> makeUsers()
+{
+    vector<string> users;
+    users.reserve(USERS);
+    for (int i = 0; i < USERS; i++)
+        users.push_back("user_" + to_string(i));
+    return users;
+}
+
+static double run(RateLimiterService &service, const vector<string> &users, int threads)
+{
+    atomic<bool> start{false};
+    atomic<long long> allowed{0};
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]
+        {
+            mt19937_64 rng(t + 1);
+            uniform_int_distribution<int> pick(0, USERS - 1);
+            vector<int> keys(DECISIONS_PER_THREAD);
+            for (int &k : keys)
+                k = pick(rng);
+
+            while (!start.load(memory_order_acquire))
+                this_thread::yield();
+
+            long long ok = 0;
+            for (int k : keys)
+                ok += service.handleRequest(users[k]);
+            allowed += ok;
+        });
+    }
+
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    for (auto &w : workers)
+        w.join();
+    auto end = chrono::steady_clock::now();
+
+    double seconds = chrono::duration<double>(end - begin).count();
+    return (double)threads * DECISIONS_PER_THREAD / seconds;
+}
+
+int main()
+{
+    vector<string> users = makeUsers();
+    RateLimitConfig config{1000000, 60, AlgorithmType::TOKEN_BUCKET};
+
+    cout << "hardware threads: " << thread::hardware_concurrency() << "\n";
+    cout << left << setw(10) << "threads"
+         << setw(22) << "global lock (dec/s)"
+         << setw(22) << "striped (dec/s)"
+         << "shards\n";
+
+    for (int threads : {1, 8, 32, 64})
+    {
+        RateLimiterService global(1);
+        RateLimiterService striped;
+        for (const string &u : users)
+        {
+            global.addConfig(u, config);
+            striped.addConfig(u, config);
+        }
+
+        double g = run(global, users, threads);
+        double s = run(striped, users, threads);
+
+        cout << left << setw(10) << threads
+             << setw(22) << fixed << setprecision(0) << g
+             << setw(22) << s
+             << striped.getShardCount() << "\n";
+    }
+    return 0;
+}
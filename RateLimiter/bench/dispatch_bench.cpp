@@ -0,0 +1,149 @@
+// Virtual vs static dispatch of a tiered decision.
+//
+// Build: g++ -std=c++17 -O2 bench/dispatch_bench.cpp -o dispatch_bench
+//
+//   factory   unique_ptr<RateLimiter> per tier from RateLimiterFactory, as
+//             RateLimiterService uses them (own maps, time(nullptr))
+//   runtime   FlatRateLimiterService::decide over a runtime CompiledLimit
+//   virtual   the static Limiter for each tier behind a RateLimiter vtable
+//   static    StaticTierService: per-tier code inlined, no virtual call
+// The last three share storage layout and a synthetic clock, so their
+// difference is the dispatch and config lookup alone. Before timing, every
+// tier's decide is checked to hold a key first seen at time 0 to its limit.
+#include <bits/stdc++.h>
+#include "../include/RateLimiterFactory.h"
+#include "../include/FlatRateLimiterService.h"
+#include "../include/StaticLimiter.h"
+using namespace std;
+
+static const int USERS_PER_TIER = 10000;
+static const int DECISIONS = 5000000;
+
+struct StepClock
+{
+    static inline int64_t t = 1000000000;
+    static int64_t now() { return t += 1000; }
+};
+
+template <typename L>
+class VirtualLimiter : public RateLimiter
+{
+    L impl;
+
+public:
+    bool allowRequest(const string &userId) override { return impl.allowRequest(userId); }
+    AcquireResult tryAcquire(const string &userId, uint32_t cost) override { return impl.tryAcquire(userId, cost); }
+};
+
+template <size_t... I>
+static vector<unique_ptr<RateLimiter>> virtualTiers(index_sequence<I...>)
+{
+    vector<unique_ptr<RateLimiter>> tiers;
+    (tiers.push_back(make_unique<VirtualLimiter<TierLimiter<static_cast<UserType>(I), StepClock>>>()), ...);
+    return tiers;
+}
+
+template <typename Fn>
+static double timeIt(Fn fn, long long &allowed)
+{
+    auto begin = chrono::steady_clock::now();
+    allowed = fn();
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / DECISIONS;
+}
+
+// Time 0 is a valid timestamp (SimulatedClock starts there), not a marker
+// for a key that was never seen.
+static bool limitHoldsAtTimeZero()
+{
+    bool ok = true;
+    for (int t = 0; t < TIER_COUNT; t++)
+    {
+        FlatRateLimiterService::CompiledLimit limit = FlatRateLimiterService::compile(TIER_CONFIGS[t]);
+        SlotState state = {0, 0};
+        int admitted = 0;
+        for (int i = 0; i < 2 * TIER_CONFIGS[t].maxRequests; i++)
+            admitted += FlatRateLimiterService::decide(state, limit, 0);
+        if (admitted != TIER_CONFIGS[t].maxRequests)
+        {
+            cerr << "tier " << t << " at time 0: admitted " << admitted << " of "
+                 << TIER_CONFIGS[t].maxRequests << "\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main()
+{
+    if (!limitHoldsAtTimeZero())
+        return 1;
+
+    vector<User> users;
+    for (int t = 0; t < TIER_COUNT; t++)
+        for (int i = 0; i < USERS_PER_TIER; i++)
+            users.push_back({"user_" + to_string(t) + "_" + to_string(i), static_cast<UserType>(t)});
+
+    mt19937_64 rng(5);
+    vector<int> stream(DECISIONS);
+    for (int &s : stream)
+        s = rng() % users.size();
+
+    long long allowed;
+    cout << left << setw(10) << "path" << setw(14) << "ns/decision" << "allowed\n";
+
+    vector<unique_ptr<RateLimiter>> factory;
+    for (int t = 0; t < TIER_COUNT; t++)
+        factory.push_back(RateLimiterFactory::createLimiter(TIER_CONFIGS[t]));
+    double f = timeIt([&]
+    {
+        long long ok = 0;
+        for (int s : stream)
+            ok += factory[static_cast<int>(users[s].type)]->allowRequest(users[s].userId);
+        return ok;
+    }, allowed);
+    cout << left << setw(10) << "factory" << setw(14) << fixed << setprecision(1) << f << allowed << "\n";
+
+    vector<FlatRateLimiterService::CompiledLimit> limits;
+    vector<unique_ptr<FlatStorage>> runtimeStorage;
+    for (int t = 0; t < TIER_COUNT; t++)
+    {
+        limits.push_back(FlatRateLimiterService::compile(TIER_CONFIGS[t]));
+        runtimeStorage.push_back(make_unique<FlatStorage>());
+    }
+    StepClock::t = 1000000000;
+    double r = timeIt([&]
+    {
+        long long ok = 0;
+        for (int s : stream)
+        {
+            int tier = static_cast<int>(users[s].type);
+            ok += FlatRateLimiterService::decide(runtimeStorage[tier]->stateFor(users[s].userId),
+                                                 limits[tier], StepClock::now());
+        }
+        return ok;
+    }, allowed);
+    cout << left << setw(10) << "runtime" << setw(14) << r << allowed << "\n";
+
+    auto virt = virtualTiers(make_index_sequence<TIER_COUNT>{});
+    StepClock::t = 1000000000;
+    double v = timeIt([&]
+    {
+        long long ok = 0;
+        for (int s : stream)
+            ok += virt[static_cast<int>(users[s].type)]->allowRequest(users[s].userId);
+        return ok;
+    }, allowed);
+    cout << left << setw(10) << "virtual" << setw(14) << v << allowed << "\n";
+
+    StaticTierService<StepClock> service;
+    StepClock::t = 1000000000;
+    double st = timeIt([&]
+    {
+        long long ok = 0;
+        for (int s : stream)
+            ok += service.handleRequest(users[s]);
+        return ok;
+    }, allowed);
+    cout << left << setw(10) << "static" << setw(14) << st << allowed << "\n";
+    return 0;
+}
@@ -0,0 +1,111 @@
+// ns/decision and resident bytes/user: RateLimiterService vs FlatRateLimiterService.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/flat_table_bench.cpp -o flat_table_bench
+// Usage: ./flat_table_bench [flatUsers=10000000] [legacyUsers=1000000]
+//
+// The node-based service needs several hundred bytes per user, so by default
+// it is measured at 1M users (bytes/user is roughly flat in the user count);
+// pass a larger second argument on a machine with the memory for it.
+#include <bits/stdc++.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../include/RateLimiterService.h"
+#include "../include/FlatRateLimiterService.h"
+using namespace std;
+
+static const int DECISIONS = 5000000;
+
+static size_t residentBytes()
+{
+    long pages = 0, resident = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Keys are formatted into a caller buffer so neither side pays for storing
+// the key list itself.
+static string_view keyFor(uint64_t i, char *buffer)
+{
+    int n = snprintf(buffer, 32, "user_%llu", (unsigned long long)i);
+    return string_view(buffer, n);
+}
+
+template <typename Service, typename Handle>
+static void measure(const char *name, Service &service, uint64_t users, Handle handle)
+{
+    char buffer[32];
+    RateLimitConfig config{60000, 60, AlgorithmType::TOKEN_BUCKET};
+
+    size_t before = residentBytes();
+    for (uint64_t i = 0; i < users; i++)
+    {
+        service.addConfig(string(keyFor(i, buffer)), config);
+        handle(service, keyFor(i, buffer));
+    }
+    size_t after = residentBytes();
+
+    mt19937_64 rng(7);
+    vector<uint64_t> picks(DECISIONS);
+    for (auto &p : picks)
+        p = rng() % users;
+
+    long long allowed = 0;
+    auto begin = chrono::steady_clock::now();
+    for (uint64_t p : picks)
+        allowed += handle(service, keyFor(p, buffer));
+    auto end = chrono::steady_clock::now();
+
+    double ns = chrono::duration<double, nano>(end - begin).count() / DECISIONS;
+    cout << left << setw(10) << name << setw(12) << users << fixed << setprecision(1)
+         << setw(16) << ns << setw(16) << (double)(after - before) / users
+         << allowed << "\n";
+}
+
+// Each measurement runs in its own child process so resident-set deltas are
+// not hidden by memory an earlier run freed back to the allocator.
+template <typename Fn>
+static void isolated(Fn fn)
+{
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        fn();
+        cout.flush();
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t flatUsers = argc > 1 ? stoull(argv[1]) : 10000000;
+    uint64_t legacyUsers = argc > 2 ? stoull(argv[2]) : 1000000;
+
+    cout << left << setw(10) << "service" << setw(12) << "users"
+         << setw(16) << "ns/decision" << setw(16) << "bytes/user" << "allowed\n";
+
+    isolated([&]
+    {
+        RateLimiterService legacy;
+        measure("before", legacy, legacyUsers, [](RateLimiterService &s, string_view key)
+                { return s.handleRequest(string(key)); });
+    });
+    isolated([&]
+    {
+        FlatRateLimiterService flat;
+        measure("flat", flat, legacyUsers, [](FlatRateLimiterService &s, string_view key)
+                { return s.handleRequest(key); });
+    });
+    if (flatUsers != legacyUsers)
+    {
+        isolated([&]
+        {
+            FlatRateLimiterService flat;
+            measure("flat", flat, flatUsers, [](FlatRateLimiterService &s, string_view key)
+                    { return s.handleRequest(key); });
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Several gateway processes sharing per-user limits through a QuotaServer,
+// against the same processes each enforcing the limits on their own.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/lease_bench.cpp -o lease_bench
+// Usage: ./lease_bench [nodes=8] [users=1000] [seconds=3] [leaseTtlMs=200]
+//
+//   leased       every node runs LeasedRateLimiterService against one
+//                forked QuotaServer
+//   independent  every node runs its own RateLimiterService
+//
+// Each node is a forked process sending requests for uniformly chosen users
+// (tier mix 70/15/10/5) as fast as it can for the given wall time. "bound"
+// is what one token bucket per user could admit over the run: capacity plus
+// refill. A central limiter without leases costs one message per decision;
+// "msgs/1M" is the leased path's lease requests plus returns per million
+// decisions.
+//
+// First, on a simulated clock, it checks that a lease whose key goes quiet
+// is returned to the server by the expiry sweep, without another request
+// for the key; main returns 1 if not.
+#include <bits/stdc++.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../include/QuotaLease.h"
+#include "../include/RateLimiterService.h"
+using namespace std;
+
+struct NodeResult
+{
+    uint64_t decisions = 0, admitted = 0, messages = 0;
+};
+
+template <typename Decide>
+static NodeResult drive(int node, const vector<string> &keys, const vector<UserType> &types, double seconds,
+                        Decide decide)
+{
+    NodeResult result;
+    mt19937_64 rng(50 + node);
+    auto end = chrono::steady_clock::now() + chrono::duration<double>(seconds);
+    while (true)
+    {
+        // Check the time once per batch so it stays off the decision path.
+        for (int i = 0; i < 256; i++)
+        {
+            size_t u = rng() % keys.size();
+            result.admitted += decide(keys[u], types[u]);
+            result.decisions++;
+        }
+        if (chrono::steady_clock::now() >= end)
+            return result;
+    }
+}
+
+// Forks one process per node; each writes its NodeResult back over a pipe.
+template <typename Node>
+static NodeResult runNodes(int nodes, Node node)
+{
+    vector<pair<pid_t, int>> children;
+    for (int n = 0; n < nodes; n++)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            throw runtime_error("pipe failed");
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            NodeResult r = node(n);
+            ssize_t written = write(fds[1], &r, sizeof(r));
+            _exit(written == static_cast<ssize_t>(sizeof(r)) ? 0 : 1);
+        }
+        close(fds[1]);
+        children.emplace_back(pid, fds[0]);
+    }
+    NodeResult total;
+    for (auto &[pid, fd] : children)
+    {
+        NodeResult r;
+        if (lease_io::readAll(fd, &r, sizeof(r)))
+        {
+            total.decisions += r.decisions;
+            total.admitted += r.admitted;
+            total.messages += r.messages;
+        }
+        close(fd);
+        waitpid(pid, nullptr, 0);
+    }
+    return total;
+}
+
+static bool quietLeaseReturns()
+{
+    string path = "/tmp/lease_check_" + to_string(getpid()) + ".sock";
+    SimulatedClock clock(1000000000);
+    QuotaServer server(path, 200000000, clock);
+    thread serving([&] { server.run(); });
+    uint64_t returned;
+    {
+        LeasedRateLimiterService node(path, clock, chrono::milliseconds(5));
+        // The second request takes a lease of 12 (1/8 of PREMIUM_3) and
+        // spends one token of it; then the key goes quiet past the TTL.
+        node.handleRequest("quiet", UserType::PREMIUM_3);
+        node.handleRequest("quiet", UserType::PREMIUM_3);
+        clock.advance(1000000000);
+        this_thread::sleep_for(chrono::milliseconds(200));
+        server.stop();
+        serving.join();
+        returned = server.getStats().tokensReturned;
+    }
+    if (returned != 11)
+    {
+        cerr << "quiet key: " << returned << " tokens returned after its lease expired, expected 11\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!quietLeaseReturns())
+        return 1;
+
+    int nodes = argc > 1 ? stoi(argv[1]) : 8;
+    size_t users = argc > 2 ? stoull(argv[2]) : 1000;
+    double seconds = argc > 3 ? stod(argv[3]) : 3;
+    int64_t ttlMs = argc > 4 ? stoll(argv[4]) : 200;
+
+    mt19937_64 rng(3);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> keys(users);
+    vector<UserType> types(users);
+    double bound = 0;
+    for (size_t i = 0; i < users; i++)
+    {
+        keys[i] = "user_" + to_string(i);
+        types[i] = static_cast<UserType>(tierMix(rng));
+        RateLimitConfig config = RateLimitPolicy::getConfig(types[i]);
+        bound += config.maxRequests * (1 + seconds / config.timeWindow.seconds());
+    }
+
+    string path = "/tmp/lease_bench_" + to_string(getpid()) + ".sock";
+    pid_t serverPid = fork();
+    if (serverPid == 0)
+    {
+        QuotaServer server(path, ttlMs * 1000000);
+        static QuotaServer *running = &server;
+        signal(SIGTERM, [](int) { running->stop(); });
+        server.run();
+        _exit(0);
+    }
+
+    NodeResult leased = runNodes(nodes, [&](int n)
+    {
+        // The server may still be binding its socket.
+        for (int attempt = 0;; attempt++)
+        {
+            try
+            {
+                LeasedRateLimiterService service(path);
+                NodeResult r = drive(n, keys, types, seconds, [&](const string &id, UserType type)
+                                     { return service.handleRequest(id, type); });
+                service.releaseAll();
+                LeasedRateLimiterService::Stats stats = service.getStats();
+                r.messages = stats.leaseRequests + stats.returns;
+                return r;
+            }
+            catch (const runtime_error &)
+            {
+                if (attempt == 100)
+                    throw;
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+        }
+    });
+    kill(serverPid, SIGTERM);
+    waitpid(serverPid, nullptr, 0);
+
+    NodeResult independent = runNodes(nodes, [&](int n)
+    {
+        RateLimiterService service;
+        return drive(n, keys, types, seconds, [&](const string &id, UserType type)
+                     { return service.handleRequest(id, type); });
+    });
+
+    cout << nodes << " nodes, " << users << " users, " << seconds << " s, lease TTL " << ttlMs
+         << " ms; bound " << fixed << setprecision(0) << bound << " admitted\n";
+    cout << left << setw(13) << "path" << setw(13) << "decisions" << setw(11) << "admitted" << setw(10)
+         << "x bound" << setw(11) << "messages" << "msgs/1M\n";
+    auto report = [&](const char *name, const NodeResult &r)
+    {
+        cout << left << setw(13) << name << setw(13) << r.decisions << setw(11) << r.admitted << setw(10)
+             << setprecision(2) << r.admitted / bound << setw(11) << r.messages << setprecision(0)
+             << (r.decisions ? r.messages * 1e6 / r.decisions : 0) << "\n";
+    };
+    report("leased", leased);
+    report("independent", independent);
+    return 0;
+}
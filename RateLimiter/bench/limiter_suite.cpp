@@ -0,0 +1,409 @@
+// Microbenchmark suite: every limiter and both services against realistic
+// key streams, with machine-readable output for diffing runs.
+//
+// Build: make bench-suite   (or g++ -std=c++17 -O2 -pthread bench/limiter_suite.cpp -o limiter_suite)
+// Usage: ./limiter_suite [--ops N] [--keys N] [--zipf S] [--threads 1,2,4,8]
+//                        [--filter SUBSTR] [--out results.jsonl] [--baseline old.jsonl]
+//
+// Key streams
+//   uniform   --keys distinct users, each request picks one uniformly
+//   zipf      same users, rank r picked with probability ~ 1/r^S (S = 0.99)
+//   highcard  a fresh random 64-bit key for (almost) every request
+//
+// Each (target, stream, threads) case runs in its own forked process so
+// resident memory and allocator state never leak between cases. The first
+// half of the stream is timed as a whole (ns/decision, aggregate over all
+// threads); the second half is timed per decision for p50/p99/p999, which
+// adds two clock reads to every sample. Allocations are counted by
+// replacing global operator new. Resident bytes per key is the RSS growth
+// over the case divided by the number of distinct keys it touched.
+//
+// Only targets that are safe to share run with more than one thread.
+#include <bits/stdc++.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../include/CounterRateLimiter.h"
+#include "../include/SlidingWindowRateLimiter.h"
+#include "../include/TokenBucketRateLimiter.h"
+#include "../include/SlidingWindowCounterRateLimiter.h"
+#include "../include/LeakyBucketRateLimiter.h"
+#include "../include/AtomicTokenBucketRateLimiter.h"
+#include "../include/RateLimiterService.h"
+#include "../include/FlatRateLimiterService.h"
+using namespace std;
+
+// ---------------- allocation counting ----------------
+static thread_local size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// ---------------- targets ----------------
+// Every target sees the PREMIUM_2 limit so the algorithms do comparable work.
+static const RateLimitConfig LIMIT = RateLimitPolicy::getConfig(UserType::PREMIUM_2);
+
+struct Target
+{
+    virtual ~Target() = default;
+    virtual bool decide(const string &key) = 0;
+};
+
+template <typename L>
+struct LimiterTarget : Target
+{
+    L limiter;
+    template <typename... Args>
+    explicit LimiterTarget(Args... args) : limiter(args...) {}
+    bool decide(const string &key) override { return limiter.allowRequest(key); }
+};
+
+struct ServiceTarget : Target
+{
+    RateLimiterService service;
+    bool decide(const string &key) override { return service.handleRequest(key, UserType::PREMIUM_2); }
+};
+
+struct FlatServiceTarget : Target
+{
+    FlatRateLimiterService service;
+    bool decide(const string &key) override { return service.handleRequest(key, UserType::PREMIUM_2); }
+};
+
+struct TargetInfo
+{
+    string name;
+    bool threadSafe;
+    function<unique_ptr<Target>()> make;
+};
+
+static vector<TargetInfo> targets()
+{
+    int m = LIMIT.maxRequests;
+    TimeWindow w = LIMIT.timeWindow;
+    return {
+        {"counter", false, [=] { return make_unique<LimiterTarget<CounterRateLimiter>>(m, w); }},
+        {"sliding_window", false, [=] { return make_unique<LimiterTarget<SlidingWindowRateLimiter>>(m, w); }},
+        {"token_bucket", false, [=] { return make_unique<LimiterTarget<TokenBucketRateLimiter>>(m, w); }},
+        {"sliding_window_counter", false, [=] { return make_unique<LimiterTarget<SlidingWindowCounterRateLimiter>>(m, w); }},
+        {"leaky_bucket", false, [=] { return make_unique<LimiterTarget<LeakyBucketRateLimiter>>(m, w); }},
+        {"atomic_token_bucket", true, [=] { return make_unique<LimiterTarget<AtomicTokenBucketRateLimiter>>(m, w); }},
+        {"service", true, [] { return make_unique<ServiceTarget>(); }},
+        {"flat_service", true, [] { return make_unique<FlatServiceTarget>(); }},
+    };
+}
+
+// ---------------- key streams ----------------
+struct Stream
+{
+    vector<string> keys;
+    vector<uint32_t> order;
+    size_t distinct = 0;
+};
+
+static Stream makeStream(const string &dist, size_t ops, size_t keys, double zipf)
+{
+    Stream s;
+    mt19937_64 rng(42);
+    if (dist == "highcard")
+    {
+        s.keys.resize(ops);
+        for (size_t i = 0; i < ops; i++)
+        {
+            char buf[24];
+            snprintf(buf, sizeof(buf), "k%016llx", static_cast<unsigned long long>(rng()));
+            s.keys[i] = buf;
+        }
+        s.order.resize(ops);
+        iota(s.order.begin(), s.order.end(), 0);
+    }
+    else
+    {
+        s.keys.resize(keys);
+        for (size_t i = 0; i < keys; i++)
+            s.keys[i] = "user_" + to_string(i);
+        s.order.resize(ops);
+        if (dist == "uniform")
+        {
+            for (uint32_t &k : s.order)
+                k = rng() % keys;
+        }
+        else
+        {
+            vector<double> cdf(keys);
+            double sum = 0;
+            for (size_t i = 0; i < keys; i++)
+                cdf[i] = sum += 1.0 / pow(static_cast<double>(i + 1), zipf);
+            uniform_real_distribution<double> u(0, sum);
+            for (uint32_t &k : s.order)
+                k = min<size_t>(lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin(), keys - 1);
+        }
+    }
+    vector<bool> seen(s.keys.size());
+    for (uint32_t k : s.order)
+        if (!seen[k])
+        {
+            seen[k] = true;
+            s.distinct++;
+        }
+    return s;
+}
+
+// ---------------- one case ----------------
+struct Result
+{
+    string target, dist;
+    int threads = 1;
+    size_t ops = 0, keys = 0;
+    double nsPerDecision = 0, p50 = 0, p99 = 0, p999 = 0;
+    double allocsPerDecision = 0, bytesPerKey = 0, allowedRatio = 0;
+};
+
+static size_t residentBytes()
+{
+    long pages = 0, resident = 0;
+    ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return static_cast<size_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+static string toJson(const Result &r)
+{
+    ostringstream out;
+    out << fixed << setprecision(2) << "{\"target\":\"" << r.target << "\",\"dist\":\"" << r.dist
+        << "\",\"threads\":" << r.threads << ",\"ops\":" << r.ops << ",\"keys\":" << r.keys
+        << ",\"ns_per_decision\":" << r.nsPerDecision << ",\"p50_ns\":" << r.p50
+        << ",\"p99_ns\":" << r.p99 << ",\"p999_ns\":" << r.p999
+        << ",\"allocs_per_decision\":" << r.allocsPerDecision
+        << ",\"bytes_per_key\":" << r.bytesPerKey << ",\"allowed_ratio\":" << r.allowedRatio << "}";
+    return out.str();
+}
+
+static Result runCase(const TargetInfo &info, const string &dist, int threads, const Stream &s)
+{
+    Result r;
+    r.target = info.name;
+    r.dist = dist;
+    r.threads = threads;
+    r.ops = s.order.size();
+    r.keys = s.distinct;
+
+    size_t half = s.order.size() / 2;
+    vector<vector<double>> samples(threads);
+    for (int t = 0; t < threads; t++)
+        samples[t].reserve((s.order.size() - half) / threads + 1);
+    vector<size_t> allocs(threads), allowed(threads);
+
+    size_t before = residentBytes();
+    unique_ptr<Target> target = info.make();
+
+    auto slice = [&](size_t from, size_t to, int t, int of)
+    {
+        size_t n = to - from;
+        return make_pair(from + n * t / of, from + n * (t + 1) / of);
+    };
+    auto spawn = [&](auto body)
+    {
+        vector<thread> pool;
+        for (int t = 1; t < threads; t++)
+            pool.emplace_back(body, t);
+        body(0);
+        for (thread &th : pool)
+            th.join();
+    };
+
+    auto begin = chrono::steady_clock::now();
+    spawn([&](int t)
+    {
+        size_t start = allocations, ok = 0;
+        auto [from, to] = slice(0, half, t, threads);
+        for (size_t i = from; i < to; i++)
+            ok += target->decide(s.keys[s.order[i]]);
+        allocs[t] += allocations - start;
+        allowed[t] += ok;
+    });
+    r.nsPerDecision = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / max<size_t>(half, 1);
+
+    spawn([&](int t)
+    {
+        size_t start = allocations, ok = 0;
+        auto [from, to] = slice(half, s.order.size(), t, threads);
+        for (size_t i = from; i < to; i++)
+        {
+            auto t0 = chrono::steady_clock::now();
+            ok += target->decide(s.keys[s.order[i]]);
+            samples[t].push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count());
+        }
+        allocs[t] += allocations - start;
+        allowed[t] += ok;
+    });
+
+    size_t after = residentBytes();
+    r.bytesPerKey = after > before ? static_cast<double>(after - before) / max<size_t>(s.distinct, 1) : 0;
+    r.allocsPerDecision = static_cast<double>(accumulate(allocs.begin(), allocs.end(), size_t(0))) / r.ops;
+    r.allowedRatio = static_cast<double>(accumulate(allowed.begin(), allowed.end(), size_t(0))) / r.ops;
+
+    vector<double> all;
+    for (auto &v : samples)
+        all.insert(all.end(), v.begin(), v.end());
+    if (!all.empty())
+    {
+        auto at = [&](double q)
+        {
+            size_t i = min(all.size() - 1, static_cast<size_t>(q * all.size()));
+            nth_element(all.begin(), all.begin() + i, all.end());
+            return all[i];
+        };
+        r.p50 = at(0.50);
+        r.p99 = at(0.99);
+        r.p999 = at(0.999);
+    }
+    return r;
+}
+
+// Runs runCase in a child and hands its JSON line back through a pipe.
+static string isolated(const TargetInfo &info, const string &dist, int threads, const Stream &s)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw runtime_error("pipe failed");
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        string line = toJson(runCase(info, dist, threads, s));
+        ssize_t written = write(fds[1], line.data(), line.size());
+        _exit(written == static_cast<ssize_t>(line.size()) ? 0 : 1);
+    }
+    close(fds[1]);
+    string line;
+    char buf[512];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        line.append(buf, n);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? line : "";
+}
+
+// ---------------- baseline diff ----------------
+static double field(const string &line, const string &name)
+{
+    size_t at = line.find("\"" + name + "\":");
+    return at == string::npos ? NAN : atof(line.c_str() + at + name.size() + 3);
+}
+
+static string text(const string &line, const string &name)
+{
+    size_t at = line.find("\"" + name + "\":\"");
+    if (at == string::npos)
+        return "";
+    at += name.size() + 4;
+    return line.substr(at, line.find('"', at) - at);
+}
+
+static string caseId(const string &line)
+{
+    return text(line, "target") + "/" + text(line, "dist") + "/" + to_string(static_cast<int>(field(line, "threads")));
+}
+
+int main(int argc, char **argv)
+{
+    size_t ops = 1000000, keys = 100000;
+    double zipf = 0.99;
+    vector<int> threadCounts = {1, 2, 4, 8};
+    string filter, outPath, baselinePath;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--ops")
+            ops = stoull(value);
+        else if (flag == "--keys")
+            keys = stoull(value);
+        else if (flag == "--zipf")
+            zipf = stod(value);
+        else if (flag == "--filter")
+            filter = value;
+        else if (flag == "--out")
+            outPath = value;
+        else if (flag == "--baseline")
+            baselinePath = value;
+        else if (flag == "--threads")
+        {
+            threadCounts.clear();
+            stringstream list(value);
+            for (string item; getline(list, item, ',');)
+                threadCounts.push_back(stoi(item));
+        }
+        else
+        {
+            cerr << "unknown flag " << flag << "\n";
+            return 2;
+        }
+    }
+
+    map<string, string> baseline;
+    if (!baselinePath.empty())
+    {
+        ifstream in(baselinePath);
+        for (string line; getline(in, line);)
+            if (!line.empty())
+                baseline[caseId(line)] = line;
+    }
+    ofstream out;
+    if (!outPath.empty())
+        out.open(outPath);
+
+    cout << left << setw(24) << "target" << setw(10) << "dist" << setw(5) << "thr" << right
+         << setw(10) << "ns/op" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p999"
+         << setw(10) << "allocs" << setw(10) << "B/key" << (baseline.empty() ? "" : "   vs baseline") << "\n";
+
+    for (const string dist : {"uniform", "zipf", "highcard"})
+    {
+        Stream stream = makeStream(dist, ops, keys, zipf);
+        for (const TargetInfo &info : targets())
+        {
+            if (!filter.empty() && info.name.find(filter) == string::npos)
+                continue;
+            for (int threads : threadCounts)
+            {
+                if (threads < 1 || (threads > 1 && !info.threadSafe))
+                    continue;
+                string line = isolated(info, dist, threads, stream);
+                if (line.empty())
+                {
+                    cout << info.name << " " << dist << " " << threads << ": failed\n";
+                    continue;
+                }
+                if (out)
+                    out << line << "\n";
+                cout << left << setw(24) << info.name << setw(10) << dist << setw(5) << threads << right
+                     << fixed << setprecision(1) << setw(10) << field(line, "ns_per_decision")
+                     << setw(10) << field(line, "p50_ns") << setw(10) << field(line, "p99_ns")
+                     << setw(10) << field(line, "p999_ns") << setprecision(2)
+                     << setw(10) << field(line, "allocs_per_decision") << setprecision(0)
+                     << setw(10) << field(line, "bytes_per_key");
+                auto old = baseline.find(caseId(line));
+                if (old != baseline.end())
+                {
+                    auto delta = [&](const string &name)
+                    {
+                        double was = field(old->second, name);
+                        return was > 0 ? 100.0 * (field(line, name) - was) / was : 0.0;
+                    };
+                    cout << setprecision(1) << "   ns " << showpos << delta("ns_per_decision")
+                         << "%, p99 " << delta("p99_ns") << "%" << noshowpos;
+                }
+                cout << "\n";
+            }
+        }
+    }
+    return 0;
+}
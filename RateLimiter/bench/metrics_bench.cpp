@@ -0,0 +1,138 @@
+// Cost of RateLimiterService's built-in metrics per decision.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/metrics_bench.cpp -o metrics_bench
+//        g++ -std=c++17 -O2 -pthread -DRATE_LIMITER_NO_METRICS bench/metrics_bench.cpp -o metrics_bench_off
+//        (make builds both)
+// Usage: ./metrics_bench [users=100000] [decisionsPerThread=5000000] [--dump]
+//
+// Runs the same Zipf-skewed handleRequest(userId, type) stream at 1, 2 and
+// 4 threads and prints ns/decision; compare the two builds for the
+// overhead. The stream is mostly rejections: the tier limits are small
+// next to the hot users' share. The "record" rows time ShardMetrics::record
+// alone, which is the part the builds differ in apart from the sampled clock
+// reads:
+//
+//   accept  an accepted decision (no key bookkeeping)
+//   reject  rejections drawn from the same Zipf stream (top keys mostly hit)
+//   spray   every rejection a different 40-byte key, as from an attacker
+//           rotating keys, so each one takes over a top-rejected entry
+//
+// --dump prints the last run's MetricsSnapshot::dump().
+#include <bits/stdc++.h>
+#include "../include/RateLimiterService.h"
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    vector<string> args;
+    bool dump = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--dump")
+            dump = true;
+        else
+            args.push_back(argv[i]);
+    }
+    size_t users = args.size() > 0 ? stoull(args[0]) : 100000;
+    size_t decisions = args.size() > 1 ? stoull(args[1]) : 5000000;
+
+    mt19937_64 rng(5);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> keys(users);
+    vector<UserType> types(users);
+    vector<double> cdf(users);
+    double sum = 0;
+    for (size_t i = 0; i < users; i++)
+    {
+        keys[i] = "user_" + to_string(i);
+        types[i] = static_cast<UserType>(tierMix(rng));
+        cdf[i] = sum += 1.0 / (i + 1);
+    }
+    // Pre-drawn stream so the timed loop is only the decision.
+    vector<uint32_t> stream(1 << 20);
+    uniform_real_distribution<double> pick(0, sum);
+    for (uint32_t &u : stream)
+        u = static_cast<uint32_t>(min<size_t>(lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin(), users - 1));
+
+#ifdef RATE_LIMITER_NO_METRICS
+    cout << "metrics: compiled out\n";
+#else
+    cout << "metrics: on (latency sampled 1 in " << ShardMetrics::LATENCY_SAMPLE_PERIOD << ")\n";
+#endif
+    cout << left << setw(9) << "threads" << "ns/decision\n";
+    string last;
+    for (int threads : {1, 2, 4})
+    {
+        RateLimiterService service;
+        for (size_t i = 0; i < users; i++)
+            service.handleRequest(keys[i], types[i]);
+
+        auto begin = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (int t = 0; t < threads; t++)
+        {
+            pool.emplace_back([&, t]
+            {
+                size_t at = static_cast<size_t>(t) * 7919;
+                for (size_t i = 0; i < decisions; i++)
+                {
+                    uint32_t u = stream[(at + i) & (stream.size() - 1)];
+                    service.handleRequest(keys[u], types[u]);
+                }
+            });
+        }
+        for (thread &th : pool)
+            th.join();
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() /
+                    (decisions * threads);
+        cout << left << setw(9) << threads << fixed << setprecision(1) << ns << "\n";
+        last = service.getMetrics().dump();
+    }
+    vector<uint64_t> hashes(users);
+    for (size_t i = 0; i < users; i++)
+        hashes[i] = hash<string>{}(keys[i]);
+    vector<string> sprayKeys(1 << 12);
+    vector<uint64_t> sprayHashes(sprayKeys.size());
+    for (size_t i = 0; i < sprayKeys.size(); i++)
+    {
+        sprayKeys[i] = "attacker_rotating_key_" + to_string(1000000000000000000ull + i);
+        sprayHashes[i] = hash<string>{}(sprayKeys[i]);
+    }
+    vector<int> tiers(1024);
+    for (size_t i = 0; i < tiers.size(); i++)
+        tiers[i] = static_cast<int>(types[i % users]);
+    // Callers pass the key and its hash as RateLimiterService does.
+    auto timeRecord = [&](const char *name, bool allowed, auto keyOf)
+    {
+        ShardMetrics metrics;
+        const size_t calls = 50000000;
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < calls; i++)
+        {
+            ShardMetrics::Sample sample;
+            auto [key, keyHash] = keyOf(i);
+            metrics.record(tiers[i & 1023], AlgorithmType::COUNTER, allowed, *key, keyHash,
+                           sample);
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / calls;
+        MetricsSnapshot snapshot;
+        metrics.collect(snapshot);
+        DecisionCounts total = snapshot.total();
+        cout << left << setw(9) << "record" << setw(8) << name << fixed << setprecision(1) << ns << " ("
+             << total.accepted + total.rejected << " counted)\n";
+    };
+    timeRecord("accept", true, [&](size_t) { return make_pair(&keys[0], hashes[0]); });
+    timeRecord("reject", false, [&](size_t i)
+    {
+        uint32_t u = stream[i & (stream.size() - 1)];
+        return make_pair(&keys[u], hashes[u]);
+    });
+    timeRecord("spray", false, [&](size_t i)
+    {
+        size_t k = i & (sprayKeys.size() - 1);
+        return make_pair(&sprayKeys[k], sprayHashes[k]);
+    });
+    if (dump)
+        cout << "\n" << last;
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Request latency while tier policies are reloaded and users change tier,
+// and a check that flipping tiers does not hand out extra quota.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/policy_reload_bench.cpp -o policy_reload_bench
+// Usage: ./policy_reload_bench [users=100000] [threads=4] [seconds=2] [reloadMs=50]
+//
+//   baseline  request threads only
+//   reload    the same, while a writer thread publishes a new policy every
+//             reloadMs and moves every user to another tier with
+//             changeTiers after each one; request threads keep passing
+//             each user's original tier, so a changed user migrates back
+//             on its next request
+//
+// Latency is measured per handleRequest call; "changed" is how many tier
+// changes the writer made during the run.
+//
+// The gaming check runs on a simulated clock: a FREE user spends its
+// window, is upgraded to PREMIUM_3 and spends that, then is flipped between
+// FREE and PREMIUM_3 `flips` times. With the used quota carried across
+// every change it can never get more than one PREMIUM_3 window's worth.
+#include <bits/stdc++.h>
+#include "../include/RateLimiterService.h"
+using namespace std;
+
+struct Latency
+{
+    vector<uint32_t> nanos;
+    uint64_t requests = 0;
+};
+
+static array<RateLimitConfig, TIER_COUNT> scaled(int factor)
+{
+    array<RateLimitConfig, TIER_COUNT> tiers;
+    for (int t = 0; t < TIER_COUNT; t++)
+    {
+        tiers[t] = TIER_CONFIGS[t];
+        tiers[t].maxRequests *= factor;
+    }
+    return tiers;
+}
+
+static void run(const char *name, const vector<User> &users, int threads, double seconds, int reloadMs)
+{
+    PolicyStore store;
+    RateLimiterService service(RateLimiterService::defaultShardCount(), EvictionPolicy(), systemClock(), store);
+    for (const User &user : users)
+        service.handleRequest(user);
+
+    atomic<bool> stop{false};
+    vector<Latency> latency(threads);
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&, t]
+        {
+            mt19937_64 rng(50 + t);
+            Latency &mine = latency[t];
+            while (!stop.load(memory_order_relaxed))
+            {
+                const User &user = users[rng() % users.size()];
+                auto begin = chrono::steady_clock::now();
+                service.handleRequest(user.userId, user.type);
+                auto end = chrono::steady_clock::now();
+                mine.nanos.push_back(static_cast<uint32_t>(min<int64_t>(
+                    chrono::duration_cast<chrono::nanoseconds>(end - begin).count(), UINT32_MAX)));
+                mine.requests++;
+            }
+        });
+    }
+
+    uint64_t reloads = 0, changed = 0;
+    thread writer;
+    if (reloadMs > 0)
+    {
+        writer = thread([&]
+        {
+            vector<User> moved = users;
+            while (!stop.load(memory_order_relaxed))
+            {
+                store.update(scaled(1 + reloads % 2));
+                reloads++;
+                for (User &user : moved)
+                    user.type = static_cast<UserType>((static_cast<int>(user.type) + 1) % TIER_COUNT);
+                service.changeTiers(moved);
+                changed += moved.size();
+                this_thread::sleep_for(chrono::milliseconds(reloadMs));
+            }
+        });
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    for (thread &th : pool)
+        th.join();
+    if (writer.joinable())
+        writer.join();
+
+    vector<uint32_t> all;
+    uint64_t requests = 0;
+    for (Latency &l : latency)
+    {
+        all.insert(all.end(), l.nanos.begin(), l.nanos.end());
+        requests += l.requests;
+    }
+    sort(all.begin(), all.end());
+    auto at = [&](double q)
+    { return all.empty() ? 0u : all[min(all.size() - 1, static_cast<size_t>(q * all.size()))]; };
+    cout << left << setw(10) << name << setw(12) << fixed << setprecision(2) << requests / seconds / 1e6
+         << setw(10) << at(0.5) << setw(10) << at(0.99) << setw(10) << at(0.999) << setw(12) << all.back()
+         << setw(9) << reloads << changed << "\n";
+}
+
+static void gamingCheck(int flips)
+{
+    SimulatedClock clock(1000000000000);
+    PolicyStore store;
+    RateLimiterService service(4, EvictionPolicy(), clock, store);
+    string id = "gamer";
+    uint64_t admitted = 0;
+    auto spend = [&](UserType type)
+    {
+        for (int i = 0; i < 200; i++)
+            admitted += service.handleRequest(id, type);
+    };
+    spend(UserType::FREE);
+    service.changeTier(id, UserType::PREMIUM_3);
+    spend(UserType::PREMIUM_3);
+    for (int i = 0; i < flips; i++)
+    {
+        service.changeTier(id, i % 2 ? UserType::PREMIUM_3 : UserType::FREE);
+        spend(i % 2 ? UserType::PREMIUM_3 : UserType::FREE);
+    }
+    int bound = TIER_CONFIGS[static_cast<int>(UserType::PREMIUM_3)].maxRequests;
+    cout << "gaming: admitted " << admitted << " over " << flips << " flips, bound " << bound
+         << (admitted <= static_cast<uint64_t>(bound) ? " (ok)" : " (EXCEEDED)") << "\n";
+}
+
+int main(int argc, char **argv)
+{
+    size_t userCount = argc > 1 ? stoull(argv[1]) : 100000;
+    int threads = argc > 2 ? stoi(argv[2]) : 4;
+    double seconds = argc > 3 ? stod(argv[3]) : 2;
+    int reloadMs = argc > 4 ? stoi(argv[4]) : 50;
+
+    mt19937_64 rng(17);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<User> users(userCount);
+    for (size_t i = 0; i < userCount; i++)
+        users[i] = User{"user_" + to_string(i), static_cast<UserType>(tierMix(rng))};
+
+    cout << left << setw(10) << "run" << setw(12) << "Mreq/s" << setw(10) << "p50 ns" << setw(10) << "p99 ns"
+         << setw(10) << "p99.9 ns" << setw(12) << "max ns" << setw(9) << "reloads" << "changed\n";
+    run("baseline", users, threads, seconds, 0);
+    run("reload", users, threads, seconds, reloadMs);
+    gamingCheck(20);
+    return 0;
+}
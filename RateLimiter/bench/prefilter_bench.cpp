@@ -0,0 +1,166 @@
+// Memory and accuracy of RateLimiterService's heavy-hitter pre-filter
+// under a credential-stuffing style key flood, on a simulated clock.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/prefilter_bench.cpp -o prefilter_bench
+// Usage: ./prefilter_bench [requests=6000000] [seconds=60] [floodShare=0.5] [promoteAt=2]
+//
+// The stream mixes three kinds of request, spread evenly over `seconds`:
+//
+//   users     100k known users, Zipf-skewed (s = 1.0), tier mix 70/15/10/5
+//   flood     floodShare of all requests, each from a never-seen FREE key
+//   hammer    5% from 100 FREE keys that exceed their quota all the time
+//
+// The exact service decides everything with per-key state; each filtered
+// service runs the same stream with a pre-filter of the given budget.
+// "false rej" is the share of the exact service's accepted requests from
+// known users that the filtered one rejected; "over adm" is the share of
+// all the exact service's rejections the filtered one accepted. "bytes" is
+// the service's tables plus the sketch, "keys" the tracked limiter count
+// at the end of each sixth of the stream.
+//
+// Before the table it checks that a FREE key mixing unit and multi-unit
+// requests gets no more than its tier quota through the sketch and the
+// promoted limiter together; main returns 1 if it does not.
+#include <bits/stdc++.h>
+#include "../include/RateLimiterService.h"
+using namespace std;
+
+struct Request
+{
+    int64_t at;
+    uint32_t user;      // < users: known user; >= users: hammer key; UINT32_MAX: flood
+};
+
+// Every mix of costs, all within one window, must stay within FREE's 5 units.
+static bool costsAreCharged()
+{
+    const vector<vector<uint32_t>> mixes = {{1, 1, 1, 3, 3, 1, 1}, {3, 1, 3, 1, 1}, {1, 4, 2, 1}, {2, 2, 2, 2}};
+    for (size_t m = 0; m < mixes.size(); m++)
+    {
+        SimulatedClock clock(1000000000);
+        PolicyStore policies;
+        PrefilterPolicy prefilter;
+        prefilter.sketchBytes = 1 << 16;
+        prefilter.promoteAt = 4;
+        RateLimiterService service(1, EvictionPolicy(), clock, policies, prefilter);
+        uint32_t admitted = 0;
+        for (uint32_t cost : mixes[m])
+            if (service.tryAcquire("mixed", UserType::FREE, cost).allowed)
+                admitted += cost;
+        if (admitted > 5)
+        {
+            cerr << "cost mix " << m << " admitted " << admitted << " units, quota is 5\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (!costsAreCharged())
+        return 1;
+
+    size_t requests = argc > 1 ? stoull(argv[1]) : 6000000;
+    double seconds = argc > 2 ? stod(argv[2]) : 60;
+    double floodShare = argc > 3 ? stod(argv[3]) : 0.5;
+    uint32_t promoteAt = argc > 4 ? static_cast<uint32_t>(stoul(argv[4])) : 2;
+    const uint32_t users = 100000, hammers = 100;
+
+    mt19937_64 rng(19);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> names(users + hammers);
+    vector<UserType> types(users + hammers, UserType::FREE);
+    vector<double> cdf(users);
+    double sum = 0;
+    for (uint32_t u = 0; u < users; u++)
+    {
+        names[u] = "user_" + to_string(u);
+        types[u] = static_cast<UserType>(tierMix(rng));
+        cdf[u] = sum += 1.0 / (u + 1);
+    }
+    for (uint32_t h = 0; h < hammers; h++)
+        names[users + h] = "hammer_" + to_string(h);
+
+    uniform_real_distribution<double> unit(0, 1), pick(0, sum);
+    vector<Request> stream(requests);
+    for (size_t i = 0; i < requests; i++)
+    {
+        stream[i].at = 1000000000 + static_cast<int64_t>(seconds * 1e9 * i / requests);
+        double kind = unit(rng);
+        if (kind < floodShare)
+            stream[i].user = UINT32_MAX;
+        else if (kind < floodShare + 0.05)
+            stream[i].user = users + static_cast<uint32_t>(rng() % hammers);
+        else
+            stream[i].user = static_cast<uint32_t>(min<size_t>(lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin(), users - 1));
+    }
+
+    auto run = [&](size_t sketchBytes, vector<bool> &decisions)
+    {
+        SimulatedClock clock(0);
+        PolicyStore policies;
+        PrefilterPolicy prefilter;
+        prefilter.sketchBytes = sketchBytes;
+        prefilter.promoteAt = promoteAt;
+        RateLimiterService service(RateLimiterService::defaultShardCount(), EvictionPolicy(), clock, policies,
+                                   prefilter);
+        vector<size_t> keys;
+        size_t flood = 0;
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < requests; i++)
+        {
+            const Request &r = stream[i];
+            clock.set(r.at);
+            if (r.user == UINT32_MAX)
+                decisions[i] = service.handleRequest("flood_" + to_string(flood++), UserType::FREE);
+            else
+                decisions[i] = service.handleRequest(names[r.user], types[r.user]);
+            if ((i + 1) % (requests / 6) == 0)
+                keys.push_back(service.getEvictionStats().trackedKeys);
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / requests;
+        MetricsSnapshot metrics = service.getMetrics();
+        PrefilterStats stats = service.getPrefilterStats();
+        return make_tuple(ns, keys, metrics.approxBytes + stats.sketchBytes, stats);
+    };
+
+    cout << requests << " requests over " << seconds << " s, " << floodShare * 100 << "% flood, promoteAt "
+         << promoteAt << "\n\n";
+    cout << left << setw(10) << "sketch" << setw(8) << "ns/req" << setw(12) << "bytes" << setw(11) << "false rej"
+         << setw(10) << "over adm" << setw(10) << "promoted" << "keys\n";
+
+    vector<bool> exact(requests);
+    auto [exactNs, exactKeys, exactBytes, exactStats] = run(0, exact);
+    (void)exactStats;
+    auto printKeys = [](const vector<size_t> &keys)
+    {
+        for (size_t k : keys)
+            cout << k << ' ';
+        cout << "\n";
+    };
+    cout << left << setw(10) << "exact" << setw(8) << fixed << setprecision(0) << exactNs << setw(12) << exactBytes
+         << setw(11) << "-" << setw(10) << "-" << setw(10) << "-";
+    printKeys(exactKeys);
+
+    size_t accepted = count(exact.begin(), exact.end(), true), knownAccepted = 0;
+    for (size_t i = 0; i < requests; i++)
+        knownAccepted += stream[i].user < users && exact[i];
+    for (size_t budget : {size_t(4) << 20, size_t(16) << 20, size_t(64) << 20})
+    {
+        vector<bool> filtered(requests);
+        auto [ns, keys, bytes, stats] = run(budget, filtered);
+        size_t falseRejects = 0, overAdmits = 0;
+        for (size_t i = 0; i < requests; i++)
+        {
+            falseRejects += stream[i].user < users && exact[i] && !filtered[i];
+            overAdmits += !exact[i] && filtered[i];
+        }
+        cout << left << setw(10) << (to_string(budget >> 20) + " MiB") << setw(8) << fixed << setprecision(0) << ns
+             << setw(12) << bytes << setw(11) << setprecision(3) << (100.0 * falseRejects / max<size_t>(1, knownAccepted))
+             << setw(10) << (100.0 * overAdmits / max<size_t>(1, requests - accepted)) << setw(10) << stats.promoted;
+        printKeys(keys);
+    }
+    cout << "\n(false rej and over adm in %)\n";
+    return 0;
+}
@@ -0,0 +1,261 @@
+// Pre-fork workers sharing one SharedMemoryRateLimiterService segment,
+// against each worker keeping a private FlatRateLimiterService.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/shared_memory_bench.cpp -o shared_memory_bench
+// Usage: ./shared_memory_bench [workers=4] [users=1000] [seconds=2] [crashes=50]
+//
+//   private  every worker has its own FlatRateLimiterService
+//   shared   the parent creates the segment, then forks the workers
+//   crash    shared, while extra workers are forked and SIGKILLed mid-run
+//            `crashes` times; only the surviving workers report
+//
+// Workers send requests for uniformly chosen users (tier mix 70/15/10/5)
+// as fast as they can. "bound" is what one token bucket per user could
+// admit over the run. "memory" is the state held across all workers.
+//
+// Before timing, a simulated clock checks that a drained key idle for days
+// (up to and past the 2^40-tick stamp wrap) comes back with a full bucket,
+// that a key drained at time 0 stays drained, and that a segment whose
+// creator died before marking it ready is replaced.
+#include <bits/stdc++.h>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../include/SharedMemoryRateLimiterService.h"
+#include "../include/FlatRateLimiterService.h"
+using namespace std;
+
+struct WorkerResult
+{
+    uint64_t decisions = 0, admitted = 0, memoryBytes = 0;
+    double seconds = 0;
+};
+
+template <typename Decide>
+static WorkerResult drive(int worker, const vector<string> &keys, const vector<UserType> &types,
+                          double seconds, Decide decide)
+{
+    WorkerResult result;
+    mt19937_64 rng(70 + worker);
+    auto begin = chrono::steady_clock::now();
+    auto end = begin + chrono::duration<double>(seconds);
+    while (true)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            size_t u = rng() % keys.size();
+            result.admitted += decide(keys[u], types[u]);
+            result.decisions++;
+        }
+        auto now = chrono::steady_clock::now();
+        if (now >= end)
+        {
+            result.seconds = chrono::duration<double>(now - begin).count();
+            return result;
+        }
+    }
+}
+
+static pid_t spawn(function<WorkerResult()> work, int &readFd)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw runtime_error("pipe failed");
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        WorkerResult r = work();
+        ssize_t written = write(fds[1], &r, sizeof(r));
+        _exit(written == static_cast<ssize_t>(sizeof(r)) ? 0 : 1);
+    }
+    close(fds[1]);
+    readFd = fds[0];
+    return pid;
+}
+
+static WorkerResult collect(vector<pair<pid_t, int>> &children)
+{
+    WorkerResult total;
+    for (auto &[pid, fd] : children)
+    {
+        WorkerResult r;
+        if (read(fd, &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r)))
+        {
+            total.decisions += r.decisions;
+            total.admitted += r.admitted;
+            total.memoryBytes += r.memoryBytes;
+            total.seconds += r.seconds;
+        }
+        close(fd);
+        waitpid(pid, nullptr, 0);
+    }
+    return total;
+}
+
+// Drains one FREE key, leaves it idle for each gap, and expects the whole
+// burst back every time.
+static bool idleKeysRefill(const string &name)
+{
+    const int64_t day = 86400 * 1000000000ll;
+    const int burst = RateLimitPolicy::getConfig(UserType::FREE).maxRequests;
+    SimulatedClock clock(1000000000);
+    SharedMemoryRateLimiterService::remove(name);
+    SharedMemoryRateLimiterService table(name, 16, clock);
+    bool ok = true;
+    for (int64_t idle : {day, 7 * day, 10 * day, 12 * day + day / 2, 13 * day, 30 * day})
+    {
+        while (table.handleRequest("idle_user", UserType::FREE))
+            ;
+        clock.advance(idle);
+        int admitted = 0;
+        while (admitted <= burst && table.handleRequest("idle_user", UserType::FREE))
+            admitted++;
+        if (admitted != burst)
+        {
+            cerr << "idle " << idle / day << " days: admitted " << admitted << " of " << burst << "\n";
+            ok = false;
+        }
+    }
+    SharedMemoryRateLimiterService::remove(name);
+    return ok;
+}
+
+// A bucket emptied in tick 0 packs to an all-zero word; it must not read
+// as an unset slot and come back full.
+static bool drainedAtTimeZero(const string &name)
+{
+    const int burst = RateLimitPolicy::getConfig(UserType::FREE).maxRequests;
+    SimulatedClock clock(0);
+    SharedMemoryRateLimiterService::remove(name);
+    SharedMemoryRateLimiterService table(name, 16, clock);
+    int admitted = 0;
+    for (int i = 0; i < 3 * burst; i++)
+        admitted += table.handleRequest("early_user", UserType::FREE);
+    SharedMemoryRateLimiterService::remove(name);
+    if (admitted != burst)
+    {
+        cerr << "drained at time 0: admitted " << admitted << " of " << burst << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Leaves a segment sized but never marked ready, as a creator killed
+// mid-create would, and expects the next open to recover from it.
+static bool abandonedSegmentRecovers(const string &name)
+{
+    SharedMemoryRateLimiterService::remove(name);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 || ftruncate(fd, 4096) != 0)
+        return false;
+    close(fd);
+    try
+    {
+        SharedMemoryRateLimiterService table(name, 16);
+        bool ok = table.handleRequest("user", UserType::FREE);
+        SharedMemoryRateLimiterService::remove(name);
+        return ok;
+    }
+    catch (const exception &e)
+    {
+        cerr << "abandoned segment: " << e.what() << "\n";
+        SharedMemoryRateLimiterService::remove(name);
+        return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int workers = argc > 1 ? stoi(argv[1]) : 4;
+    size_t users = argc > 2 ? stoull(argv[2]) : 1000;
+    double seconds = argc > 3 ? stod(argv[3]) : 2;
+    int crashes = argc > 4 ? stoi(argv[4]) : 50;
+
+    mt19937_64 rng(3);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> keys(users);
+    vector<UserType> types(users);
+    double bound = 0;
+    for (size_t i = 0; i < users; i++)
+    {
+        keys[i] = "user_" + to_string(i);
+        types[i] = static_cast<UserType>(tierMix(rng));
+        RateLimitConfig config = RateLimitPolicy::getConfig(types[i]);
+        bound += config.maxRequests * (1 + seconds / config.timeWindow.seconds());
+    }
+
+    string name = "/shared_memory_bench_" + to_string(getpid());
+    if (!idleKeysRefill(name) || !drainedAtTimeZero(name) || !abandonedSegmentRecovers(name))
+        return 1;
+
+    cout << workers << " workers, " << users << " users, " << seconds << " s; bound " << fixed
+         << setprecision(0) << bound << " admitted\n";
+    cout << left << setw(9) << "path" << setw(13) << "ns/decision" << setw(13) << "decisions" << setw(11)
+         << "admitted" << setw(9) << "x bound" << "memory\n";
+    auto report = [&](const char *path, const WorkerResult &r)
+    {
+        cout << left << setw(9) << path << setw(13) << setprecision(1)
+             << (r.decisions ? r.seconds * 1e9 / r.decisions : 0) << setw(13) << r.decisions << setw(11)
+             << r.admitted << setw(9) << setprecision(2) << r.admitted / bound << setprecision(1)
+             << r.memoryBytes / 1e3 << " kB\n";
+    };
+
+    {
+        vector<pair<pid_t, int>> children;
+        for (int w = 0; w < workers; w++)
+        {
+            int fd;
+            pid_t pid = spawn([&, w]
+            {
+                FlatRateLimiterService service(FlatRateLimiterService::defaultShardCount(), users);
+                WorkerResult r = drive(w, keys, types, seconds, [&](const string &id, UserType type)
+                                       { return service.handleRequest(string_view(id), type); });
+                r.memoryBytes = service.memoryBytes();
+                return r;
+            }, fd);
+            children.emplace_back(pid, fd);
+        }
+        report("private", collect(children));
+    }
+
+    for (bool crash : {false, true})
+    {
+        SharedMemoryRateLimiterService::remove(name);
+        SharedMemoryRateLimiterService table(name, users);
+        vector<pair<pid_t, int>> children;
+        for (int w = 0; w < workers; w++)
+        {
+            int fd;
+            pid_t pid = spawn([&, w]
+            {
+                return drive(w, keys, types, seconds, [&](const string &id, UserType type)
+                             { return table.handleRequest(string_view(id), type); });
+            }, fd);
+            children.emplace_back(pid, fd);
+        }
+        if (crash)
+        {
+            // Victims run the same loop and are killed wherever they are.
+            mt19937_64 pick(11);
+            for (int c = 0; c < crashes; c++)
+            {
+                int fd;
+                pid_t victim = spawn([&, c]
+                {
+                    return drive(1000 + c, keys, types, seconds, [&](const string &id, UserType type)
+                                 { return table.handleRequest(string_view(id), type); });
+                }, fd);
+                this_thread::sleep_for(chrono::microseconds(200 + pick() % static_cast<uint64_t>(seconds * 1e6 / crashes)));
+                kill(victim, SIGKILL);
+                waitpid(victim, nullptr, 0);
+                close(fd);
+            }
+        }
+        WorkerResult total = collect(children);
+        total.memoryBytes = table.memoryBytes();
+        report(crash ? "crash" : "shared", total);
+    }
+    SharedMemoryRateLimiterService::remove(name);
+    return 0;
+}
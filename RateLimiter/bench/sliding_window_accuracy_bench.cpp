@@ -0,0 +1,140 @@
+// Accuracy and cost of the sliding-window counter against the exact log.
+//
+// Build: g++ -std=c++17 -O2 bench/sliding_window_accuracy_bench.cpp -o sliding_window_accuracy_bench
+//
+// Both limiters are driven by the same simulated timestamps (PREMIUM_3 style
+// policy: 100 requests / 60 s). "exact" is the timestamp-log algorithm of
+// SlidingWindowRateLimiter, run at nanosecond resolution so the comparison
+// is not blurred by time(nullptr)'s one-second granularity.
+#include <bits/stdc++.h>
+#include "../include/SlidingWindowCounterRateLimiter.h"
+using namespace std;
+
+static const int LIMIT = 100;
+static const int WINDOW = 60;
+static const int64_t WINDOW_NS = (int64_t)WINDOW * 1000000000;
+
+class ExactLog
+{
+    unordered_map<string, deque<int64_t>> requests;
+
+public:
+    bool allowRequestAt(const string &userId, int64_t now)
+    {
+        auto &q = requests[userId];
+        while (!q.empty() && now - q.front() >= WINDOW_NS)
+            q.pop_front();
+        if (q.size() >= (size_t)LIMIT)
+            return false;
+        q.push_back(now);
+        return true;
+    }
+};
+
+struct Result
+{
+    long long requests = 0, exactAllowed = 0, approxAllowed = 0;
+    long long falseRejects = 0, falseAccepts = 0;
+    int worstWindow = 0; // most approx-accepted requests in any true 60 s window
+};
+
+// Poisson arrivals at `load` times the allowed rate, optionally in bursts.
+static Result simulate(double load, bool bursty, int users, int64_t durationNs, uint64_t seed)
+{
+    mt19937_64 rng(seed);
+    double ratePerNs = load * LIMIT / (double)WINDOW_NS;
+    exponential_distribution<double> gap(bursty ? ratePerNs / 10 : ratePerNs);
+
+    Result r;
+    ExactLog exact;
+    SlidingWindowCounterRateLimiter approx(LIMIT, WINDOW);
+
+    for (int u = 0; u < users; u++)
+    {
+        string key = "user_" + to_string(u);
+        deque<int64_t> accepted;
+        int64_t now = (int64_t)(rng() % WINDOW_NS) + WINDOW_NS;
+        int64_t end = now + durationNs;
+        while (now < end)
+        {
+            int burst = bursty ? 10 : 1;
+            for (int b = 0; b < burst; b++)
+            {
+                bool e = exact.allowRequestAt(key, now);
+                bool a = approx.allowRequestAt(key, now);
+                r.requests++;
+                r.exactAllowed += e;
+                r.approxAllowed += a;
+                r.falseRejects += (e && !a);
+                r.falseAccepts += (!e && a);
+                if (a)
+                {
+                    accepted.push_back(now);
+                    while (now - accepted.front() >= WINDOW_NS)
+                        accepted.pop_front();
+                    r.worstWindow = max(r.worstWindow, (int)accepted.size());
+                }
+                now += 1000;
+            }
+            now += (int64_t)gap(rng);
+        }
+    }
+    return r;
+}
+
+int main()
+{
+    const int users = 200;
+    const int64_t duration = 10 * WINDOW_NS;
+
+    cout << "policy: " << LIMIT << " req / " << WINDOW << " s, " << users
+         << " users, " << duration / WINDOW_NS << " windows each\n\n";
+    cout << left << setw(16) << "traffic" << setw(12) << "requests"
+         << setw(12) << "exact ok" << setw(12) << "approx ok"
+         << setw(12) << "diff %" << setw(14) << "false rej %"
+         << setw(14) << "false acc %" << "worst window\n";
+
+    for (bool bursty : {false, true})
+    {
+        for (double load : {0.5, 1.0, 2.0, 5.0})
+        {
+            Result r = simulate(load, bursty, users, duration, 42);
+            string name = (bursty ? "burst x" : "poisson x") + to_string(load).substr(0, 3);
+            cout << left << setw(16) << name << setw(12) << r.requests
+                 << setw(12) << r.exactAllowed << setw(12) << r.approxAllowed
+                 << fixed << setprecision(3)
+                 << setw(12) << 100.0 * (r.approxAllowed - r.exactAllowed) / max(1LL, r.exactAllowed)
+                 << setw(14) << 100.0 * r.falseRejects / r.requests
+                 << setw(14) << 100.0 * r.falseAccepts / r.requests
+                 << r.worstWindow << "/" << LIMIT << "\n";
+        }
+    }
+
+    // Steady-state cost: every key at its limit, so the log holds LIMIT entries.
+    const int keys = 20000;
+    vector<string> names;
+    for (int i = 0; i < keys; i++)
+        names.push_back("k" + to_string(i));
+    ExactLog exact;
+    SlidingWindowCounterRateLimiter approx(LIMIT, WINDOW);
+    int64_t now = WINDOW_NS;
+    auto time = [&](auto &limiter)
+    {
+        auto begin = chrono::steady_clock::now();
+        long long n = 0;
+        for (int round = 0; round < 2 * LIMIT; round++)
+            for (const string &k : names)
+                n += limiter.allowRequestAt(k, now + round * (WINDOW_NS / (2 * LIMIT)));
+        auto end = chrono::steady_clock::now();
+        return chrono::duration<double, nano>(end - begin).count() / (2.0 * LIMIT * keys);
+    };
+    double exactNs = time(exact);
+    double approxNs = time(approx);
+
+    cout << "\nns/decision at the limit: exact " << fixed << setprecision(1) << exactNs
+         << ", approx " << approxNs << "\n";
+    cout << "state bytes/key (excluding map node and key): exact ~"
+         << sizeof(deque<int64_t>) + LIMIT * sizeof(int64_t) << ", approx "
+         << 16 << "\n";
+    return 0;
+}
@@ -0,0 +1,165 @@
+// One hot key charged by many threads: ATOMIC_TOKEN_BUCKET (one shared
+// word) against SLOPPY_COUNTER (per-CPU slots over a shared pool).
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/sloppy_counter_bench.cpp -o sloppy_counter_bench
+// Usage: ./sloppy_counter_bench [decisionsPerThread=2000000] [maxThreads=64]
+//
+//   throughput  M decisions/s over all threads at 1..maxThreads, on a limit
+//               loose enough that nearly every request is admitted (60000
+//               per ms, the most an atomic bucket holds), so each decision
+//               writes the key's state
+//   accuracy    threads hammer a key limited to 60000 per second for about
+//               2 s; a token bucket starting full admits at most 60000 plus
+//               60000 per second elapsed ("bound", from creating the limiter
+//               to the last thread stopping), and the sloppy counter may
+//               exceed that by its slack
+//
+// Before timing, a key allowed 10 per minute with maxOverAdmission 2 set
+// through the factory is hammered by every CPU and must admit at most 12,
+// and on a simulated clock multi-unit charges must not leave a slot holding
+// more than its allotment when the pool refills.
+#include <bits/stdc++.h>
+#include "../include/RateLimiterFactory.h"
+using namespace std;
+
+static double throughput(RateLimiter &limiter, int threads, size_t decisions)
+{
+    atomic<bool> start{false};
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]
+        {
+            while (!start.load(memory_order_acquire))
+                this_thread::yield();
+            for (size_t i = 0; i < decisions; i++)
+                limiter.allowRequest("tenant");
+        });
+    }
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    for (thread &th : pool)
+        th.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return threads * decisions / seconds / 1e6;
+}
+
+// Admitted requests, and the bound for the time the limiter was in use.
+static pair<int64_t, int64_t> hammer(AlgorithmType algorithm, int limit, int threads, double seconds)
+{
+    auto begin = chrono::steady_clock::now();
+    auto limiter = RateLimiterFactory::createLimiter({limit, 1, algorithm});
+    atomic<bool> stop{false};
+    atomic<int64_t> admitted{0};
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]
+        {
+            int64_t local = 0;
+            while (!stop.load(memory_order_relaxed))
+                local += limiter->allowRequest("tenant");
+            admitted += local;
+        });
+    }
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    for (thread &th : pool)
+        th.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return {admitted.load(), static_cast<int64_t>(limit * (1 + elapsed))};
+}
+
+// The over-admission bound holds even when it is below the CPU count. A
+// bound of 0 picks 10 / 16, which is 0 as well.
+static bool smallBoundHolds(int threads)
+{
+    for (int64_t bound : {0, 1, 2, 7})
+    {
+        if (SloppyCounterRateLimiter(10, 60, bound).slack() > bound)
+        {
+            cerr << "maxOverAdmission " << bound << " gave slack "
+                 << SloppyCounterRateLimiter(10, 60, bound).slack() << "\n";
+            return false;
+        }
+    }
+    auto limiter = RateLimiterFactory::createLimiter({10, 60, AlgorithmType::SLOPPY_COUNTER, 2});
+    atomic<int64_t> admitted{0};
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back([&]
+        {
+            for (int i = 0; i < 10000; i++)
+                admitted += limiter->allowRequest("tenant");
+        });
+    for (thread &th : pool)
+        th.join();
+    if (admitted > 12)
+    {
+        cerr << "10 per minute with maxOverAdmission 2 admitted " << admitted << "\n";
+        return false;
+    }
+    return true;
+}
+
+// A multi-unit charge that finds its slot short must count the leftover
+// toward its cost: if the slot could end above the allotment, tokens left
+// in it when the pool refills would exceed slack().
+static bool multiUnitStaysInSlack()
+{
+    SimulatedClock clock(1000000000);
+    SloppyCounterRateLimiter limiter(100, 60, 8, clock);
+    for (uint32_t cost : {1, 5, 5})
+        limiter.tryAcquire("tenant", cost);
+    clock.advance(60 * 1000000000ll);
+    int64_t admitted = 0;
+    while (limiter.allowRequest("tenant"))
+        admitted++;
+    if (admitted > 100 + limiter.slack())
+    {
+        cerr << "window after multi-unit charges admitted " << admitted << ", bound " << 100 + limiter.slack()
+             << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t decisions = argc > 1 ? stoull(argv[1]) : 2000000;
+    int maxThreads = argc > 2 ? stoi(argv[2]) : 64;
+    if (!smallBoundHolds(max<int>(thread::hardware_concurrency(), 2)) || !multiUnitStaysInSlack())
+        return 1;
+
+    cout << thread::hardware_concurrency() << " CPUs\n\n"
+         << left << setw(9) << "threads" << setw(12) << "atomic" << "sloppy   (M decisions/s)\n";
+    RateLimitConfig loose{60000, chrono::milliseconds(1), AlgorithmType::ATOMIC_TOKEN_BUCKET};
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        cout << left << setw(9) << threads << fixed << setprecision(1);
+        for (AlgorithmType algorithm : {AlgorithmType::ATOMIC_TOKEN_BUCKET, AlgorithmType::SLOPPY_COUNTER})
+        {
+            loose.algorithm = algorithm;
+            auto limiter = RateLimiterFactory::createLimiter(loose);
+            cout << setw(12) << throughput(*limiter, threads, decisions);
+        }
+        cout << "\n";
+    }
+
+    const int limit = 60000;
+    const double seconds = 2;
+    SloppyCounterRateLimiter probe(limit, 1);
+    cout << "\naccuracy: " << limit << " per second for " << seconds << " s, sloppy slack " << probe.slack() << "\n"
+         << left << setw(9) << "threads" << setw(20) << "atomic" << "sloppy   (admitted / bound)\n";
+    for (int threads : {1, 8, maxThreads})
+    {
+        cout << left << setw(9) << threads;
+        for (AlgorithmType algorithm : {AlgorithmType::ATOMIC_TOKEN_BUCKET, AlgorithmType::SLOPPY_COUNTER})
+        {
+            auto [admitted, bound] = hammer(algorithm, limit, threads, seconds);
+            cout << setw(20) << (to_string(admitted) + " / " + to_string(bound));
+        }
+        cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Warm restart of FlatRateLimiterService from a state snapshot, against
+// starting empty.
+//
+// Build: g++ -std=c++17 -O2 -pthread bench/snapshot_bench.cpp -o snapshot_bench
+// Usage: ./snapshot_bench [keys=10000000] [path=/tmp/limiter.snapshot]
+//
+// Fills a service with `keys` users (tier mix 70/15/10/5) and exhausts the
+// first 1% of them, then times:
+//
+//   cold fill     inserting every user through handleRequest, as a fresh
+//                 process does while traffic arrives
+//   save          saveSnapshot
+//   load          loadSnapshot into a fresh service with the same shard count
+//                 (slot arrays copied whole)
+//   load/rehash   loadSnapshot into a service with a different shard count
+//                 (keys re-inserted one by one)
+//
+// "herd" is the share of the exhausted users a restarted service admits on
+// their next request: everyone when starting empty, nobody when warm. All
+// services share a clock frozen at startup so no window ends mid-run.
+#include <bits/stdc++.h>
+#include "../include/FlatRateLimiterService.h"
+using namespace std;
+
+static double secondsSince(chrono::steady_clock::time_point begin)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? stoull(argv[1]) : 10000000;
+    string path = argc > 2 ? argv[2] : "/tmp/limiter.snapshot";
+
+    mt19937_64 rng(3);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> keys(count);
+    vector<UserType> types(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = "user_" + to_string(i);
+        types[i] = static_cast<UserType>(tierMix(rng));
+    }
+    size_t exhausted = max<size_t>(1, count / 100);
+
+    auto herd = [&](FlatRateLimiterService &service)
+    {
+        size_t admitted = 0;
+        for (size_t i = 0; i < exhausted; i++)
+            admitted += service.handleRequest(string_view(keys[i]), types[i]);
+        return 100.0 * admitted / exhausted;
+    };
+
+    size_t shards = FlatRateLimiterService::defaultShardCount();
+    SimulatedClock clock(monotonicNanos());
+    double coldFill, save, load, rehash, coldHerd, warmHerd;
+    {
+        FlatRateLimiterService service(shards, count, clock);
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
+            service.handleRequest(string_view(keys[i]), types[i]);
+        coldFill = secondsSince(begin);
+        for (size_t i = 0; i < exhausted; i++)
+        {
+            while (service.handleRequest(string_view(keys[i]), types[i]))
+                ;
+        }
+
+        begin = chrono::steady_clock::now();
+        service.saveSnapshot(path);
+        save = secondsSince(begin);
+    }
+    {
+        FlatRateLimiterService service(shards, count, clock);
+        coldHerd = herd(service);
+    }
+    {
+        FlatRateLimiterService service(shards, 0, clock);
+        auto begin = chrono::steady_clock::now();
+        if (!service.loadSnapshot(path))
+        {
+            cerr << "snapshot at " << path << " was not usable\n";
+            return 1;
+        }
+        load = secondsSince(begin);
+        if (service.size() != count)
+        {
+            cerr << "restored " << service.size() << " users, expected " << count << "\n";
+            return 1;
+        }
+        warmHerd = herd(service);
+    }
+    {
+        FlatRateLimiterService service(shards * 2, count, clock);
+        auto begin = chrono::steady_clock::now();
+        service.loadSnapshot(path);
+        rehash = secondsSince(begin);
+    }
+
+    ifstream file(path, ios::binary | ios::ate);
+    double megabytes = file.tellg() / 1e6;
+    cout << count << " users, " << shards << " shards, snapshot " << fixed << setprecision(0) << megabytes
+         << " MB\n"
+         << setprecision(1)
+         << "cold fill    " << coldFill * 1e3 << " ms\n"
+         << "save         " << save * 1e3 << " ms\n"
+         << "load         " << load * 1e3 << " ms\n"
+         << "load/rehash  " << rehash * 1e3 << " ms\n"
+         << "herd         cold " << coldHerd << "% of exhausted users admitted, warm " << warmHerd << "%\n";
+    remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include "RateLimiter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+// ---------------- Adaptive Concurrency Limiter ----------------
+// Caps requests in flight per key (typically one key per backend) instead
+// of requests per window, and finds the cap from the latencies callers
+// report through onComplete. Gradient-style, after Netflix's Gradient2:
+//
+//   short    mean latency of the last `batch` completions
+//   long     exponential average of the short means over about
+//            `longWindow` batches
+//   limit    at the end of each batch, the new estimate is
+//              limit * clamp(tolerance * long / short, 0.5, 1) + sqrt(limit)
+//            blended in with weight `smoothing`
+//
+// While latency holds near its long-term level the limit grows by about
+// sqrt(limit) per batch; once queueing pushes the short mean past
+// tolerance * long it shrinks, by at most half per batch. A batch that held
+// fewer than limit / 2 in flight is app-limited and does not grow the limit.
+// A completion at least timeoutNanos slow counts as a drop: it stays out of
+// the averages and its batch ends with limit *= backoff. When long lags far
+// behind a recovery (long > 2 * short) it decays toward short.
+//
+// tryAcquire(key, cost) admits cost requests at once; each one reports its
+// own onComplete. A rejection's retryAfterNanos is an estimate, the mean
+// gap between completions at the current latency; NEVER when cost exceeds
+// maxLimit. Until a key's first batch ends, the latency is the mean of the
+// completions seen so far, or before any completes timeoutNanos (if set)
+// else initialRttNanos. Thread-safe (one mutex), since completions usually arrive on
+// other threads than admissions.
+struct AdaptiveLimitParams
+{
+    int initialLimit = 20;
+    int minLimit = 1;
+    int maxLimit = 1000;
+    double tolerance = 1.5;
+    double smoothing = 0.2;
+    uint32_t batch = 16;
+    uint32_t longWindow = 600;      // batches
+    int64_t timeoutNanos = 0;       // 0: no completion counts as a drop
+    double backoff = 0.9;
+    int64_t initialRttNanos = 10000000;     // latency assumed before any completion
+};
+
+class AdaptiveConcurrencyLimiter : public RateLimiter
+{
+private:
+    struct KeyState
+    {
+        double limit;
+        int64_t inFlight = 0;
+        double longRtt = 0;
+        uint64_t batches = 0;
+        double batchSum = 0;
+        uint32_t batchSamples = 0;      // completions in batchSum (drops excluded)
+        uint32_t batchCount = 0;
+        int64_t batchMaxInFlight = 0;
+        bool batchDropped = false;
+        double shortRtt = 0;
+    };
+
+    AdaptiveLimitParams params;
+    std::unordered_map<std::string, KeyState> keys;
+    std::mutex mutex;
+
+    KeyState &stateFor(const std::string &userId)
+    {
+        auto it = keys.find(userId);
+        if (it == keys.end())
+        {
+            KeyState state;
+            state.limit = params.initialLimit;
+            it = keys.emplace(userId, state).first;
+        }
+        return it->second;
+    }
+
+    void endBatch(KeyState &state)
+    {
+        double limit = state.limit;
+        if (state.batchDropped)
+            limit *= params.backoff;
+        else if (state.batchSamples > 0)
+        {
+            state.shortRtt = state.batchSum / state.batchSamples;
+            state.batches++;
+            state.longRtt += (state.shortRtt - state.longRtt) / std::min<uint64_t>(state.batches, params.longWindow);
+            if (state.longRtt > 2 * state.shortRtt)
+                state.longRtt *= 0.95;
+            if (state.batchMaxInFlight * 2 >= state.limit)
+            {
+                double gradient = std::clamp(params.tolerance * state.longRtt / state.shortRtt, 0.5, 1.0);
+                double estimate = state.limit * gradient + std::sqrt(state.limit);
+                limit = state.limit * (1 - params.smoothing) + estimate * params.smoothing;
+            }
+        }
+        state.limit = std::clamp(limit, static_cast<double>(params.minLimit), static_cast<double>(params.maxLimit));
+        state.batchSum = 0;
+        state.batchSamples = 0;
+        state.batchCount = 0;
+        state.batchMaxInFlight = state.inFlight;
+        state.batchDropped = false;
+    }
+
+    double latencyOf(const KeyState &state) const
+    {
+        if (state.shortRtt > 0)
+            return state.shortRtt;
+        if (state.batchSamples > 0)
+            return state.batchSum / state.batchSamples;
+        return static_cast<double>(params.timeoutNanos > 0 ? params.timeoutNanos : params.initialRttNanos);
+    }
+
+public:
+    explicit AdaptiveConcurrencyLimiter(const AdaptiveLimitParams &params = AdaptiveLimitParams())
+        : params(params)
+    {
+        if (params.minLimit < 1 || params.maxLimit < params.minLimit || params.initialLimit < params.minLimit ||
+            params.initialLimit > params.maxLimit || params.batch == 0 || params.longWindow == 0 ||
+            params.initialRttNanos <= 0)
+            throw std::invalid_argument("Adaptive limit needs 1 <= minLimit <= initialLimit <= maxLimit, a batch "
+                                        "and a positive initialRttNanos");
+    }
+
+    bool allowRequest(const std::string &userId) override
+    {
+        return tryAcquire(userId, 1).allowed;
+    }
+
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        KeyState &state = stateFor(userId);
+        int64_t limit = static_cast<int64_t>(state.limit);
+        AcquireResult result;
+        if (state.inFlight + cost <= limit)
+        {
+            state.inFlight += cost;
+            state.batchMaxInFlight = std::max(state.batchMaxInFlight, state.inFlight);
+            result.allowed = true;
+            result.remaining = limit - state.inFlight;
+            return result;
+        }
+        result.remaining = std::max<int64_t>(limit - state.inFlight, 0);
+        if (cost > static_cast<uint32_t>(params.maxLimit))
+            result.retryAfterNanos = AcquireResult::NEVER;
+        else
+            result.retryAfterNanos = std::max<int64_t>(
+                1, static_cast<int64_t>(latencyOf(state) / std::max<int64_t>(state.inFlight, 1)));
+        return result;
+    }
+
+    void onComplete(const std::string &userId, int64_t latencyNanos) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        KeyState &state = stateFor(userId);
+        state.inFlight = std::max<int64_t>(state.inFlight - 1, 0);
+        if (params.timeoutNanos > 0 && latencyNanos >= params.timeoutNanos)
+            state.batchDropped = true;
+        else
+        {
+            state.batchSum += static_cast<double>(std::max<int64_t>(latencyNanos, 1));
+            state.batchSamples++;
+        }
+        if (++state.batchCount >= params.batch)
+            endBatch(state);
+    }
+
+    // Current cap and requests in flight for userId.
+    int limitFor(const std::string &userId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<int>(stateFor(userId).limit);
+    }
+
+    int64_t inFlightFor(const std::string &userId)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stateFor(userId).inFlight;
+    }
+};
@@ -0,0 +1,356 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "AtomicTokenBucketRateLimiter.h"
+#include "SlotAlgorithms.h"
+#include "Metrics.h"
+#include "Clock.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The tiers' schedules and the capacity they share; defaults() takes
+// TIER_SCHEDULE and GLOBAL_LIMIT.
+struct AdmissionSchedule
+{
+    std::array<TierSchedule, TIER_COUNT> tiers;
+    AggregateLimit capacity;
+    uint32_t quantum = 1; // units a tier may send per round, per unit of weight
+
+    static AdmissionSchedule defaults()
+    {
+        AdmissionSchedule schedule{};
+        for (int t = 0; t < TIER_COUNT; t++)
+            schedule.tiers[t] = TIER_SCHEDULE[t];
+        schedule.capacity = GLOBAL_LIMIT;
+        schedule.quantum = 1;
+        return schedule;
+    }
+};
+
+struct TierQueueStats
+{
+    uint64_t admitted = 0;  // at once or from the queue
+    uint64_t queued = 0;    // of those, admitted after waiting
+    uint64_t rejected = 0;  // tier queue full on arrival
+    uint64_t shed = 0;      // waited maxWait without being admitted
+    LatencyHistogram delay; // queueing delay of admitted requests, 0 if admitted at once
+};
+
+// ---------------- Admission Scheduler ----------------
+// Shares a backend's capacity between tiers under overload. It sits behind
+// the per-user limits: requests that passed their user's quota compete here
+// for `capacity`, an AggregateLimit refilled like a token bucket.
+//
+// While nothing is queued a request that fits is admitted at once. Otherwise
+// it joins its tier's FIFO queue, and tiers are served by deficit round
+// robin: each round a tier with waiters may send weight * quantum units,
+// and unused credit only carries over while it keeps waiters. Under
+// overload each tier gets capacity in proportion to its weight, and a tier
+// that asks for less leaves the rest to the others. A request that cannot be
+// admitted within its tier's maxWait is shed, and one arriving at a full
+// tier queue is rejected outright, so waits stay bounded; FREE, with the
+// smallest weight and shortest wait, is shed first (see TIER_SCHEDULE).
+//
+// Per request the work is a queue push and pop plus, per pass, a look at
+// each tier's head, independent of how many requests are queued. Quantum
+// should be at least the usual cost, or a large request takes several
+// rounds to be served.
+//
+// A dispatcher thread runs a pass whenever capacity for the next waiter or
+// a head's deadline comes due; completions run on it, outside the lock, and
+// should be short. Built with startThread false, the owner calls dispatch()
+// itself instead (an event loop, a simulation).
+class AdmissionScheduler
+{
+public:
+    enum class Admission
+    {
+        ADMITTED,   // admitted now; the completion is not called
+        QUEUED,     // the completion runs once the request is admitted or shed
+        REJECTED    // tier queue full; the completion is not called
+    };
+
+    using Completion = std::function<void(bool admitted)>;
+
+private:
+    struct Waiter
+    {
+        uint32_t cost;
+        int64_t enqueuedAt;
+        Completion onDone;
+    };
+
+    struct Tier
+    {
+        std::deque<Waiter> queue;
+        int64_t deficit = 0;
+        bool credited = false; // this round's quantum already added
+        bool active = false;   // in the round-robin ring
+        TierQueueStats stats;
+    };
+
+    AdmissionSchedule schedule;
+    TokenBucketParams bucket;
+    SlotState capacity = {0, 0};
+    Clock *clock;
+    std::array<Tier, TIER_COUNT> tiers;
+    std::array<int, TIER_COUNT> ring{}; // active tiers in visiting order
+    size_t ringHead = 0;
+    size_t ringSize = 0;
+    size_t waiting = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = true;
+    std::thread dispatcher;
+
+    using Ready = std::vector<std::pair<Completion, bool>>;
+
+    static int tierIndex(UserType type)
+    {
+        int tier = static_cast<int>(type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+        return tier;
+    }
+
+    void popRing()
+    {
+        ringHead = (ringHead + 1) % TIER_COUNT;
+        ringSize--;
+    }
+
+    void pushRing(int tier)
+    {
+        ring[(ringHead + ringSize) % TIER_COUNT] = tier;
+        ringSize++;
+    }
+
+    // Under the lock: sheds heads that waited maxWait, then serves tiers in
+    // round-robin order while capacity lasts. Returns when the next pass is
+    // due, or 0 when nothing is queued.
+    int64_t serve(int64_t now, Ready &ready)
+    {
+        for (int t = 0; t < TIER_COUNT; t++)
+        {
+            Tier &tier = tiers[t];
+            while (!tier.queue.empty() && now - tier.queue.front().enqueuedAt >= schedule.tiers[t].maxWait.nanos)
+            {
+                ready.emplace_back(std::move(tier.queue.front().onDone), false);
+                tier.queue.pop_front();
+                tier.stats.shed++;
+                waiting--;
+            }
+        }
+
+        int64_t due = 0;
+        while (ringSize > 0)
+        {
+            int t = ring[ringHead];
+            Tier &tier = tiers[t];
+            if (tier.queue.empty())
+            {
+                popRing();
+                tier.active = false;
+                tier.credited = false;
+                tier.deficit = 0;
+                continue;
+            }
+            if (!tier.credited)
+            {
+                tier.deficit += static_cast<int64_t>(schedule.tiers[t].weight) * schedule.quantum;
+                tier.credited = true;
+            }
+            Waiter &head = tier.queue.front();
+            if (head.cost > tier.deficit)
+            {
+                // Turn over: the credit left waits for the next round.
+                tier.credited = false;
+                popRing();
+                pushRing(t);
+                continue;
+            }
+            AcquireResult result;
+            if (!tokenBucketDecide(capacity, now, bucket, head.cost, &result))
+            {
+                due = now + std::max<int64_t>(result.retryAfterNanos, 1);
+                break;
+            }
+            tier.deficit -= head.cost;
+            tier.stats.admitted++;
+            tier.stats.queued++;
+            tier.stats.delay.record(static_cast<uint64_t>(now - head.enqueuedAt));
+            ready.emplace_back(std::move(head.onDone), true);
+            tier.queue.pop_front();
+            waiting--;
+        }
+
+        for (int t = 0; t < TIER_COUNT; t++)
+        {
+            if (tiers[t].queue.empty())
+                continue;
+            int64_t deadline = tiers[t].queue.front().enqueuedAt + schedule.tiers[t].maxWait.nanos;
+            due = due ? std::min(due, deadline) : deadline;
+        }
+        return due;
+    }
+
+    static void complete(Ready &ready)
+    {
+        for (auto &[onDone, admitted] : ready)
+            onDone(admitted);
+        ready.clear();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        Ready ready;
+        while (running)
+        {
+            int64_t now = clock->nowNanos();
+            int64_t due = serve(now, ready);
+            if (!ready.empty())
+            {
+                lock.unlock();
+                complete(ready);
+                lock.lock();
+                continue;
+            }
+            if (due == 0)
+                wake.wait(lock);
+            else
+                wake.wait_for(lock, std::chrono::nanoseconds(std::max<int64_t>(due - now, 1000)));
+        }
+    }
+
+public:
+    explicit AdmissionScheduler(const AdmissionSchedule &schedule = AdmissionSchedule::defaults(),
+                                Clock &clock = systemClock(), bool startThread = true)
+        : schedule(schedule),
+          bucket(schedule.capacity.maxRequests, schedule.capacity.timeWindow.nanos),
+          clock(&clock)
+    {
+        if (schedule.capacity.timeWindow.nanos <= 0 || schedule.capacity.maxRequests <= 0)
+            throw std::invalid_argument("Admission capacity needs a positive limit and window");
+        if (schedule.quantum == 0)
+            throw std::invalid_argument("Admission quantum must be positive");
+        for (const TierSchedule &tier : schedule.tiers)
+        {
+            if (tier.weight == 0 || tier.maxWait.nanos <= 0)
+                throw std::invalid_argument("Every tier needs a weight and a positive maxWait");
+        }
+        if (startThread)
+            dispatcher = std::thread([this] { run(); });
+    }
+
+    AdmissionScheduler(const AdmissionScheduler &) = delete;
+    AdmissionScheduler &operator=(const AdmissionScheduler &) = delete;
+
+    ~AdmissionScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        if (dispatcher.joinable())
+            dispatcher.join();
+        for (Tier &tier : tiers)
+        {
+            for (Waiter &waiter : tier.queue)
+                waiter.onDone(false);
+        }
+    }
+
+    // Admits cost units for a request of the given tier now, queues it
+    // (onDone then reports the outcome), or rejects it when its tier queue
+    // is full. Throws std::invalid_argument if cost exceeds the capacity.
+    Admission acquire(UserType type, uint32_t cost, Completion onDone)
+    {
+        int t = tierIndex(type);
+        if (cost > static_cast<uint32_t>(schedule.capacity.maxRequests))
+            throw std::invalid_argument("Cost exceeds the admission capacity");
+        std::lock_guard<std::mutex> lock(mutex);
+        Tier &tier = tiers[t];
+        int64_t now = clock->nowNanos();
+        if (waiting == 0 && tokenBucketDecide(capacity, now, bucket, cost))
+        {
+            tier.stats.admitted++;
+            tier.stats.delay.record(0);
+            return Admission::ADMITTED;
+        }
+        if (tier.queue.size() >= schedule.tiers[t].maxQueue)
+        {
+            tier.stats.rejected++;
+            return Admission::REJECTED;
+        }
+        tier.queue.push_back(Waiter{cost, now, std::move(onDone)});
+        waiting++;
+        if (!tier.active)
+        {
+            tier.active = true;
+            pushRing(t);
+        }
+        wake.notify_one();
+        return Admission::QUEUED;
+    }
+
+    // Future form: true once admitted, false if rejected or shed.
+    std::future<bool> acquire(UserType type, uint32_t cost = 1)
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        std::future<bool> future = promise->get_future();
+        try
+        {
+            Admission admission = acquire(type, cost, [promise](bool admitted) { promise->set_value(admitted); });
+            if (admission != Admission::QUEUED)
+                promise->set_value(admission == Admission::ADMITTED);
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+        return future;
+    }
+
+    // Runs one pass at the clock's current time on the calling thread,
+    // completions included. Returns when the next pass is due (clock
+    // nanoseconds), or 0 when nothing is queued.
+    int64_t dispatch()
+    {
+        Ready ready;
+        int64_t due;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            due = serve(clock->nowNanos(), ready);
+        }
+        complete(ready);
+        return due;
+    }
+
+    size_t waiters()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return waiting;
+    }
+
+    TierQueueStats stats(UserType type)
+    {
+        int t = tierIndex(type);
+        std::lock_guard<std::mutex> lock(mutex);
+        return tiers[t].stats;
+    }
+};
@@ -0,0 +1,237 @@
+#pragma once
+#include "RateLimiter.h"
+#include "TimingWheel.h"
+#include "Clock.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#endif
+
+// ---------------- Async Acquire ----------------
+// Waiting front end for any RateLimiter: acquire(key, cost) completes once
+// the limiter admits `cost` units for the key, instead of the caller
+// spinning on allowRequest or sleeping.
+//
+// Waiters for a key queue in FIFO order. A request for a key that already
+// has waiters joins the back of its queue, even if the limiter could admit
+// it now, so a small request never overtakes a large one. Each key with
+// waiters has one entry in a TimingWheel, due when the limiter's
+// retryAfterNanos says its head request fits; one timer thread fires the
+// wheel every tick, admits as many head requests as the limiter allows and
+// reschedules the key for the rest. Thousands of waiters cost a queue entry
+// each, not a thread.
+//
+// Completions run on the timer thread, outside the internal lock; they
+// should be short. A completion receives a null exception_ptr when the
+// request was admitted, or the error that ended it: a cost the limiter can
+// never admit, or the AsyncRateLimiter being destroyed with it still
+// queued. The wrapped limiter is only called under the lock, and should
+// read the same clock.
+class AsyncRateLimiter
+{
+public:
+    using Completion = std::function<void(std::exception_ptr)>;
+
+private:
+    struct Waiter
+    {
+        uint32_t cost;
+        Completion onReady;
+    };
+
+    std::unique_ptr<RateLimiter> limiter;
+    Clock *clock;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::unordered_map<std::string, std::deque<Waiter>> queues;
+    TimingWheel<std::string> wheel;
+    size_t waiting = 0;
+    bool running = true;
+    std::thread timer;
+
+    using Ready = std::vector<std::pair<Completion, std::exception_ptr>>;
+
+    // Wheel callback, under the lock: admits the key's head waiters while
+    // the limiter allows, moving their completions to `ready`. Returns the
+    // key's next deadline, or 0 once its queue is empty.
+    int64_t serve(const std::string &key, int64_t now, Ready &ready)
+    {
+        auto it = queues.find(key);
+        if (it == queues.end())
+            return 0;
+        std::deque<Waiter> &queue = it->second;
+        while (!queue.empty())
+        {
+            AcquireResult result = limiter->tryAcquire(key, queue.front().cost);
+            std::exception_ptr error;
+            if (result.retryAfterNanos == AcquireResult::NEVER)
+                error = std::make_exception_ptr(std::invalid_argument("Cost exceeds what the limit can ever admit"));
+            else if (!result.allowed)
+                return now + result.retryAfterNanos;
+            ready.emplace_back(std::move(queue.front().onReady), error);
+            queue.pop_front();
+            waiting--;
+        }
+        queues.erase(it);
+        return 0;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        Ready ready;
+        while (running)
+        {
+            if (wheel.size() == 0)
+                wake.wait(lock);
+            else
+                wake.wait_for(lock, std::chrono::nanoseconds(wheel.getTickNanos()));
+            int64_t now = clock->nowNanos();
+            wheel.advance(now, [&](const std::string &key, uint64_t)
+                          { return serve(key, now, ready); });
+            if (ready.empty())
+                continue;
+            lock.unlock();
+            for (auto &[onReady, error] : ready)
+                onReady(error);
+            ready.clear();
+            lock.lock();
+        }
+    }
+
+public:
+    // tickNanos is the timer resolution: a waiter completes at most about
+    // one tick after the limiter would first admit it.
+    explicit AsyncRateLimiter(std::unique_ptr<RateLimiter> limiter, Clock &clock = systemClock(),
+                              int64_t tickNanos = 1000000)
+        : limiter(std::move(limiter)), clock(&clock), wheel(tickNanos)
+    {
+        if (!this->limiter)
+            throw std::invalid_argument("AsyncRateLimiter needs a limiter");
+        if (tickNanos <= 0)
+            throw std::invalid_argument("Timer tick must be positive");
+        wheel.advance(clock.nowNanos(), [](const std::string &, uint64_t) { return int64_t(0); });
+        timer = std::thread([this] { run(); });
+    }
+
+    AsyncRateLimiter(const AsyncRateLimiter &) = delete;
+    AsyncRateLimiter &operator=(const AsyncRateLimiter &) = delete;
+
+    ~AsyncRateLimiter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        timer.join();
+        std::exception_ptr stopped = std::make_exception_ptr(std::runtime_error("AsyncRateLimiter destroyed"));
+        for (auto &[key, queue] : queues)
+        {
+            for (Waiter &waiter : queue)
+                waiter.onReady(stopped);
+        }
+    }
+
+    // Admits cost units for key now and returns true, or queues onReady to
+    // run on the timer thread once they are admitted and returns false.
+    // Throws std::invalid_argument if the limiter can never admit the cost
+    // and the key has no queue (behind a queue, onReady gets that error).
+    bool acquire(const std::string &key, uint32_t cost, Completion onReady)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = queues.find(key);
+        if (it == queues.end())
+        {
+            AcquireResult result = limiter->tryAcquire(key, cost);
+            if (result.allowed)
+                return true;
+            if (result.retryAfterNanos == AcquireResult::NEVER)
+                throw std::invalid_argument("Cost exceeds what the limit can ever admit");
+            it = queues.emplace(key, std::deque<Waiter>()).first;
+            wheel.schedule(key, clock->nowNanos() + result.retryAfterNanos);
+        }
+        it->second.push_back(Waiter{cost, std::move(onReady)});
+        waiting++;
+        // The timer thread may be idling with an empty wheel.
+        wake.notify_one();
+        return false;
+    }
+
+    // Future form: ready at once or when the timer thread admits the request.
+    std::future<void> acquire(const std::string &key, uint32_t cost = 1)
+    {
+        auto promise = std::make_shared<std::promise<void>>();
+        std::future<void> future = promise->get_future();
+        try
+        {
+            auto complete = [promise](std::exception_ptr error)
+            {
+                if (error)
+                    promise->set_exception(error);
+                else
+                    promise->set_value();
+            };
+            if (acquire(key, cost, complete))
+                promise->set_value();
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+        return future;
+    }
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+    // co_await limiter.wait(key, cost): does not suspend if admitted at
+    // once, otherwise resumes on the timer thread; rethrows a completion
+    // error.
+    struct Awaiter
+    {
+        AsyncRateLimiter &owner;
+        std::string key;
+        uint32_t cost;
+        std::exception_ptr error;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            return !owner.acquire(key, cost, [this, handle](std::exception_ptr e)
+            {
+                error = e;
+                handle.resume();
+            });
+        }
+        void await_resume() const
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    Awaiter wait(std::string key, uint32_t cost = 1)
+    {
+        return Awaiter{*this, std::move(key), cost, nullptr};
+    }
+#endif
+
+    size_t waiters()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return waiting;
+    }
+};
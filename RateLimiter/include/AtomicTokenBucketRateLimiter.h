@@ -0,0 +1,362 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include "FlatStateTable.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+//-------------------atomic token-bucket-----------------------------
+// Same policy as TokenBucketRateLimiter (maxTokens per window,
+// starting full) but every bucket is a single 64-bit word:
+//
+//   bits 63..40  tokens, 16.8 fixed point (so at most 65535 whole tokens)
+//   bits 39..0   last refill time in 1024 ns ticks of the monotonic clock
+//
+// A decision is one load plus one CAS on that word. Refill is continuous:
+// fractional tokens are kept, and the stamp only advances by the time that
+// actually produced whole fixed-point units, so nothing is truncated away.
+// Ticks wrap modulo 2^40 (~12.7 days); elapsed time is computed modulo the
+// wrap. A stamp that appears to lie slightly in the future (another thread
+// read the clock a moment later and won the CAS) counts as zero elapsed
+// time; any larger gap can only be a long idle, which refills completely.
+struct TokenBucketParams
+{
+    uint64_t capacity = 0;      // fixed-point tokens
+    uint64_t windowTicks = 0;   // ticks for an empty bucket to refill completely
+    uint64_t refillPerTick = 0; // fixed-point tokens per tick, scaled by 2^32
+
+    constexpr TokenBucketParams() = default;
+    constexpr TokenBucketParams(int maxTokens, int64_t windowNanos);
+};
+
+class alignas(64) AtomicTokenBucket
+{
+public:
+    static constexpr int TICK_SHIFT = 10;
+    static constexpr int STAMP_BITS = 40;
+    static constexpr uint64_t STAMP_MASK = (1ull << STAMP_BITS) - 1;
+    static constexpr uint64_t STAMP_SIGN = 1ull << (STAMP_BITS - 1);
+    // How far (~1 s) a stamp may lead the caller's clock reading and still
+    // be taken for a concurrent refill rather than an idle that wrapped.
+    static constexpr uint64_t FUTURE_SLACK = 1ull << 20;
+    static constexpr int FRACTION_BITS = 8;
+    static constexpr uint64_t ONE = 1ull << FRACTION_BITS;
+    static constexpr int MAX_TOKENS = (1 << (64 - STAMP_BITS - FRACTION_BITS)) - 1;
+    // A word no bucket can hold (its token field is above MAX_TOKENS), for
+    // tables that need to tell a slot never initialized from a real state:
+    // every packed value, 0 included, is a valid bucket.
+    static constexpr uint64_t EMPTY = ~0ull;
+
+    static uint64_t toTick(int64_t nanos)
+    {
+        return (static_cast<uint64_t>(nanos) >> TICK_SHIFT) & STAMP_MASK;
+    }
+    static uint64_t pack(uint64_t tokens, uint64_t stamp) { return tokens << STAMP_BITS | stamp; }
+    static uint64_t tokensOf(uint64_t word) { return word >> STAMP_BITS; }
+    static uint64_t stampOf(uint64_t word) { return word & STAMP_MASK; }
+
+    // Word a freshly created (full) bucket starts from.
+    static uint64_t initial(const TokenBucketParams &params, uint64_t nowTick)
+    {
+        return pack(params.capacity, nowTick);
+    }
+
+    // Pure refill step: the word as it would look at nowTick.
+    static uint64_t refill(uint64_t word, uint64_t nowTick, const TokenBucketParams &params)
+    {
+        uint64_t tokens = tokensOf(word);
+        uint64_t stamp = stampOf(word);
+        uint64_t elapsed = (nowTick - stamp) & STAMP_MASK;
+
+        if (elapsed > STAMP_MASK - FUTURE_SLACK)
+            return word;
+        if (tokens >= params.capacity || elapsed >= params.windowTicks)
+            return pack(params.capacity, nowTick);
+
+        uint64_t added = static_cast<uint64_t>(
+            (static_cast<unsigned __int128>(elapsed) * params.refillPerTick) >> 32);
+        if (added == 0)
+            return word;
+        if (tokens + added >= params.capacity)
+            return pack(params.capacity, nowTick);
+
+        uint64_t used = ((added << 32) + params.refillPerTick - 1) / params.refillPerTick;
+        return pack(tokens + added, (stamp + used) & STAMP_MASK);
+    }
+
+    // Lock-free refill-and-consume on an arbitrary word, so flat or shared
+    // tables can keep buckets inline instead of as AtomicTokenBucket objects.
+    static bool tryConsume(std::atomic<uint64_t> &state, uint64_t nowTick,
+                           const TokenBucketParams &params, uint64_t cost = ONE)
+    {
+        uint64_t current = state.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint64_t next = refill(current, nowTick, params);
+            if (tokensOf(next) < cost)
+                return false;
+            next -= cost << STAMP_BITS;
+            if (state.compare_exchange_weak(current, next,
+                                            std::memory_order_relaxed,
+                                            std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    // Same step for a word that is already protected by its owner's lock.
+    static bool tryConsume(uint64_t &word, uint64_t nowTick,
+                           const TokenBucketParams &params, uint64_t cost = ONE)
+    {
+        uint64_t next = refill(word, nowTick, params);
+        if (tokensOf(next) < cost)
+            return false;
+        word = next - (cost << STAMP_BITS);
+        return true;
+    }
+
+    // Puts back tokens taken by a charge that was later abandoned, up to
+    // capacity; refill that happened in between can make the refund short.
+    static void refund(std::atomic<uint64_t> &state, const TokenBucketParams &params, uint64_t cost)
+    {
+        uint64_t current = state.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint64_t tokens = std::min(params.capacity, tokensOf(current) + cost);
+            if (state.compare_exchange_weak(current, pack(tokens, stampOf(current)),
+                                            std::memory_order_relaxed,
+                                            std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    static AcquireResult admitted(uint64_t charged)
+    {
+        return AcquireResult{true, static_cast<int64_t>(tokensOf(charged) >> FRACTION_BITS), 0};
+    }
+
+    // Result for a charge that `word` (as stored) could not cover at nowNanos.
+    // The bucket was not full, so refill from the stored stamp is linear up
+    // to a full window: the wait is the ticks that produce the deficit, less
+    // the ticks and the part of the current tick already gone.
+    static AcquireResult rejected(uint64_t word, int64_t nowNanos, const TokenBucketParams &params,
+                                  uint64_t cost)
+    {
+        uint64_t nowTick = toTick(nowNanos);
+        AcquireResult result{false, static_cast<int64_t>(tokensOf(refill(word, nowTick, params)) >> FRACTION_BITS), 0};
+        if (cost > params.capacity || params.refillPerTick == 0)
+        {
+            result.retryAfterNanos = AcquireResult::NEVER;
+            return result;
+        }
+        uint64_t deficit = cost - tokensOf(word);
+        uint64_t ticks = static_cast<uint64_t>(
+            ((static_cast<unsigned __int128>(deficit) << 32) + params.refillPerTick - 1) / params.refillPerTick);
+        ticks = std::min(ticks, params.windowTicks);
+        uint64_t wait = (stampOf(word) + ticks - nowTick) & STAMP_MASK;
+        if (wait & STAMP_SIGN)
+            wait = 0;
+        int64_t intoTick = nowNanos & ((1 << TICK_SHIFT) - 1);
+        result.retryAfterNanos = std::max<int64_t>(1, static_cast<int64_t>(wait << TICK_SHIFT) - intoTick);
+        return result;
+    }
+
+    // tryConsume with the remaining tokens and retry-after filled in.
+    static AcquireResult tryAcquire(std::atomic<uint64_t> &state, int64_t nowNanos,
+                                    const TokenBucketParams &params, uint64_t cost = ONE)
+    {
+        uint64_t nowTick = toTick(nowNanos);
+        uint64_t current = state.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint64_t next = refill(current, nowTick, params);
+            if (tokensOf(next) < cost)
+                return rejected(current, nowNanos, params, cost);
+            next -= cost << STAMP_BITS;
+            if (state.compare_exchange_weak(current, next,
+                                            std::memory_order_relaxed,
+                                            std::memory_order_relaxed))
+                return admitted(next);
+        }
+    }
+
+    static AcquireResult tryAcquire(uint64_t &word, int64_t nowNanos,
+                                    const TokenBucketParams &params, uint64_t cost = ONE)
+    {
+        uint64_t next = refill(word, toTick(nowNanos), params);
+        if (tokensOf(next) < cost)
+            return rejected(word, nowNanos, params, cost);
+        word = next - (cost << STAMP_BITS);
+        return admitted(word);
+    }
+
+    AtomicTokenBucket(const TokenBucketParams &params, int64_t nowNanos)
+        : state(initial(params, toTick(nowNanos))) {}
+
+    bool tryConsume(int64_t nowNanos, const TokenBucketParams &params, uint64_t cost = ONE)
+    {
+        return tryConsume(state, toTick(nowNanos), params, cost);
+    }
+
+    AcquireResult tryAcquire(int64_t nowNanos, const TokenBucketParams &params, uint64_t cost = ONE)
+    {
+        return tryAcquire(state, nowNanos, params, cost);
+    }
+
+    uint64_t load() const { return state.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> state;
+};
+
+constexpr TokenBucketParams::TokenBucketParams(int maxTokens, int64_t windowNanos)
+{
+    if (maxTokens < 0 || maxTokens > AtomicTokenBucket::MAX_TOKENS)
+        throw std::invalid_argument("Token bucket capacity out of range");
+    windowTicks = static_cast<uint64_t>(windowNanos) >> AtomicTokenBucket::TICK_SHIFT;
+    if (windowNanos <= 0 || windowTicks == 0 || windowTicks >= AtomicTokenBucket::STAMP_SIGN)
+        throw std::invalid_argument("Token bucket window out of range");
+    capacity = static_cast<uint64_t>(maxTokens) << AtomicTokenBucket::FRACTION_BITS;
+    refillPerTick = (capacity << 32) / windowTicks;
+}
+
+// Thread-safe on its own. Keys live in open-addressing tables of {hash,
+// word} slots, like SharedMemoryRateLimiterService's: a new key claims a slot
+// with one CAS on its hash, and decisions are the CAS loop above on the
+// slot's word, so a key already seen is found and charged without a lock.
+// Keys are identified by their 64-bit hash alone. Only the first request
+// for a key takes one of a few striped locks, so that two threads adding
+// the same key while a table is appended cannot claim it twice.
+//
+// When the newest table is three-quarters full a table twice its size is
+// appended; nothing is ever moved, so no decision can land on a bucket that
+// is being copied. Lookups search the tables oldest first.
+class AtomicTokenBucketRateLimiter : public RateLimiter {
+private:
+    static constexpr int MAX_TABLES = 40;
+    static constexpr uint64_t FIRST_CAPACITY = 16;
+    static constexpr int INSERT_STRIPE_BITS = 4;
+
+    struct Slot {
+        std::atomic<uint64_t> hash{0};
+        std::atomic<uint64_t> word{AtomicTokenBucket::EMPTY};
+    };
+
+    struct Table {
+        uint64_t mask;
+        std::atomic<uint64_t> count{0};
+        std::unique_ptr<Slot[]> slots;
+
+        explicit Table(uint64_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+    };
+
+    TokenBucketParams params;
+    std::atomic<Table *> tables[MAX_TABLES] = {};
+    std::atomic<int> newest{0};
+    std::mutex inserting[1 << INSERT_STRIPE_BITS];
+    Clock *clock;
+
+    // The key's slot, or the empty slot that ends its probe run; nullptr
+    // when the table is full without it.
+    static Slot *probe(Table &table, uint64_t hash) {
+        uint64_t i = hash & table.mask;
+        for (uint64_t probes = 0; probes <= table.mask; probes++, i = (i + 1) & table.mask) {
+            uint64_t seen = table.slots[i].hash.load(std::memory_order_acquire);
+            if (seen == hash || seen == 0)
+                return &table.slots[i];
+        }
+        return nullptr;
+    }
+
+    // Appends a table after `last` unless another thread already has.
+    void grow(int last) {
+        if (last + 1 >= MAX_TABLES)
+            throw std::length_error("Atomic token bucket table full");
+        Table *expected = nullptr;
+        if (!tables[last + 1].load(std::memory_order_acquire)) {
+            auto next = std::make_unique<Table>((tables[last].load(std::memory_order_relaxed)->mask + 1) * 2);
+            if (tables[last + 1].compare_exchange_strong(expected, next.get(), std::memory_order_acq_rel))
+                next.release();
+        }
+        newest.compare_exchange_strong(last, last + 1, std::memory_order_acq_rel);
+    }
+
+    std::atomic<uint64_t> *find(uint64_t hash) {
+        int last = newest.load(std::memory_order_acquire);
+        for (int t = 0; t <= last; t++) {
+            Slot *slot = probe(*tables[t].load(std::memory_order_acquire), hash);
+            if (slot && slot->hash.load(std::memory_order_acquire) == hash)
+                return &slot->word;
+        }
+        return nullptr;
+    }
+
+    std::atomic<uint64_t> &wordFor(const std::string &userId) {
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        if (std::atomic<uint64_t> *word = find(hash))
+            return *word;
+        std::lock_guard<std::mutex> lock(inserting[hash >> (64 - INSERT_STRIPE_BITS)]);
+        for (;;) {
+            if (std::atomic<uint64_t> *word = find(hash))
+                return *word;
+            int last = newest.load(std::memory_order_acquire);
+            Table &table = *tables[last].load(std::memory_order_acquire);
+            Slot *slot = probe(table, hash);
+            if (!slot || table.count.load(std::memory_order_relaxed) * 4 >= (table.mask + 1) * 3) {
+                grow(last);
+                continue;
+            }
+            uint64_t empty = 0;
+            if (slot->hash.compare_exchange_strong(empty, hash, std::memory_order_acq_rel)) {
+                table.count.fetch_add(1, std::memory_order_relaxed);
+                return slot->word;
+            }
+            // Another key took the slot; look again.
+        }
+    }
+
+    AcquireResult acquire(const std::string &userId, uint64_t cost) {
+        std::atomic<uint64_t> &word = wordFor(userId);
+        int64_t now = clock->nowNanos();
+        uint64_t nowTick = AtomicTokenBucket::toTick(now);
+        uint64_t current = word.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t base = current == AtomicTokenBucket::EMPTY ? AtomicTokenBucket::initial(params, nowTick)
+                                                                 : current;
+            uint64_t next = AtomicTokenBucket::refill(base, nowTick, params);
+            if (AtomicTokenBucket::tokensOf(next) < cost)
+                return AtomicTokenBucket::rejected(base, now, params, cost);
+            next -= cost << AtomicTokenBucket::STAMP_BITS;
+            if (word.compare_exchange_weak(current, next, std::memory_order_relaxed,
+                                           std::memory_order_relaxed))
+                return AtomicTokenBucket::admitted(next);
+        }
+    }
+
+public:
+    AtomicTokenBucketRateLimiter(int maxReq, TimeWindow window, Clock &clock = systemClock())
+        : params(maxReq, window.nanos), clock(&clock) {
+        tables[0].store(new Table(FIRST_CAPACITY), std::memory_order_relaxed);
+    }
+
+    AtomicTokenBucketRateLimiter(const AtomicTokenBucketRateLimiter &) = delete;
+    AtomicTokenBucketRateLimiter &operator=(const AtomicTokenBucketRateLimiter &) = delete;
+
+    ~AtomicTokenBucketRateLimiter() override {
+        for (auto &table : tables)
+            delete table.load(std::memory_order_relaxed);
+    }
+
+    const TokenBucketParams &getParams() const { return params; }
+
+    bool allowRequest(const std::string &userId) override {
+        return acquire(userId, AtomicTokenBucket::ONE).allowed;
+    }
+
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override {
+        return acquire(userId, static_cast<uint64_t>(cost) << AtomicTokenBucket::FRACTION_BITS);
+    }
+};
@@ -0,0 +1,181 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+// ---------------- Clock ----------------
+// Monotonic nanoseconds (CLOCK_MONOTONIC on Linux). Unlike time(nullptr) it
+// never jumps with wall-clock adjustments and resolves well below a second.
+inline int64_t monotonicNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Time source injected into limiters and services. Every constructor that
+// takes one defaults to systemClock(); the clock must outlive its users.
+//
+//   SystemClock     monotonicNanos() on every call
+//   TscClock        the CPU's time-stamp counter scaled to nanoseconds;
+//                   full resolution without the clock_gettime call
+//   CoarseClock     a value refreshed by a background thread; one relaxed
+//                   load per call at the cost of `resolution` staleness
+//   SimulatedClock  moved only by set/advance, for tests and trace replay
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+    virtual int64_t nowNanos() = 0;
+
+    int64_t nowSeconds() { return nowNanos() / 1000000000; }
+};
+
+class SystemClock : public Clock
+{
+public:
+    int64_t nowNanos() override { return monotonicNanos(); }
+};
+
+inline Clock &systemClock()
+{
+    static SystemClock clock;
+    return clock;
+}
+
+// Reads the invariant TSC (one rdtsc and a multiply) and scales it with a
+// ratio measured against monotonicNanos() over `calibration` at
+// construction, which blocks for that long. It then drifts from
+// CLOCK_MONOTONIC by tens of parts per million (calibration error plus any
+// NTP slew of the monotonic clock), far below any window. It assumes the
+// counter is synchronized across cores, as it is on CPUs that report an
+// invariant TSC; elsewhere (no invariant TSC, or not x86) it falls back to
+// monotonicNanos().
+class TscClock : public Clock
+{
+private:
+    bool invariant = false;
+    uint64_t baseTicks = 0;
+    int64_t baseNanos = 0;
+    double nanosPerTick = 0;
+
+    static bool hasInvariantTsc()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned eax, ebx, ecx, edx;
+        return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+#else
+        return false;
+#endif
+    }
+
+    static uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // A (nanos, ticks) pair read as close together as a few tries allow,
+    // so a preemption between the two reads does not skew the ratio.
+    static void pairedReading(int64_t &nanos, uint64_t &tsc)
+    {
+        int64_t narrowest = INT64_MAX;
+        nanos = 0;
+        tsc = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            int64_t before = monotonicNanos();
+            uint64_t t = ticks();
+            int64_t after = monotonicNanos();
+            if (after - before < narrowest)
+            {
+                narrowest = after - before;
+                nanos = before + (after - before) / 2;
+                tsc = t;
+            }
+        }
+    }
+
+public:
+    explicit TscClock(std::chrono::nanoseconds calibration = std::chrono::milliseconds(10))
+        : invariant(hasInvariantTsc())
+    {
+        if (!invariant)
+            return;
+        int64_t startNanos = 0;
+        uint64_t startTicks = 0;
+        pairedReading(startNanos, startTicks);
+        std::this_thread::sleep_for(calibration);
+        pairedReading(baseNanos, baseTicks);
+        nanosPerTick = static_cast<double>(baseNanos - startNanos) / static_cast<double>(baseTicks - startTicks);
+    }
+
+    bool usesTsc() const { return invariant; }
+
+    int64_t nowNanos() override
+    {
+        if (!invariant)
+            return monotonicNanos();
+        return baseNanos + static_cast<int64_t>(static_cast<int64_t>(ticks() - baseTicks) * nanosPerTick);
+    }
+};
+
+inline Clock &tscClock()
+{
+    static TscClock clock;
+    return clock;
+}
+
+class CoarseClock : public Clock
+{
+private:
+    std::atomic<int64_t> current;
+    std::atomic<bool> running{true};
+    std::thread ticker;
+
+public:
+    explicit CoarseClock(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1))
+        : current(monotonicNanos())
+    {
+        ticker = std::thread([this, resolution]
+        {
+            while (running.load(std::memory_order_relaxed))
+            {
+                std::this_thread::sleep_for(resolution);
+                current.store(monotonicNanos(), std::memory_order_relaxed);
+            }
+        });
+    }
+
+    CoarseClock(const CoarseClock &) = delete;
+    CoarseClock &operator=(const CoarseClock &) = delete;
+
+    ~CoarseClock()
+    {
+        running.store(false, std::memory_order_relaxed);
+        ticker.join();
+    }
+
+    int64_t nowNanos() override { return current.load(std::memory_order_relaxed); }
+};
+
+class SimulatedClock : public Clock
+{
+private:
+    std::atomic<int64_t> current;
+
+public:
+    explicit SimulatedClock(int64_t startNanos = 0) : current(startNanos) {}
+
+    int64_t nowNanos() override { return current.load(std::memory_order_relaxed); }
+    void set(int64_t nanos) { current.store(nanos, std::memory_order_relaxed); }
+    void advance(int64_t nanos) { current.fetch_add(nanos, std::memory_order_relaxed); }
+};
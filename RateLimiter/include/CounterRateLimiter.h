@@ -0,0 +1,55 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+// ---------------- Counter Limiter ----------------
+class CounterRateLimiter : public RateLimiter
+{
+private:
+    std::unordered_map<std::string, int> counter;
+    std::unordered_map<std::string, int64_t> windowStart;
+    int maxRequests;
+    int64_t windowNanos;
+    Clock *clock;
+
+public:
+    CounterRateLimiter(int maxReq, TimeWindow window, Clock &clock = systemClock())
+        : maxRequests(maxReq), windowNanos(window.nanos), clock(&clock) {}
+
+    bool allowRequest(const std::string &userId) override
+    {
+        return tryAcquire(userId, 1).allowed;
+    }
+
+    // A rejected request can retry the moment its window closes.
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override
+    {
+        int64_t now = clock->nowNanos();
+
+        if (windowStart.find(userId) == windowStart.end() ||
+            now - windowStart[userId] >= windowNanos)
+        {
+            windowStart[userId] = now;
+            counter[userId] = 0;
+        }
+
+        AcquireResult result;
+        int64_t used = counter[userId];
+        int64_t limit = std::max(maxRequests, 0);
+        if (used + cost <= limit)
+        {
+            counter[userId] += cost;
+            result.allowed = true;
+            result.remaining = limit - used - cost;
+            return result;
+        }
+        result.remaining = std::max<int64_t>(limit - used, 0);
+        result.retryAfterNanos = cost > limit
+                                     ? AcquireResult::NEVER
+                                     : windowStart[userId] + windowNanos - now;
+        return result;
+    }
+};
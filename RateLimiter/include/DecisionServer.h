@@ -0,0 +1,502 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "RateLimiterService.h"
+#include "QuotaLease.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ---------------- Decision Protocol ----------------
+// Binary request/response protocol for a RateLimiterService served over
+// TCP (host byte order; client and server share a host). A client may send
+// any number of requests without waiting; replies come back in request
+// order, so no request ids are needed.
+//
+//   DECIDE   DecisionRequest + key        ->  1 byte: 1 admitted, 0 rejected
+//                                              (handleRequest(key, type))
+//   ACQUIRE  DecisionRequest + key        ->  AcquireReply
+//                                              (tryAcquire(key, type, cost))
+//   BATCH    DecisionRequest, cost = n,   ->  n bytes, one DECIDE reply each
+//            then n x (BatchItem + key)
+//
+// A malformed frame (unknown op or tier, a batch over MAX_BATCH items, or a
+// frame that cannot complete within the server's input limit) closes the
+// connection.
+struct DecisionRequest
+{
+    static constexpr uint8_t DECIDE = 1;
+    static constexpr uint8_t ACQUIRE = 2;
+    static constexpr uint8_t BATCH = 3;
+    static constexpr uint32_t MAX_BATCH = 4096;
+
+    uint8_t op;
+    uint8_t type;       // UserType; unused for BATCH
+    uint16_t keyLength; // 0 for BATCH
+    uint32_t cost;      // units for ACQUIRE, item count for BATCH, ignored for DECIDE
+};
+
+struct BatchItem
+{
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t keyLength;
+};
+
+struct AcquireReply
+{
+    uint8_t allowed;
+    uint8_t reserved[3];
+    uint32_t remaining;  // saturated at UINT32_MAX
+    int64_t retryAfterNanos;
+};
+
+static_assert(sizeof(DecisionRequest) == 8 && sizeof(BatchItem) == 4 && sizeof(AcquireReply) == 16,
+              "Decision messages must be packed");
+
+// ---------------- Decision Server ----------------
+// One epoll event loop per thread, each with its own listening socket bound
+// to the same port with SO_REUSEPORT, so the kernel spreads connections
+// across the loops and a connection stays on one loop (and core) for life.
+// Sockets are non-blocking. Each readable event is one read; every complete
+// frame in the buffer is decided and its reply appended to the
+// connection's output, which is flushed with one write per read. Output the
+// socket will not take is kept and written on EPOLLOUT, and reading from
+// that connection pauses until it drains, so a client that does not read
+// replies holds at most one read's worth of replies on the server.
+class DecisionServer
+{
+public:
+    struct Stats
+    {
+        uint64_t connections = 0;
+        uint64_t decisions = 0;
+        uint64_t dropped = 0;    // connections closed for a malformed frame
+    };
+
+private:
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+    // Largest partial frame buffered; a batch of long keys can approach it.
+    static constexpr size_t MAX_PENDING_INPUT = 1 << 20;
+
+    struct Connection
+    {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t outputOffset = 0;
+        bool writing = false;    // registered for EPOLLOUT, input paused
+    };
+
+    struct alignas(64) Loop
+    {
+        int epoll = -1;
+        int listener = -1;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+        uint64_t connectionsAccepted = 0;
+        uint64_t decisions = 0;
+        uint64_t dropped = 0;
+    };
+
+    RateLimiterService &service;
+    std::vector<Loop> loops;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};
+    uint16_t boundPort = 0;
+
+    static void setNonBlocking(int fd)
+    {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    static int listenOn(const std::string &host, uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            throw std::runtime_error("Cannot create decision socket");
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+            ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 1024) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot listen on " + host + ":" + std::to_string(port));
+        }
+        setNonBlocking(fd);
+        return fd;
+    }
+
+    // Decides every complete frame in c.input; false means a malformed
+    // frame.
+    bool serve(Loop &loop, Connection &c)
+    {
+        const char *data = c.input.data();
+        size_t size = c.input.size(), offset = 0;
+        std::string key;
+        while (size - offset >= sizeof(DecisionRequest))
+        {
+            DecisionRequest request;
+            std::memcpy(&request, data + offset, sizeof(request));
+            if (request.op == DecisionRequest::BATCH)
+            {
+                if (request.cost > DecisionRequest::MAX_BATCH)
+                    return false;
+                // Only start on a batch once all of it is here.
+                size_t end = offset + sizeof(request);
+                bool complete = true;
+                for (uint32_t i = 0; i < request.cost; i++)
+                {
+                    BatchItem item;
+                    if (size - end < sizeof(item))
+                    {
+                        complete = false;
+                        break;
+                    }
+                    std::memcpy(&item, data + end, sizeof(item));
+                    if (item.type >= TIER_COUNT)
+                        return false;
+                    end += sizeof(item) + item.keyLength;
+                    if (end > size)
+                    {
+                        complete = false;
+                        break;
+                    }
+                }
+                if (!complete)
+                    break;
+                size_t at = offset + sizeof(request);
+                for (uint32_t i = 0; i < request.cost; i++)
+                {
+                    BatchItem item;
+                    std::memcpy(&item, data + at, sizeof(item));
+                    key.assign(data + at + sizeof(item), item.keyLength);
+                    at += sizeof(item) + item.keyLength;
+                    c.output.push_back(service.handleRequest(key, static_cast<UserType>(item.type)) ? 1 : 0);
+                }
+                loop.decisions += request.cost;
+                offset = end;
+                continue;
+            }
+
+            if (request.type >= TIER_COUNT)
+                return false;
+            if (size - offset < sizeof(request) + request.keyLength)
+                break;
+            key.assign(data + offset + sizeof(request), request.keyLength);
+            offset += sizeof(request) + request.keyLength;
+            UserType type = static_cast<UserType>(request.type);
+            if (request.op == DecisionRequest::DECIDE)
+                c.output.push_back(service.handleRequest(key, type) ? 1 : 0);
+            else if (request.op == DecisionRequest::ACQUIRE)
+            {
+                AcquireResult result = service.tryAcquire(key, type, request.cost);
+                AcquireReply reply{};
+                reply.allowed = result.allowed;
+                reply.remaining = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(result.remaining, 0),
+                                                                         UINT32_MAX));
+                reply.retryAfterNanos = result.retryAfterNanos;
+                c.output.append(reinterpret_cast<const char *>(&reply), sizeof(reply));
+            }
+            else
+                return false;
+            loop.decisions++;
+        }
+        c.input.erase(0, offset);
+        return true;
+    }
+
+    // Writes what the socket takes; false when the connection is gone.
+    bool flush(Loop &loop, Connection &c)
+    {
+        while (c.outputOffset < c.output.size())
+        {
+            ssize_t n = ::send(c.fd, c.output.data() + c.outputOffset, c.output.size() - c.outputOffset,
+                               MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if (n <= 0)
+                return false;
+            c.outputOffset += static_cast<size_t>(n);
+        }
+        bool drained = c.outputOffset == c.output.size();
+        if (drained)
+        {
+            c.output.clear();
+            c.outputOffset = 0;
+        }
+        // Stop reading while replies are backed up; resume once drained.
+        bool wantWrite = !drained;
+        if (wantWrite != c.writing)
+        {
+            epoll_event event{};
+            event.events = wantWrite ? EPOLLOUT : EPOLLIN;
+            event.data.fd = c.fd;
+            ::epoll_ctl(loop.epoll, EPOLL_CTL_MOD, c.fd, &event);
+            c.writing = wantWrite;
+        }
+        return true;
+    }
+
+    void close(Loop &loop, int fd)
+    {
+        ::epoll_ctl(loop.epoll, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        loop.connections.erase(fd);
+    }
+
+    void accept(Loop &loop)
+    {
+        for (;;)
+        {
+            int fd = ::accept(loop.listener, nullptr, nullptr);
+            if (fd < 0)
+                return;
+            setNonBlocking(fd);
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            ::epoll_ctl(loop.epoll, EPOLL_CTL_ADD, fd, &event);
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            loop.connections.emplace(fd, std::move(connection));
+            loop.connectionsAccepted++;
+        }
+    }
+
+    void runLoop(Loop &loop)
+    {
+        epoll_event events[256];
+        char buffer[READ_CHUNK];
+        while (running.load(std::memory_order_relaxed))
+        {
+            int ready = ::epoll_wait(loop.epoll, events, 256, 50);
+            for (int i = 0; i < ready; i++)
+            {
+                int fd = events[i].data.fd;
+                if (fd == loop.listener)
+                {
+                    accept(loop);
+                    continue;
+                }
+                auto it = loop.connections.find(fd);
+                if (it == loop.connections.end())
+                    continue;
+                Connection &c = *it->second;
+                if (c.writing)
+                {
+                    if (!flush(loop, c))
+                        close(loop, fd);
+                    continue;
+                }
+                ssize_t n = ::read(fd, buffer, sizeof(buffer));
+                if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+                    continue;
+                if (n <= 0)
+                {
+                    close(loop, fd);
+                    continue;
+                }
+                c.input.append(buffer, static_cast<size_t>(n));
+                if (!serve(loop, c) || c.input.size() > MAX_PENDING_INPUT)
+                {
+                    loop.dropped++;
+                    close(loop, fd);
+                    continue;
+                }
+                if (!flush(loop, c))
+                    close(loop, fd);
+            }
+        }
+    }
+
+public:
+    // Binds `loops` listeners to host:port (port 0 picks a free one; see
+    // port()). The service must outlive the server.
+    DecisionServer(RateLimiterService &service, const std::string &host, uint16_t port,
+                   size_t loops = std::max(1u, std::thread::hardware_concurrency()))
+        : service(service), loops(std::max<size_t>(loops, 1))
+    {
+        for (Loop &loop : this->loops)
+        {
+            loop.listener = listenOn(host, port);
+            if (port == 0)
+            {
+                // Later loops join the port the kernel picked.
+                sockaddr_in addr{};
+                socklen_t length = sizeof(addr);
+                ::getsockname(loop.listener, reinterpret_cast<sockaddr *>(&addr), &length);
+                port = ntohs(addr.sin_port);
+            }
+            loop.epoll = ::epoll_create1(0);
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = loop.listener;
+            ::epoll_ctl(loop.epoll, EPOLL_CTL_ADD, loop.listener, &event);
+        }
+        boundPort = port;
+    }
+
+    DecisionServer(const DecisionServer &) = delete;
+    DecisionServer &operator=(const DecisionServer &) = delete;
+
+    ~DecisionServer()
+    {
+        stop();
+        for (Loop &loop : loops)
+        {
+            for (auto &entry : loop.connections)
+                ::close(entry.first);
+            ::close(loop.listener);
+            ::close(loop.epoll);
+        }
+    }
+
+    uint16_t port() const { return boundPort; }
+
+    // Starts one thread per loop and returns.
+    void start()
+    {
+        running.store(true);
+        for (Loop &loop : loops)
+            threads.emplace_back([this, &loop] { runLoop(loop); });
+    }
+
+    // Stops the loops (within 50 ms) and joins them.
+    void stop()
+    {
+        running.store(false);
+        for (std::thread &thread : threads)
+            thread.join();
+        threads.clear();
+    }
+
+    // Totals over all loops; call after stop().
+    Stats getStats() const
+    {
+        Stats stats;
+        for (const Loop &loop : loops)
+        {
+            stats.connections += loop.connectionsAccepted;
+            stats.decisions += loop.decisions;
+            stats.dropped += loop.dropped;
+        }
+        return stats;
+    }
+};
+
+// ---------------- Decision Client ----------------
+// Blocking client for DecisionServer, one connection per instance (not
+// thread-safe). Each call writes its request and waits for the reply;
+// decideBatch sends many decisions in one frame. tools/decision_loadgen.cpp
+// pipelines raw frames instead.
+class DecisionClient
+{
+private:
+    int fd = -1;
+    std::string frame;
+
+    bool exchange(void *reply, size_t length)
+    {
+        return lease_io::writeAll(fd, frame.data(), frame.size()) && lease_io::readAll(fd, reply, length);
+    }
+
+    void appendRequest(uint8_t op, const std::string &key, UserType type, uint32_t cost)
+    {
+        if (key.size() > UINT16_MAX)
+            throw std::invalid_argument("Key too long");
+        DecisionRequest request{op, static_cast<uint8_t>(type), static_cast<uint16_t>(key.size()), cost};
+        frame.append(reinterpret_cast<const char *>(&request), sizeof(request));
+        frame += key;
+    }
+
+public:
+    DecisionClient(const std::string &host, uint16_t port)
+    {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (fd < 0 || ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+            ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            throw std::runtime_error("Cannot connect to " + host + ":" + std::to_string(port));
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    DecisionClient(const DecisionClient &) = delete;
+    DecisionClient &operator=(const DecisionClient &) = delete;
+
+    ~DecisionClient()
+    {
+        ::close(fd);
+    }
+
+    bool decide(const std::string &key, UserType type)
+    {
+        frame.clear();
+        appendRequest(DecisionRequest::DECIDE, key, type, 1);
+        uint8_t allowed;
+        if (!exchange(&allowed, sizeof(allowed)))
+            throw std::runtime_error("Decision server closed the connection");
+        return allowed;
+    }
+
+    AcquireResult acquire(const std::string &key, UserType type, uint32_t cost)
+    {
+        frame.clear();
+        appendRequest(DecisionRequest::ACQUIRE, key, type, cost);
+        AcquireReply reply;
+        if (!exchange(&reply, sizeof(reply)))
+            throw std::runtime_error("Decision server closed the connection");
+        return AcquireResult{reply.allowed != 0, reply.remaining, reply.retryAfterNanos};
+    }
+
+    // One BATCH frame; results in key order.
+    std::vector<bool> decideBatch(const std::vector<std::pair<std::string, UserType>> &requests)
+    {
+        if (requests.size() > DecisionRequest::MAX_BATCH)
+            throw std::invalid_argument("Batch too large");
+        frame.clear();
+        DecisionRequest header{DecisionRequest::BATCH, 0, 0, static_cast<uint32_t>(requests.size())};
+        frame.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &[key, type] : requests)
+        {
+            if (key.size() > UINT16_MAX)
+                throw std::invalid_argument("Key too long");
+            BatchItem item{static_cast<uint8_t>(type), 0, static_cast<uint16_t>(key.size())};
+            frame.append(reinterpret_cast<const char *>(&item), sizeof(item));
+            frame += key;
+        }
+        std::vector<uint8_t> replies(requests.size());
+        if (!exchange(replies.data(), replies.size()))
+            throw std::runtime_error("Decision server closed the connection");
+        return std::vector<bool>(replies.begin(), replies.end());
+    }
+};
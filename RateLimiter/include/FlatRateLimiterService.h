@@ -0,0 +1,490 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "AtomicTokenBucketRateLimiter.h"
+#include "FlatStateTable.h"
+#include "SlotAlgorithms.h"
+#include "StateSnapshot.h"
+#include "Clock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// ---------------- Flat Service ----------------
+// Drop-in alternative to RateLimiterService that keeps every user's config
+// index and algorithm state together in sharded FlatStateTables. A decision
+// hashes the key once (the top bits pick the shard, the low bits the slot),
+// takes no string copies and allocates nothing once a user exists.
+//
+// Algorithm state lives inline in the slot's two words (see SlotAlgorithms.h;
+// TOKEN_BUCKET uses the continuous-refill packed bucket). SLIDING_WINDOW
+// keeps a timestamp per request and cannot be stored flat; addConfig
+// rejects it.
+class FlatRateLimiterService
+{
+public:
+    struct CompiledLimit
+    {
+        RateLimitConfig config;
+        int64_t windowNanos = 0;
+        int64_t emissionInterval = 0;
+        TokenBucketParams bucket;
+    };
+
+    static constexpr size_t MAX_CONFIGS = 1024;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        FlatStateTable table;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    int shardBits;
+    Clock *clock;
+
+    // Reserved up front and only appended to under configMutex, so readers
+    // holding an index published through a shard lock never see it move.
+    std::vector<CompiledLimit> limits;
+    std::mutex configMutex;
+
+    Shard &shardFor(uint64_t hash)
+    {
+        return shards[shardBits ? hash >> (64 - shardBits) : 0];
+    }
+
+    static bool sameConfig(const RateLimitConfig &a, const RateLimitConfig &b)
+    {
+        return a.maxRequests == b.maxRequests && a.timeWindow == b.timeWindow &&
+               a.algorithm == b.algorithm;
+    }
+
+public:
+    // Precomputes everything decide() needs from a config.
+    static CompiledLimit compile(const RateLimitConfig &config)
+    {
+        CompiledLimit limit;
+        limit.config = config;
+        limit.windowNanos = config.timeWindow.nanos;
+        switch (config.algorithm)
+        {
+        case AlgorithmType::COUNTER:
+            break;
+        case AlgorithmType::SLIDING_WINDOW_COUNTER:
+            if (limit.windowNanos <= 0)
+                throw std::invalid_argument("Sliding window must be positive");
+            break;
+        case AlgorithmType::TOKEN_BUCKET:
+        case AlgorithmType::ATOMIC_TOKEN_BUCKET:
+        case AlgorithmType::SLOPPY_COUNTER:
+            limit.bucket = TokenBucketParams(config.maxRequests, limit.windowNanos);
+            break;
+        case AlgorithmType::LEAKY_BUCKET:
+            if (limit.windowNanos <= 0)
+                throw std::invalid_argument("Leaky bucket needs a positive window and burst");
+            limit.emissionInterval =
+                config.maxRequests > 0 ? limit.windowNanos / config.maxRequests : INT64_MAX;
+            break;
+        default:
+            throw std::invalid_argument("Unsupported algorithm for flat storage");
+        }
+        return limit;
+    }
+
+private:
+    uint16_t internConfig(const RateLimitConfig &config)
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        for (size_t i = 0; i < limits.size(); i++)
+        {
+            if (sameConfig(limits[i].config, config))
+                return static_cast<uint16_t>(i);
+        }
+        if (limits.size() == MAX_CONFIGS)
+            throw std::length_error("Too many distinct rate limit configs");
+        limits.push_back(compile(config));
+        return static_cast<uint16_t>(limits.size() - 1);
+    }
+
+public:
+    explicit FlatRateLimiterService(size_t shards = defaultShardCount(),
+                                    size_t expectedUsers = 0,
+                                    Clock &clock = systemClock())
+        : shardBits(0), clock(&clock)
+    {
+        size_t shardCount = 1;
+        while (shardCount < shards)
+        {
+            shardCount <<= 1;
+            shardBits++;
+        }
+        this->shards = std::make_unique<Shard[]>(shardCount);
+        if (expectedUsers)
+        {
+            for (size_t i = 0; i < shardCount; i++)
+                this->shards[i].table.reserve(expectedUsers / shardCount + 1);
+        }
+        limits.reserve(MAX_CONFIGS);
+    }
+
+    static size_t defaultShardCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency()) * 4;
+    }
+
+    // Decide using a slot's inline state, charging `cost` units. Exposed so
+    // batch and shared-memory front ends can reuse exactly the same arithmetic.
+    static bool decide(SlotState &state, const CompiledLimit &limit, int64_t now,
+                       uint32_t cost = 1, AcquireResult *result = nullptr)
+    {
+        switch (limit.config.algorithm)
+        {
+        case AlgorithmType::COUNTER:
+            return fixedWindowDecide(state, now, limit.config.maxRequests, limit.windowNanos, cost, result);
+        case AlgorithmType::SLIDING_WINDOW_COUNTER:
+            return slidingWindowCounterDecide(state, now, limit.config.maxRequests,
+                                              limit.windowNanos, cost, result);
+        case AlgorithmType::TOKEN_BUCKET:
+        case AlgorithmType::ATOMIC_TOKEN_BUCKET:
+        case AlgorithmType::SLOPPY_COUNTER:
+            return tokenBucketDecide(state, now, limit.bucket, cost, result);
+        case AlgorithmType::LEAKY_BUCKET:
+            return gcraDecide(state, now, limit.emissionInterval, cost, result);
+        default:
+            if (result)
+                *result = AcquireResult{false, 0, AcquireResult::NEVER};
+            return false;
+        }
+    }
+
+    void addConfig(std::string_view userId, const RateLimitConfig &config)
+    {
+        uint16_t index = internConfig(config);
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        Shard &shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        bool inserted;
+        FlatSlot &slot = shard.table.findOrInsert(userId, hash, index, inserted);
+        if (!inserted && limits[slot.configIndex].config.algorithm != config.algorithm)
+            slot.state[0] = slot.state[1] = 0;
+        slot.configIndex = index;
+    }
+
+    // Users without a config are rejected without creating any state, the
+    // same outcome as the original service's value-initialized config.
+    bool handleRequest(std::string_view userId)
+    {
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        Shard &shard = shardFor(hash);
+        int64_t now = clock->nowNanos();
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        FlatSlot *slot = shard.table.find(userId, hash);
+        if (!slot)
+            return false;
+        return decide(slot->state, limits[slot->configIndex], now);
+    }
+
+    // handleRequest for `cost` units, with remaining quota and retry-after.
+    // Users without a config can never be admitted.
+    AcquireResult tryAcquire(std::string_view userId, uint32_t cost = 1)
+    {
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        Shard &shard = shardFor(hash);
+        int64_t now = clock->nowNanos();
+        AcquireResult result{false, 0, AcquireResult::NEVER};
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        FlatSlot *slot = shard.table.find(userId, hash);
+        if (slot)
+            decide(slot->state, limits[slot->configIndex], now, cost, &result);
+        return result;
+    }
+
+    bool handleRequest(const User &user)
+    {
+        return handleRequest(user.userId, user.type);
+    }
+
+    // Same as handleRequest(User) without building a User per request.
+    bool handleRequest(std::string_view userId, UserType type)
+    {
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        Shard &shard = shardFor(hash);
+        int64_t now = clock->nowNanos();
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            FlatSlot *slot = shard.table.find(userId, hash);
+            if (slot)
+                return decide(slot->state, limits[slot->configIndex], now);
+        }
+        uint16_t index = internConfig(RateLimitPolicy::getConfig(type));
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        bool inserted;
+        FlatSlot &slot = shard.table.findOrInsert(userId, hash, index, inserted);
+        return decide(slot.state, limits[slot.configIndex], now);
+    }
+
+    // Batch form of handleRequest(string_view). Results match calling
+    // handleRequest on each key in order at one instant: the clock is read
+    // once, each shard is locked once, and keys of the same shard are
+    // evaluated in their original order. All keys are hashed and their slots
+    // prefetched before the first one is evaluated, so cache misses on a
+    // large table overlap instead of being paid one after another.
+    // costs, when not empty, must be the same length as userIds.
+    std::vector<bool> handleRequests(const std::vector<std::string_view> &userIds,
+                                     const std::vector<uint32_t> &costs = {})
+    {
+        const size_t count = userIds.size();
+        const size_t shardCount = size_t(1) << shardBits;
+        if (!costs.empty() && costs.size() != count)
+            throw std::invalid_argument("costs must match userIds");
+
+        std::vector<uint64_t> hashes(count);
+        std::vector<uint32_t> shardStart(shardCount + 1, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            hashes[i] = FlatStateTable::hashKey(userIds[i]);
+            size_t s = shardBits ? hashes[i] >> (64 - shardBits) : 0;
+            shards[s].table.prefetchHint(hashes[i]);
+            shardStart[s + 1]++;
+        }
+        for (size_t s = 0; s < shardCount; s++)
+            shardStart[s + 1] += shardStart[s];
+
+        // Counting sort by shard; stable, so per-shard order is preserved.
+        std::vector<uint32_t> order(count);
+        std::vector<uint32_t> cursor(shardStart.begin(), shardStart.end() - 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t s = shardBits ? hashes[i] >> (64 - shardBits) : 0;
+            order[cursor[s]++] = static_cast<uint32_t>(i);
+        }
+
+        std::vector<bool> allowed(count, false);
+        int64_t now = clock->nowNanos();
+        for (size_t s = 0; s < shardCount; s++)
+        {
+            uint32_t begin = shardStart[s], end = shardStart[s + 1];
+            if (begin == end)
+                continue;
+            std::lock_guard<std::mutex> lock(shards[s].mutex);
+            FlatStateTable &table = shards[s].table;
+            for (uint32_t j = begin; j < end; j++)
+                table.prefetchKey(hashes[order[j]]);
+            for (uint32_t j = begin; j < end; j++)
+            {
+                uint32_t i = order[j];
+                FlatSlot *slot = table.find(userIds[i], hashes[i]);
+                if (slot)
+                    allowed[i] = decide(slot->state, limits[slot->configIndex], now,
+                                        costs.empty() ? 1 : costs[i]);
+            }
+        }
+        return allowed;
+    }
+
+    void resetLimiter(std::string_view userId)
+    {
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        Shard &shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.table.erase(userId, hash);
+    }
+
+    size_t size()
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < (size_t(1) << shardBits); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            total += shards[i].table.size();
+        }
+        return total;
+    }
+
+    // Writes every shard's table to a snapshot at path (see StateSnapshot.h).
+    // Shards are copied one at a time under their own lock, so each is
+    // consistent and requests on the others are not held up; file IO
+    // happens outside the locks.
+    void saveSnapshot(const std::string &path)
+    {
+        const size_t shardCount = size_t(1) << shardBits;
+        SnapshotWriter writer(path, static_cast<uint32_t>(shardCount));
+        std::vector<FlatSlot> slots;
+        std::vector<char> keys;
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            size_t count, deadBytes;
+            {
+                std::lock_guard<std::mutex> lock(shards[i].mutex);
+                const FlatStateTable &table = shards[i].table;
+                slots.assign(table.slotData(), table.slotData() + table.capacity());
+                keys.assign(table.keyData(), table.keyData() + table.keyBytes());
+                count = table.size();
+                deadBytes = table.deadBytes();
+            }
+            writer.addShard(static_cast<uint32_t>(i), slots.data(), slots.size(), count,
+                            keys.data(), keys.size(), deadBytes);
+        }
+
+        std::vector<RateLimitConfig> configs;
+        {
+            std::lock_guard<std::mutex> lock(configMutex);
+            for (const CompiledLimit &limit : limits)
+                configs.push_back(limit.config);
+        }
+        writer.finish(configs, clock->nowNanos());
+    }
+
+    // Warm restart: loads a snapshot written by saveSnapshot into this
+    // service, which must not have seen any user or config yet. With the
+    // same shard count each shard's arrays are copied back whole; otherwise
+    // keys are re-inserted one by one. Returns false, leaving the service
+    // empty, when there is no file or it cannot be trusted against this
+    // clock (see SnapshotReader::usableAt). Throws on a malformed file.
+    bool loadSnapshot(const std::string &path)
+    {
+        if (::access(path.c_str(), F_OK) != 0)
+            return false;
+        SnapshotReader snapshot(path);
+        const SnapshotHeader &header = snapshot.getHeader();
+        if (!snapshot.usableAt(clock->nowNanos()))
+            return false;
+        if (header.configCount > MAX_CONFIGS)
+            throw std::runtime_error("Snapshot has too many configs");
+
+        std::lock_guard<std::mutex> configLock(configMutex);
+        if (!limits.empty() || size() != 0)
+            throw std::logic_error("loadSnapshot needs an empty service");
+        const size_t shardCount = size_t(1) << shardBits;
+        try
+        {
+            for (uint32_t i = 0; i < header.configCount; i++)
+                limits.push_back(compile(snapshot.config(i)));
+
+            if (header.shardCount == shardCount)
+            {
+                for (uint32_t i = 0; i < header.shardCount; i++)
+                {
+                    const SnapshotShard &saved = snapshot.shard(i);
+                    std::lock_guard<std::mutex> lock(shards[i].mutex);
+                    shards[i].table.restore(snapshot.slots(i), saved.capacity, snapshot.keys(i),
+                                            saved.keyBytes, saved.deadKeyBytes, limits.size());
+                }
+                return true;
+            }
+
+            for (uint32_t i = 0; i < header.shardCount; i++)
+            {
+                const SnapshotShard &saved = snapshot.shard(i);
+                const FlatSlot *slots = snapshot.slots(i);
+                const char *keys = snapshot.keys(i);
+                for (uint64_t j = 0; j < saved.capacity; j++)
+                {
+                    const FlatSlot &old = slots[j];
+                    if (old.hash == 0)
+                        continue;
+                    if (uint64_t(old.keyOffset) + old.keyLength > saved.keyBytes || old.configIndex >= limits.size())
+                        throw std::invalid_argument("Saved slot points outside its table");
+                    Shard &shard = shardFor(old.hash);
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    bool inserted;
+                    FlatSlot &slot = shard.table.findOrInsert(std::string_view(keys + old.keyOffset, old.keyLength),
+                                                              old.hash, old.configIndex, inserted);
+                    slot.state[0] = old.state[0];
+                    slot.state[1] = old.state[1];
+                }
+            }
+            return true;
+        }
+        catch (const std::exception &e)
+        {
+            limits.clear();
+            shards = std::make_unique<Shard[]>(shardCount);
+            throw std::runtime_error(std::string("Malformed snapshot ") + path + ": " + e.what());
+        }
+    }
+
+    size_t memoryBytes()
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < (size_t(1) << shardBits); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            total += shards[i].table.memoryBytes();
+        }
+        return total;
+    }
+};
+
+// ---------------- Periodic Snapshot ----------------
+// Saves a service's state every `interval` on a background thread, and once
+// more on destruction, so a restarted process loses at most one interval.
+class PeriodicSnapshot
+{
+private:
+    FlatRateLimiterService &service;
+    std::string path;
+    std::chrono::nanoseconds interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = true;
+    std::atomic<uint64_t> saves{0}, failures{0};
+    std::thread worker;
+
+    void save()
+    {
+        try
+        {
+            service.saveSnapshot(path);
+            saves.fetch_add(1, std::memory_order_relaxed);
+        }
+        catch (const std::exception &)
+        {
+            failures.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    PeriodicSnapshot(FlatRateLimiterService &service, std::string path,
+                     std::chrono::nanoseconds interval = std::chrono::seconds(10))
+        : service(service), path(std::move(path)), interval(interval)
+    {
+        worker = std::thread([this]
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wake.wait_for(lock, this->interval, [this] { return !running; }))
+            {
+                lock.unlock();
+                save();
+                lock.lock();
+            }
+        });
+    }
+
+    PeriodicSnapshot(const PeriodicSnapshot &) = delete;
+    PeriodicSnapshot &operator=(const PeriodicSnapshot &) = delete;
+
+    ~PeriodicSnapshot()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        worker.join();
+        save();
+    }
+
+    uint64_t saveCount() const { return saves.load(); }
+    uint64_t failureCount() const { return failures.load(); }
+};
@@ -0,0 +1,258 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// ---------------- Flat State Table ----------------
+// Open-addressing (linear probing) table holding everything a decision needs
+// for one key in a single 32-byte slot: the full hash, where the key bytes
+// live, which config applies and 16 bytes of algorithm state. Keys are
+// appended to one contiguous arena, so a key costs its length and nothing
+// else: no node, no per-key limiter object, no std::string.
+//
+// Callers hash the key once with hashKey() and pass the hash to every call,
+// which lets a sharded owner take its shard from the same hash. The table is
+// not synchronized, except for prefetchHint(), which may be called without
+// the owner's lock.
+struct FlatSlot
+{
+    uint64_t hash; // 0 marks an empty slot
+    uint32_t keyOffset;
+    uint16_t keyLength;
+    uint16_t configIndex;
+    uint64_t state[2];
+};
+static_assert(sizeof(FlatSlot) == 32, "FlatSlot must stay two per cache line");
+
+class FlatStateTable
+{
+private:
+    std::vector<FlatSlot> slots;
+    std::vector<char> keys;
+    size_t mask;
+    size_t count = 0;
+    size_t deadKeyBytes = 0;
+
+    // Copies of the slot array address and mask for prefetchHint(). They may
+    // be stale or torn against each other; a prefetch never faults, so the
+    // worst case is a useless hint.
+    std::atomic<uintptr_t> hintBase{0};
+    std::atomic<size_t> hintMask{0};
+
+    void publishHint()
+    {
+        hintBase.store(reinterpret_cast<uintptr_t>(slots.data()), std::memory_order_relaxed);
+        hintMask.store(mask, std::memory_order_relaxed);
+    }
+
+    bool matches(const FlatSlot &slot, std::string_view key, uint64_t hash) const
+    {
+        return slot.hash == hash && slot.keyLength == key.size() &&
+               std::memcmp(keys.data() + slot.keyOffset, key.data(), key.size()) == 0;
+    }
+
+    void rehash(size_t newCapacity)
+    {
+        std::vector<FlatSlot> oldSlots(newCapacity, FlatSlot{});
+        oldSlots.swap(slots);
+        std::vector<char> oldKeys;
+        oldKeys.reserve(keys.size() - deadKeyBytes);
+        oldKeys.swap(keys);
+        mask = newCapacity - 1;
+        deadKeyBytes = 0;
+
+        for (const FlatSlot &old : oldSlots)
+        {
+            if (old.hash == 0)
+                continue;
+            size_t i = old.hash & mask;
+            while (slots[i].hash != 0)
+                i = (i + 1) & mask;
+            slots[i] = old;
+            slots[i].keyOffset = static_cast<uint32_t>(keys.size());
+            keys.insert(keys.end(), oldKeys.data() + old.keyOffset,
+                        oldKeys.data() + old.keyOffset + old.keyLength);
+        }
+        publishHint();
+    }
+
+public:
+    static uint64_t hashKey(std::string_view key)
+    {
+        uint64_t h = std::hash<std::string_view>{}(key);
+        return h ? h : 1;
+    }
+
+    explicit FlatStateTable(size_t initialCapacity = 16)
+    {
+        size_t capacity = 16;
+        while (capacity < initialCapacity)
+            capacity <<= 1;
+        slots.assign(capacity, FlatSlot{});
+        mask = capacity - 1;
+        publishHint();
+    }
+
+    FlatStateTable(const FlatStateTable &) = delete;
+    FlatStateTable &operator=(const FlatStateTable &) = delete;
+
+    // Grow so that `entries` keys fit without another rehash.
+    void reserve(size_t entries)
+    {
+        size_t capacity = slots.size();
+        while (entries * 4 > capacity * 3)
+            capacity <<= 1;
+        if (capacity != slots.size())
+            rehash(capacity);
+    }
+
+    // Lock-free hint: start pulling key's home slot into cache.
+    void prefetchHint(uint64_t hash) const
+    {
+        uintptr_t base = hintBase.load(std::memory_order_relaxed);
+        size_t m = hintMask.load(std::memory_order_relaxed);
+        __builtin_prefetch(reinterpret_cast<const void *>(base + (hash & m) * sizeof(FlatSlot)), 1);
+    }
+
+    // Second stage, under the owner's lock: if key's home slot (ideally
+    // already cached by prefetchHint) holds this hash, pull in its key bytes
+    // so the comparison in find() does not miss.
+    void prefetchKey(uint64_t hash) const
+    {
+        const FlatSlot &slot = slots[hash & mask];
+        if (slot.hash == hash)
+            __builtin_prefetch(keys.data() + slot.keyOffset);
+    }
+
+    FlatSlot *find(std::string_view key, uint64_t hash)
+    {
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            FlatSlot &slot = slots[i];
+            if (slot.hash == 0)
+                return nullptr;
+            if (matches(slot, key, hash))
+                return &slot;
+        }
+    }
+
+    // Returns the slot for key, inserting one with zeroed state (and the
+    // given config) if the key is new. Pointers stay valid until the next
+    // insert or erase.
+    FlatSlot &findOrInsert(std::string_view key, uint64_t hash, uint16_t configIndex, bool &inserted)
+    {
+        if (key.size() > UINT16_MAX)
+            throw std::invalid_argument("Rate limit key too long");
+        if ((count + 1) * 4 > slots.size() * 3)
+            rehash(slots.size() * 2);
+        if (keys.size() + key.size() > UINT32_MAX)
+            throw std::length_error("Rate limit key arena full");
+
+        size_t i = hash & mask;
+        for (;; i = (i + 1) & mask)
+        {
+            FlatSlot &slot = slots[i];
+            if (slot.hash == 0)
+                break;
+            if (matches(slot, key, hash))
+            {
+                inserted = false;
+                return slot;
+            }
+        }
+
+        FlatSlot &slot = slots[i];
+        slot.hash = hash;
+        slot.keyOffset = static_cast<uint32_t>(keys.size());
+        slot.keyLength = static_cast<uint16_t>(key.size());
+        slot.configIndex = configIndex;
+        slot.state[0] = slot.state[1] = 0;
+        keys.insert(keys.end(), key.begin(), key.end());
+        count++;
+        inserted = true;
+        return slot;
+    }
+
+    // Backward-shift deletion: no tombstones, so probe lengths do not decay
+    // under churn.
+    bool erase(std::string_view key, uint64_t hash)
+    {
+        FlatSlot *found = find(key, hash);
+        if (!found)
+            return false;
+
+        size_t hole = static_cast<size_t>(found - slots.data());
+        deadKeyBytes += found->keyLength;
+        for (size_t i = (hole + 1) & mask;; i = (i + 1) & mask)
+        {
+            FlatSlot &slot = slots[i];
+            if (slot.hash == 0)
+                break;
+            size_t home = slot.hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask))
+            {
+                slots[hole] = slot;
+                hole = i;
+            }
+        }
+        slots[hole].hash = 0;
+        count--;
+
+        if (deadKeyBytes > 4096 && deadKeyBytes * 2 > keys.size())
+            rehash(slots.size());
+        return true;
+    }
+
+    // Raw layout, for snapshots: capacity() slots in probe order and the key
+    // arena, including the dead bytes of erased keys.
+    const FlatSlot *slotData() const { return slots.data(); }
+    const char *keyData() const { return keys.data(); }
+    size_t keyBytes() const { return keys.size(); }
+    size_t deadBytes() const { return deadKeyBytes; }
+
+    // Replaces the contents with a slot array and key arena saved from a
+    // table built with the same hash. Both are copied whole; no key is
+    // rehashed. Every slot must point inside the arena and use a config
+    // index below configCount.
+    void restore(const FlatSlot *savedSlots, size_t capacity, const char *savedKeys, size_t keyBytes,
+                 size_t savedDeadBytes, size_t configCount)
+    {
+        if (capacity < 16 || (capacity & (capacity - 1)) || keyBytes > UINT32_MAX)
+            throw std::invalid_argument("Saved table has an invalid shape");
+        size_t live = 0;
+        for (size_t i = 0; i < capacity; i++)
+        {
+            const FlatSlot &slot = savedSlots[i];
+            if (slot.hash == 0)
+                continue;
+            if (uint64_t(slot.keyOffset) + slot.keyLength > keyBytes || slot.configIndex >= configCount)
+                throw std::invalid_argument("Saved slot points outside its table");
+            live++;
+        }
+        if (live * 4 > capacity * 3 || savedDeadBytes > keyBytes)
+            throw std::invalid_argument("Saved table has an invalid shape");
+
+        slots.assign(savedSlots, savedSlots + capacity);
+        keys.assign(savedKeys, savedKeys + keyBytes);
+        mask = capacity - 1;
+        count = live;
+        deadKeyBytes = savedDeadBytes;
+        publishHint();
+    }
+
+    std::string_view keyOf(const FlatSlot &slot) const
+    {
+        return std::string_view(keys.data() + slot.keyOffset, slot.keyLength);
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+    size_t memoryBytes() const
+    {
+        return slots.capacity() * sizeof(FlatSlot) + keys.capacity();
+    }
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include "RateLimiter.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// ---------------- Windowed Count-Min Sketch ----------------
+// Approximate per-key request counts over a sliding window in fixed memory:
+// DEPTH rows of `width` 8-bit saturating counters for the current window
+// and the same again for the previous one. The estimate weights the
+// previous window by how much of it still overlaps the sliding window, like
+// SlidingWindowCounterRateLimiter does for a single key. Counts only ever
+// overestimate (collisions add, never subtract), and conservative update
+// (raise only the counters at the row minimum) keeps the overestimate
+// small. Counters stop at MAX_COUNT, so callers compare against small
+// thresholds.
+class WindowedCountMinSketch
+{
+public:
+    static constexpr int DEPTH = 4;
+    static constexpr uint32_t MAX_COUNT = UINT8_MAX;
+
+private:
+    size_t mask = 0;
+    std::vector<uint8_t> current, previous;
+    int64_t windowNanos;
+    int64_t windowStart = 0;
+    bool started = false;
+
+    size_t cell(int row, uint64_t hash) const
+    {
+        // Kirsch-Mitzenmacher: DEPTH indices from one hash and a mixed copy.
+        uint64_t h2 = (hash * 0x9E3779B97F4A7C15ull) | 1;
+        return row * (mask + 1) + ((hash + row * h2) & mask);
+    }
+
+    void roll(int64_t now)
+    {
+        if (!started)
+        {
+            windowStart = now;
+            started = true;
+            return;
+        }
+        if (now - windowStart < windowNanos)
+            return;
+        int64_t windows = (now - windowStart) / windowNanos;
+        if (windows == 1)
+            previous.swap(current);
+        else
+            std::fill(previous.begin(), previous.end(), 0);
+        std::fill(current.begin(), current.end(), 0);
+        windowStart += windows * windowNanos;
+    }
+
+public:
+    // width is rounded down to a power of two (at least 1).
+    WindowedCountMinSketch(size_t width, int64_t windowNanos)
+        : windowNanos(windowNanos)
+    {
+        if (windowNanos <= 0)
+            throw std::invalid_argument("Sketch window must be positive");
+        size_t rounded = 1;
+        while (rounded * 2 <= width)
+            rounded *= 2;
+        mask = rounded - 1;
+        current.assign(DEPTH * rounded, 0);
+        previous.assign(DEPTH * rounded, 0);
+    }
+
+    static size_t bytesFor(size_t width) { return 2 * DEPTH * width; }
+    size_t bytes() const { return bytesFor(mask + 1); }
+    int64_t window() const { return windowNanos; }
+
+    // Counts `cost` units for `hash` at `now` and returns the estimated
+    // units in the sliding window ending now, these included. The counters
+    // saturate but the returned estimate does not, so subtracting `cost`
+    // always gives back what the key had before.
+    uint32_t add(uint64_t hash, int64_t now, uint32_t cost = 1)
+    {
+        roll(now);
+        size_t cells[DEPTH];
+        uint32_t low = MAX_COUNT, lowPrevious = MAX_COUNT;
+        for (int row = 0; row < DEPTH; row++)
+        {
+            cells[row] = cell(row, hash);
+            low = std::min<uint32_t>(low, current[cells[row]]);
+            lowPrevious = std::min<uint32_t>(lowPrevious, previous[cells[row]]);
+        }
+        uint32_t next = low + std::min(cost, MAX_COUNT);
+        uint32_t stored = std::min(next, MAX_COUNT);
+        for (int row = 0; row < DEPTH; row++)
+            current[cells[row]] = static_cast<uint8_t>(std::max<uint32_t>(current[cells[row]], stored));
+
+        double overlap = 1.0 - static_cast<double>(now - windowStart) / windowNanos;
+        return next + static_cast<uint32_t>(lowPrevious * overlap);
+    }
+};
+
+// ---------------- Heavy-Hitter Pre-Filter ----------------
+// Front stage for keys that have no exact limiter state yet. Each request
+// for such a key is counted at its cost in a windowed Count-Min sketch
+// instead of allocating a config, a limiter and map nodes. While the key's
+// estimate stays below its tier's threshold the request is admitted on the
+// sketch alone; once it reaches it the key is a heavy hitter, and the
+// caller creates exact state charged with what the sketch already admitted.
+//
+// The threshold is promoteAt, capped so a key that is never promoted stays
+// within its tier's quota: at most maxRequests * window / timeWindow (or
+// maxRequests, when the sketch window is the longer one). A tier whose cap
+// rounds to zero gets exact state on its first request.
+//
+// Memory is the sketch alone, fixed at construction however many keys
+// arrive; its size decides how many distinct keys per window it can tell
+// apart. The sketch overestimates, so its error is promoting keys early,
+// which costs memory and at most a slightly early charge
+// (bench/prefilter_bench.cpp measures both).
+struct PrefilterPolicy
+{
+    size_t sketchBytes = 0;                 // total over all shards; 0 disables the pre-filter
+    uint32_t promoteAt = 2;                 // estimated requests per window that earn exact state
+    int64_t windowNanos = 10000000000;      // sketch window
+};
+
+struct PrefilterStats
+{
+    uint64_t admitted = 0;     // requests admitted on the sketch alone
+    uint64_t promoted = 0;     // keys given exact state
+    size_t sketchBytes = 0;
+};
+
+class HeavyHitterFilter
+{
+private:
+    WindowedCountMinSketch sketch;
+    uint32_t promoteAt;
+    uint64_t admitted = 0;
+    uint64_t promoted = 0;
+
+public:
+    // One filter per shard; bytes is this filter's share of the budget.
+    HeavyHitterFilter(size_t bytes, const PrefilterPolicy &policy)
+        : sketch(std::max<size_t>(1, bytes / WindowedCountMinSketch::bytesFor(1)), policy.windowNanos),
+          promoteAt(std::min(policy.promoteAt, WindowedCountMinSketch::MAX_COUNT))
+    {
+    }
+
+    uint32_t threshold(const RateLimitConfig &config) const
+    {
+        if (config.maxRequests <= 0 || config.timeWindow.nanos <= 0)
+            return 0;
+        double share = config.maxRequests * std::min(1.0, static_cast<double>(sketch.window()) / config.timeWindow.nanos);
+        return static_cast<uint32_t>(std::min<double>(promoteAt, share));
+    }
+
+    // Counts a request costing `cost` units for a stateless key and returns
+    // true when it is admitted on the sketch alone, false when the key must
+    // be promoted. `estimate` receives the key's estimated units in the
+    // window, this request's included.
+    bool admit(uint64_t hash, const RateLimitConfig &config, int64_t now, uint32_t cost,
+               uint32_t &estimate)
+    {
+        estimate = sketch.add(hash, now, cost);
+        if (estimate < threshold(config))
+        {
+            admitted++;
+            return true;
+        }
+        promoted++;
+        return false;
+    }
+
+    // What the sketch may have admitted for a key promoted at `estimate` by
+    // a request costing `cost`: every sketch admission saw an estimate below
+    // the threshold and estimates never undercount, so at most the smaller
+    // of threshold - 1 and the estimate before this request got through.
+    // The key's exact state should start charged with this much.
+    uint32_t admittedBefore(const RateLimitConfig &config, uint32_t estimate, uint32_t cost) const
+    {
+        uint32_t limit = threshold(config);
+        uint32_t before = estimate - std::min(estimate, std::min(cost, WindowedCountMinSketch::MAX_COUNT));
+        return limit ? std::min(before, limit - 1) : 0;
+    }
+
+    void collect(PrefilterStats &stats) const
+    {
+        stats.admitted += admitted;
+        stats.promoted += promoted;
+        stats.sketchBytes += sketch.bytes();
+    }
+};
@@ -0,0 +1,244 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "AtomicTokenBucketRateLimiter.h"
+#include "FlatStateTable.h"
+#include "FlatRateLimiterService.h"
+#include "Clock.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// ---------------- Striped Aggregate ----------------
+// One aggregate token bucket split into power-of-two stripes, each a packed
+// AtomicTokenBucket word on its own cache line holding an equal share of the
+// capacity and refill rate. Callers charge their home stripe, so threads
+// working on different keys rarely touch the same line; when the home stripe
+// runs short the others are tried in turn, so the aggregate only rejects
+// once every stripe is short. A single charge still has to fit in one
+// stripe's share.
+class StripedTokenBucket
+{
+public:
+    // Stripes are only split while each keeps at least this many tokens.
+    static constexpr int MIN_STRIPE_TOKENS = 16;
+
+private:
+    struct alignas(64) Stripe
+    {
+        std::atomic<uint64_t> word{0};
+        TokenBucketParams params;
+    };
+
+    std::unique_ptr<Stripe[]> stripes;
+    size_t stripeMask = 0;
+    bool unlimited = true;
+
+public:
+    StripedTokenBucket() = default;
+
+    StripedTokenBucket(const AggregateLimit &limit, size_t maxStripes, int64_t nowNanos)
+        : unlimited(limit.timeWindow.nanos == 0)
+    {
+        if (unlimited)
+            return;
+        if (limit.maxRequests < 0 || limit.timeWindow.nanos < 0)
+            throw std::invalid_argument("Aggregate limit must not be negative");
+        size_t total = static_cast<size_t>(limit.maxRequests);
+        size_t count = 1;
+        while (count * 2 <= maxStripes && count * 2 * MIN_STRIPE_TOKENS <= total)
+            count *= 2;
+        while (total / count + 1 > static_cast<size_t>(AtomicTokenBucket::MAX_TOKENS))
+            count *= 2;
+
+        stripes = std::make_unique<Stripe[]>(count);
+        stripeMask = count - 1;
+        for (size_t i = 0; i < count; i++)
+        {
+            int share = static_cast<int>(total / count + (i < total % count));
+            stripes[i].params = TokenBucketParams(share, limit.timeWindow.nanos);
+            stripes[i].word.store(AtomicTokenBucket::initial(stripes[i].params, AtomicTokenBucket::toTick(nowNanos)),
+                                  std::memory_order_relaxed);
+        }
+    }
+
+    bool isUnlimited() const { return unlimited; }
+    size_t stripeCount() const { return unlimited ? 0 : stripeMask + 1; }
+
+    // Charges cost (fixed-point tokens) to stripe `home` or, failing that,
+    // the first other stripe that can cover it. Returns the stripe charged,
+    // or -1 when none can.
+    long tryConsume(size_t home, uint64_t nowTick, uint64_t cost)
+    {
+        if (unlimited)
+            return 0;
+        for (size_t i = 0; i <= stripeMask; i++)
+        {
+            size_t index = (home + i) & stripeMask;
+            if (AtomicTokenBucket::tryConsume(stripes[index].word, nowTick, stripes[index].params, cost))
+                return static_cast<long>(index);
+        }
+        return -1;
+    }
+
+    void refund(long stripe, uint64_t cost)
+    {
+        if (!unlimited)
+            AtomicTokenBucket::refund(stripes[stripe].word, stripes[stripe].params, cost);
+    }
+};
+
+// Aggregate caps for HierarchicalRateLimiter; defaults() reads RateLimitPolicy.
+struct HierarchyLimits
+{
+    std::array<AggregateLimit, TIER_COUNT> tiers;
+    AggregateLimit global;
+
+    static HierarchyLimits defaults()
+    {
+        HierarchyLimits limits{};
+        for (int t = 0; t < TIER_COUNT; t++)
+            limits.tiers[t] = TIER_AGGREGATE_LIMITS[t];
+        limits.global = GLOBAL_LIMIT;
+        return limits;
+    }
+};
+
+// ---------------- Hierarchical Limiter ----------------
+// Enforces three nested quotas on every request: the user's own limit
+// (RateLimitPolicy tier config, kept in flat per-user slots), the combined
+// limit of the user's tier, and the global limit. One call checks and
+// charges all three:
+//
+//   1. the user's next state is computed on a copy, under the user's shard lock
+//   2. the tier aggregate is charged
+//   3. the global aggregate is charged; if it rejects, the tier is refunded
+//   4. only then is the user's new state stored
+//
+// so a request rejected at an outer level leaves the inner levels as they
+// were (up to a refund clipped by capacity, which errs toward rejecting).
+// The aggregates are StripedTokenBucket, so the shared counters are spread
+// over many cache lines instead of one hot word.
+class HierarchicalRateLimiter
+{
+public:
+    // Which level rejected a request; NONE means it was admitted.
+    enum class Level
+    {
+        NONE,
+        USER,
+        TIER,
+        GLOBAL
+    };
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        FlatStateTable table;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    int shardBits = 0;
+    std::array<FlatRateLimiterService::CompiledLimit, TIER_COUNT> userLimits;
+    std::array<StripedTokenBucket, TIER_COUNT> tiers;
+    StripedTokenBucket global;
+    Clock *clock;
+
+public:
+    static size_t defaultShardCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency()) * 4;
+    }
+
+    explicit HierarchicalRateLimiter(const HierarchyLimits &limits = HierarchyLimits::defaults(),
+                                     size_t shards = defaultShardCount(),
+                                     Clock &clock = systemClock())
+        : clock(&clock)
+    {
+        size_t shardCount = 1;
+        while (shardCount < shards)
+        {
+            shardCount <<= 1;
+            shardBits++;
+        }
+        this->shards = std::make_unique<Shard[]>(shardCount);
+
+        int64_t now = clock.nowNanos();
+        for (int t = 0; t < TIER_COUNT; t++)
+        {
+            userLimits[t] = FlatRateLimiterService::compile(TIER_CONFIGS[t]);
+            tiers[t] = StripedTokenBucket(limits.tiers[t], shardCount, now);
+        }
+        global = StripedTokenBucket(limits.global, shardCount, now);
+    }
+
+    Level acquire(std::string_view userId, UserType type, uint32_t cost = 1)
+    {
+        int tier = static_cast<int>(type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+
+        uint64_t hash = FlatStateTable::hashKey(userId);
+        size_t home = shardBits ? hash >> (64 - shardBits) : 0;
+        Shard &shard = shards[home];
+        int64_t now = clock->nowNanos();
+        uint64_t tick = AtomicTokenBucket::toTick(now);
+        uint64_t units = static_cast<uint64_t>(cost) << AtomicTokenBucket::FRACTION_BITS;
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        bool inserted;
+        FlatSlot &slot = shard.table.findOrInsert(userId, hash, static_cast<uint16_t>(tier), inserted);
+        if (slot.configIndex != tier)
+        {
+            // Tier changed: the old state belongs to a different limit.
+            slot.state[0] = slot.state[1] = 0;
+            slot.configIndex = static_cast<uint16_t>(tier);
+        }
+
+        SlotState next = {slot.state[0], slot.state[1]};
+        if (!FlatRateLimiterService::decide(next, userLimits[tier], now, cost))
+        {
+            // A rejected decision only rolls windows forward; keep that.
+            slot.state[0] = next[0];
+            slot.state[1] = next[1];
+            return Level::USER;
+        }
+
+        long tierStripe = tiers[tier].tryConsume(home, tick, units);
+        if (tierStripe < 0)
+            return Level::TIER;
+        if (global.tryConsume(home, tick, units) < 0)
+        {
+            tiers[tier].refund(tierStripe, units);
+            return Level::GLOBAL;
+        }
+
+        slot.state[0] = next[0];
+        slot.state[1] = next[1];
+        return Level::NONE;
+    }
+
+    bool handleRequest(const User &user, uint32_t cost = 1)
+    {
+        return acquire(user.userId, user.type, cost) == Level::NONE;
+    }
+
+    size_t size()
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < (size_t(1) << shardBits); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            total += shards[i].table.size();
+        }
+        return total;
+    }
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+//-------------------leaky-bucket (GCRA)-----------------------------
+// Leaky bucket expressed as the Generic Cell Rate Algorithm. Each key keeps
+// only its theoretical arrival time (TAT): the instant the bucket would be
+// empty if every accepted request had drained at one per emissionInterval.
+// A request is accepted when it arrives no earlier than TAT - tolerance,
+// which is the same decision the leaky bucket makes without a queue or any
+// refill arithmetic.
+//
+// burst is how many requests may arrive back to back; the default of 1
+// shapes traffic to strictly one request per window / maxRequests.
+
+// GCRA charging `cost` units against tat (0 for a key never seen). Admitted
+// when the arrival time after charging stays within tolerance + one
+// interval of now, so a cost above the burst can never be admitted.
+inline AcquireResult gcraAcquire(int64_t &tat, int64_t nowNanos, int64_t emissionInterval,
+                                 int64_t tolerance, uint32_t cost)
+{
+    AcquireResult result;
+    emissionInterval = std::max<int64_t>(emissionInterval, 1);
+    if (emissionInterval == INT64_MAX || (cost > 0 && cost - 1 > tolerance / emissionInterval))
+    {
+        result.retryAfterNanos = AcquireResult::NEVER;
+        return result;
+    }
+    int64_t start = std::max(tat, nowNanos);
+    int64_t limit = nowNanos + tolerance + emissionInterval;
+    int64_t charged = start + emissionInterval * cost;
+    if (charged <= limit)
+    {
+        tat = charged;
+        result.allowed = true;
+        result.remaining = (limit - charged) / emissionInterval;
+        return result;
+    }
+    result.remaining = std::max<int64_t>(0, (limit - start) / emissionInterval);
+    result.retryAfterNanos = charged - limit;
+    return result;
+}
+
+class LeakyBucketRateLimiter : public RateLimiter
+{
+private:
+    std::unordered_map<std::string, int64_t> theoreticalArrival;
+    int64_t emissionInterval;
+    int64_t tolerance;
+    Clock *clock;
+
+public:
+    LeakyBucketRateLimiter(int maxReq, TimeWindow window, int burst = 1, Clock &clock = systemClock())
+        : clock(&clock)
+    {
+        if (window.nanos <= 0 || burst < 1)
+            throw std::invalid_argument("Leaky bucket needs a positive window and burst");
+        emissionInterval = maxReq > 0 ? window.nanos / maxReq : INT64_MAX;
+        tolerance = maxReq > 0 ? emissionInterval * (burst - 1) : 0;
+    }
+
+    // retryAfterNanos, when given, receives 0 on acceptance and otherwise
+    // the exact wait until this key's next request would be accepted.
+    bool allowRequestAt(const std::string &userId, int64_t nowNanos,
+                        int64_t *retryAfterNanos = nullptr)
+    {
+        if (emissionInterval == INT64_MAX)
+        {
+            if (retryAfterNanos)
+                *retryAfterNanos = INT64_MAX;
+            return false;
+        }
+
+        auto it = theoreticalArrival.find(userId);
+        int64_t tat = it == theoreticalArrival.end() ? nowNanos : std::max(it->second, nowNanos);
+        int64_t wait = tat - tolerance - nowNanos;
+
+        if (wait > 0)
+        {
+            if (retryAfterNanos)
+                *retryAfterNanos = wait;
+            return false;
+        }
+
+        if (it == theoreticalArrival.end())
+            theoreticalArrival.emplace(userId, tat + emissionInterval);
+        else
+            it->second = tat + emissionInterval;
+        if (retryAfterNanos)
+            *retryAfterNanos = 0;
+        return true;
+    }
+
+    AcquireResult tryAcquireAt(const std::string &userId, int64_t nowNanos, uint32_t cost)
+    {
+        auto it = theoreticalArrival.find(userId);
+        int64_t tat = it == theoreticalArrival.end() ? 0 : it->second;
+        AcquireResult result = gcraAcquire(tat, nowNanos, emissionInterval, tolerance, cost);
+        if (result.allowed)
+        {
+            if (it == theoreticalArrival.end())
+                theoreticalArrival.emplace(userId, tat);
+            else
+                it->second = tat;
+        }
+        return result;
+    }
+
+    bool allowRequest(const std::string &userId) override
+    {
+        return allowRequestAt(userId, clock->nowNanos());
+    }
+
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override
+    {
+        return tryAcquireAt(userId, clock->nowNanos(), cost);
+    }
+
+    // Time until allowRequest would next succeed for userId, without
+    // consuming anything.
+    int64_t retryAfterNanos(const std::string &userId, int64_t nowNanos) const
+    {
+        if (emissionInterval == INT64_MAX)
+            return INT64_MAX;
+        auto it = theoreticalArrival.find(userId);
+        if (it == theoreticalArrival.end())
+            return 0;
+        return std::max<int64_t>(0, it->second - tolerance - nowNanos);
+    }
+
+    int64_t retryAfterNanos(const std::string &userId) const
+    {
+        return retryAfterNanos(userId, clock->nowNanos());
+    }
+};
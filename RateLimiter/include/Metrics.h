@@ -0,0 +1,338 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "PolicyStore.h"
+#include "Clock.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ---------------- Latency Histogram ----------------
+// HDR-style log-linear histogram of nanosecond values: SUB_BUCKETS linear
+// buckets per power of two, so every value is reported within 1/16 (about
+// 6%) of what was recorded, from 1 ns up to MAX_VALUE (larger values are
+// clamped). Recording is a bit scan and an increment; not synchronized.
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr uint64_t SUB_BUCKETS = 1ull << SUB_BITS;
+    static constexpr int MAX_BITS = 40;
+    static constexpr uint64_t MAX_VALUE = (1ull << MAX_BITS) - 1;
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+private:
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+
+    static size_t indexOf(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return static_cast<size_t>(value);
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return (static_cast<size_t>(shift + 1) << SUB_BITS) + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // Largest value that lands in bucket `index`.
+    static uint64_t highestIn(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+        int shift = static_cast<int>(index >> SUB_BITS) - 1;
+        return ((SUB_BUCKETS + (index & (SUB_BUCKETS - 1)) + 1) << shift) - 1;
+    }
+
+public:
+    void record(uint64_t nanos)
+    {
+        nanos = std::min(nanos, MAX_VALUE);
+        counts[indexOf(nanos)]++;
+        total++;
+        maximum = std::max(maximum, nanos);
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (size_t i = 0; i < BUCKETS; i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maximum; }
+
+    // Smallest recorded value v (to bucket precision) with at least
+    // `quantile` of the samples <= v; 0 when empty.
+    uint64_t valueAt(double quantile) const
+    {
+        if (total == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(quantile * total + 0.5);
+        rank = std::min(std::max<uint64_t>(rank, 1), total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(highestIn(i), maximum);
+        }
+        return maximum;
+    }
+};
+
+// ---------------- Metrics Snapshot ----------------
+struct DecisionCounts
+{
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+};
+
+// Point-in-time view of a RateLimiterService, aggregated over its shards.
+// Users with a config of their own (addConfig, or none at all) are counted
+// under CUSTOM_TIER. Latency is sampled: one decision in
+// latencySamplePeriod per thread is timed, from before the shard lock is
+// taken to the end of the decision.
+struct MetricsSnapshot
+{
+    static constexpr int CUSTOM_TIER = TIER_COUNT;
+
+    bool enabled = false;
+    std::array<DecisionCounts, TIER_COUNT + 1> byTier{};
+    std::array<DecisionCounts, ALGORITHM_COUNT> byAlgorithm{};
+    LatencyHistogram latency;
+    uint32_t latencySamplePeriod = 0;
+    size_t trackedKeys = 0;
+    size_t configuredKeys = 0;
+    size_t approxBytes = 0;     // the service's maps and entries; limiters' own state excluded
+    std::vector<std::pair<std::string, uint64_t>> topRejected; // most rejected first, estimated from a sample
+
+    DecisionCounts total() const
+    {
+        DecisionCounts sum;
+        for (const DecisionCounts &c : byTier)
+        {
+            sum.accepted += c.accepted;
+            sum.rejected += c.rejected;
+        }
+        return sum;
+    }
+
+    // Prometheus text exposition format.
+    std::string dump() const
+    {
+        std::ostringstream out;
+        auto counts = [&](const char *metric, const char *label, const char *value, const DecisionCounts &c)
+        {
+            out << metric << '{' << label << "=\"" << value << "\",result=\"accepted\"} " << c.accepted << '\n'
+                << metric << '{' << label << "=\"" << value << "\",result=\"rejected\"} " << c.rejected << '\n';
+        };
+        out << "# TYPE rate_limiter_decisions_total counter\n";
+        for (int t = 0; t <= TIER_COUNT; t++)
+            counts("rate_limiter_decisions_total", "tier", t < TIER_COUNT ? PolicyStore::TIER_NAMES[t] : "CUSTOM",
+                   byTier[t]);
+        out << "# TYPE rate_limiter_algorithm_decisions_total counter\n";
+        for (int a = 0; a < ALGORITHM_COUNT; a++)
+            counts("rate_limiter_algorithm_decisions_total", "algorithm", PolicyStore::ALGORITHM_NAMES[a],
+                   byAlgorithm[a]);
+
+        out << "# TYPE rate_limiter_decision_latency_ns summary\n";
+        for (double q : {0.5, 0.9, 0.99, 0.999})
+            out << "rate_limiter_decision_latency_ns{quantile=\"" << q << "\"} " << latency.valueAt(q) << '\n';
+        out << "rate_limiter_decision_latency_ns_count " << latency.count() << '\n'
+            << "rate_limiter_decision_latency_ns_max " << latency.max() << '\n'
+            << "rate_limiter_decision_latency_sample_period " << latencySamplePeriod << '\n';
+
+        out << "# TYPE rate_limiter_tracked_keys gauge\n"
+            << "rate_limiter_tracked_keys " << trackedKeys << '\n'
+            << "# TYPE rate_limiter_configured_keys gauge\n"
+            << "rate_limiter_configured_keys " << configuredKeys << '\n'
+            << "# TYPE rate_limiter_table_bytes gauge\n"
+            << "rate_limiter_table_bytes " << approxBytes << '\n';
+
+        out << "# TYPE rate_limiter_top_rejected gauge\n";
+        for (const auto &[key, count] : topRejected)
+        {
+            out << "rate_limiter_top_rejected{key=\"";
+            for (char c : key)
+            {
+                if (c == '\\' || c == '"')
+                    out << '\\' << c;
+                else if (c == '\n')
+                    out << "\\n";
+                else
+                    out << c;
+            }
+            out << "\"} " << count << '\n';
+        }
+        return out.str();
+    }
+};
+
+// ---------------- Shard Metrics ----------------
+// What one RateLimiterService shard records about its decisions. The
+// counters are written only under the shard lock the decision already
+// holds, so each shard's block stays in the deciding core's cache much like
+// per-thread counters would, an update is a few plain increments, and
+// readers aggregate under the same locks.
+//
+// Top rejected keys are tracked with a TOP_KEYS-entry space-saving list per
+// shard, fed one rejection in REJECT_SAMPLE_PERIOD (chosen by a per-shard
+// generator, so periodic traffic cannot hide from it): a key rejected more
+// than 1/TOP_KEYS of the shard's rejections is listed, and its count is
+// what was sampled since it last entered the list, scaled by the period.
+// Keys never move between shards, so merging the lists loses nothing.
+//
+// Rejections are what spike under attack, so the list is kept cheap: it is
+// scanned by the 64-bit key hash the service already computed rather than
+// by string, and the key is copied only when it takes over an entry, into
+// a string whose capacity is reused.
+//
+// Define RATE_LIMITER_NO_METRICS to compile all of it out: ShardMetrics and
+// its Sample become empty and the snapshot reports enabled = false.
+#ifndef RATE_LIMITER_NO_METRICS
+class ShardMetrics
+{
+public:
+    static constexpr uint32_t LATENCY_SAMPLE_PERIOD = 64;
+    static constexpr size_t TOP_KEYS = 16;
+    static constexpr uint32_t REJECT_SAMPLE_PERIOD = 16;
+    static_assert(REJECT_SAMPLE_PERIOD > 1 && (REJECT_SAMPLE_PERIOD & (REJECT_SAMPLE_PERIOD - 1)) == 0,
+                  "The reject sample period must be a power of two above 1");
+
+    // Taken before the shard lock; times one call in LATENCY_SAMPLE_PERIOD
+    // per thread, so the clock reads are amortized over the rest.
+    class Sample
+    {
+        friend class ShardMetrics;
+        struct Untimed
+        {
+        };
+        int64_t begin = 0;
+
+        explicit Sample(Untimed) {}
+
+    public:
+        Sample()
+        {
+            thread_local uint32_t calls = 0;
+            if (++calls % LATENCY_SAMPLE_PERIOD == 0)
+                begin = monotonicNanos();
+        }
+
+        // For decisions made in a batch, which are not timed one by one.
+        static Sample untimed() { return Sample(Untimed{}); }
+    };
+
+private:
+    std::array<DecisionCounts, TIER_COUNT + 1> byTier{};
+    std::array<DecisionCounts, ALGORITHM_COUNT> byAlgorithm{};
+    LatencyHistogram latency;
+    // Top rejected keys, split so the scan reads two dense arrays.
+    std::array<uint64_t, TOP_KEYS> rejectedHashes{};
+    std::array<uint64_t, TOP_KEYS> rejectedCounts{};
+    std::array<uint64_t, TOP_KEYS> rejectedErrors{}; // count inherited from the key it replaced
+    std::array<std::string, TOP_KEYS> rejectedKeys;
+    uint64_t rejectSampler = 0x9E3779B97F4A7C15ull;
+
+    // The scan has no early exit and picks with conditional moves: the
+    // counts of a space-saving list stay close together, so branching on
+    // them would mispredict on most entries.
+    void countRejected(const std::string &key, uint64_t hash)
+    {
+        // One LCG step; its top bits pick one call in REJECT_SAMPLE_PERIOD.
+        rejectSampler = rejectSampler * 6364136223846793005ull + 1442695040888963407ull;
+        if (rejectSampler >> (64 - __builtin_ctz(REJECT_SAMPLE_PERIOD)))
+            return;
+        size_t found = TOP_KEYS;
+        size_t smallest = 0;
+        uint64_t least = rejectedCounts[0];
+        for (size_t i = 0; i < TOP_KEYS; i++)
+        {
+            uint64_t count = rejectedCounts[i];
+            found = (rejectedHashes[i] == hash && count) ? i : found;
+            smallest = count < least ? i : smallest;
+            least = count < least ? count : least;
+        }
+        if (found != TOP_KEYS)
+        {
+            rejectedCounts[found]++;
+            return;
+        }
+        // Space-saving: the new key inherits the evicted count as its
+        // possible overestimate.
+        rejectedHashes[smallest] = hash;
+        rejectedKeys[smallest].assign(key);
+        rejectedErrors[smallest] = rejectedCounts[smallest];
+        rejectedCounts[smallest]++;
+    }
+
+public:
+    // tier < 0 counts as MetricsSnapshot::CUSTOM_TIER. keyHash identifies
+    // the key; two keys with the same hash share a top-rejected entry.
+    void record(int tier, AlgorithmType algorithm, bool allowed, const std::string &key, uint64_t keyHash,
+                const Sample &sample)
+    {
+        DecisionCounts &t = byTier[tier < 0 ? MetricsSnapshot::CUSTOM_TIER : tier];
+        DecisionCounts &a = byAlgorithm[static_cast<int>(algorithm)];
+        if (allowed)
+        {
+            t.accepted++;
+            a.accepted++;
+        }
+        else
+        {
+            t.rejected++;
+            a.rejected++;
+            countRejected(key, keyHash);
+        }
+        if (sample.begin)
+            latency.record(static_cast<uint64_t>(monotonicNanos() - sample.begin));
+    }
+
+    // Adds this shard's counters to `snapshot`; topRejected is left unsorted
+    // and untrimmed.
+    void collect(MetricsSnapshot &snapshot) const
+    {
+        snapshot.enabled = true;
+        snapshot.latencySamplePeriod = LATENCY_SAMPLE_PERIOD;
+        for (size_t t = 0; t < byTier.size(); t++)
+        {
+            snapshot.byTier[t].accepted += byTier[t].accepted;
+            snapshot.byTier[t].rejected += byTier[t].rejected;
+        }
+        for (size_t a = 0; a < byAlgorithm.size(); a++)
+        {
+            snapshot.byAlgorithm[a].accepted += byAlgorithm[a].accepted;
+            snapshot.byAlgorithm[a].rejected += byAlgorithm[a].rejected;
+        }
+        snapshot.latency.merge(latency);
+        for (size_t i = 0; i < TOP_KEYS; i++)
+        {
+            if (rejectedCounts[i] > rejectedErrors[i])
+                snapshot.topRejected.emplace_back(rejectedKeys[i],
+                                                  (rejectedCounts[i] - rejectedErrors[i]) * REJECT_SAMPLE_PERIOD);
+        }
+    }
+};
+#else
+class ShardMetrics
+{
+public:
+    static constexpr size_t TOP_KEYS = 0;
+
+    class Sample
+    {
+    public:
+        static Sample untimed() { return Sample(); }
+    };
+
+    void record(int, AlgorithmType, bool, const std::string &, uint64_t, const Sample &) {}
+    void collect(MetricsSnapshot &) const {}
+};
+#endif
@@ -0,0 +1,191 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "RateLimiterFactory.h"
+#include "Rcu.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// ---------------- Policy Store ----------------
+// Runtime tier table, replaceable while requests are being served. Readers
+// go through Rcu and never lock; version() is a single atomic load, so a
+// caller that remembers the version it last saw can skip the read entirely
+// until a reload happens. The store starts from the compiled TIER_CONFIGS.
+//
+// Policy file format, one tier per line, '#' starts a comment:
+//
+//   # tier      maxRequests  timeWindow  algorithm
+//   FREE        5            10          COUNTER
+//   PREMIUM_1   20           30          SLIDING_WINDOW_COUNTER
+//   PREMIUM_2   20           100ms       TOKEN_BUCKET
+//
+// A window is a whole number of seconds, or a whole number with one of the
+// units s, ms, us or ns. A SLOPPY_COUNTER line may add a fifth column,
+// maxOverAdmission in requests (e.g. `PREMIUM_3 100 60 SLOPPY_COUNTER 8`).
+// Every tier must be listed exactly once.
+struct TierPolicy
+{
+    std::array<RateLimitConfig, TIER_COUNT> tiers;
+    uint64_t version = 0;
+};
+
+class PolicyStore
+{
+private:
+    Rcu<TierPolicy> current;
+    std::atomic<uint64_t> latest{0};
+    std::mutex writerMutex;
+
+    template <typename Names>
+    static int lookup(const Names &names, const std::string &word)
+    {
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            if (word == names[i])
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    static std::unique_ptr<TierPolicy> compiled()
+    {
+        auto policy = std::make_unique<TierPolicy>();
+        for (int t = 0; t < TIER_COUNT; t++)
+            policy->tiers[t] = TIER_CONFIGS[t];
+        return policy;
+    }
+
+public:
+    static constexpr const char *TIER_NAMES[] = {"FREE", "PREMIUM_1", "PREMIUM_2", "PREMIUM_3"};
+    static constexpr const char *ALGORITHM_NAMES[] = {"COUNTER", "SLIDING_WINDOW", "TOKEN_BUCKET", "LEAKY_BUCKET",
+                                                      "ATOMIC_TOKEN_BUCKET", "SLIDING_WINDOW_COUNTER", "SLOPPY_COUNTER"};
+    static_assert(sizeof(TIER_NAMES) / sizeof(TIER_NAMES[0]) == TIER_COUNT, "Every tier needs a name");
+    static_assert(sizeof(ALGORITHM_NAMES) / sizeof(ALGORITHM_NAMES[0]) == ALGORITHM_COUNT,
+                  "Every algorithm needs a name");
+
+    PolicyStore() : current(compiled()) {}
+
+    // The store services use unless given another.
+    static PolicyStore &global()
+    {
+        static PolicyStore store;
+        return store;
+    }
+
+    uint64_t version() const { return latest.load(std::memory_order_acquire); }
+
+    Rcu<TierPolicy>::ReadGuard read() const { return current.read(); }
+
+    RateLimitConfig getConfig(UserType type) const
+    {
+        int tier = static_cast<int>(type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+        return current.read()->tiers[tier];
+    }
+
+    // Publishes a new tier table. Every config is checked by building a
+    // limiter from it first, so a bad table is rejected whole.
+    void update(const std::array<RateLimitConfig, TIER_COUNT> &tiers)
+    {
+        for (const RateLimitConfig &config : tiers)
+            RateLimiterFactory::createLimiter(config);
+        std::lock_guard<std::mutex> lock(writerMutex);
+        auto next = std::make_unique<TierPolicy>();
+        next->tiers = tiers;
+        next->version = latest.load(std::memory_order_relaxed) + 1;
+        uint64_t version = next->version;
+        current.update(std::move(next));
+        latest.store(version, std::memory_order_release);
+    }
+
+    static bool parseWindow(const std::string &word, TimeWindow &window)
+    {
+        static const std::pair<const char *, int64_t> UNITS[] = {
+            {"", 1000000000}, {"s", 1000000000}, {"ms", 1000000}, {"us", 1000}, {"ns", 1}};
+        size_t digits = 0;
+        while (digits < word.size() && digits < 12 && std::isdigit(static_cast<unsigned char>(word[digits])))
+            digits++;
+        if (digits == 0)
+            return false;
+        for (const auto &[unit, nanos] : UNITS)
+        {
+            if (word.compare(digits, std::string::npos, unit) == 0)
+            {
+                window = TimeWindow::fromNanos(std::stoll(word.substr(0, digits)) * nanos);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool parseOverAdmission(const std::string &word, int64_t &bound)
+    {
+        if (word.empty() || word.size() > 12 ||
+            !std::all_of(word.begin(), word.end(), [](unsigned char c) { return std::isdigit(c); }))
+            return false;
+        bound = std::stoll(word);
+        return true;
+    }
+
+    static std::array<RateLimitConfig, TIER_COUNT> parse(std::istream &in)
+    {
+        std::array<RateLimitConfig, TIER_COUNT> tiers{};
+        std::array<bool, TIER_COUNT> seen{};
+        std::string line;
+        for (int number = 1; std::getline(in, line); number++)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string tierName, windowName, algorithmName;
+            if (!(fields >> tierName))
+                continue;
+            RateLimitConfig config{};
+            std::string extra;
+            int tier = lookup(TIER_NAMES, tierName);
+            if (!(fields >> config.maxRequests >> windowName >> algorithmName) ||
+                !parseWindow(windowName, config.timeWindow))
+                throw std::invalid_argument("Policy line " + std::to_string(number) + ": expected tier maxRequests timeWindow algorithm");
+            int algorithm = lookup(ALGORITHM_NAMES, algorithmName);
+            if (tier < 0 || algorithm < 0)
+                throw std::invalid_argument("Policy line " + std::to_string(number) + ": unknown tier or algorithm");
+            // SLOPPY_COUNTER takes an optional over-admission bound.
+            if (static_cast<AlgorithmType>(algorithm) == AlgorithmType::SLOPPY_COUNTER && (fields >> extra) &&
+                !parseOverAdmission(extra, config.maxOverAdmission))
+                throw std::invalid_argument("Policy line " + std::to_string(number) + ": bad maxOverAdmission " + extra);
+            if (fields >> extra)
+                throw std::invalid_argument("Policy line " + std::to_string(number) + ": unexpected " + extra);
+            if (seen[tier])
+                throw std::invalid_argument("Policy line " + std::to_string(number) + ": " + tierName + " listed twice");
+            config.algorithm = static_cast<AlgorithmType>(algorithm);
+            tiers[tier] = config;
+            seen[tier] = true;
+        }
+        for (int t = 0; t < TIER_COUNT; t++)
+        {
+            if (!seen[t])
+                throw std::invalid_argument(std::string("Policy does not list ") + TIER_NAMES[t]);
+        }
+        return tiers;
+    }
+
+    // Parses and publishes path; on any error the current table stays.
+    void loadFile(const std::string &path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error("Cannot open policy file " + path);
+        update(parse(in));
+    }
+};
@@ -0,0 +1,581 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "AtomicTokenBucketRateLimiter.h"
+#include "TimingWheel.h"
+#include "Clock.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ---------------- Quota Leasing ----------------
+// Shares one limit per key between many gateway processes. A QuotaServer
+// owns the authoritative bucket for every key; each gateway runs a
+// LeasedRateLimiterService that takes blocks of tokens ("leases") from the
+// server and spends them locally without coordination. Tokens left when a
+// lease expires go back to the server (within one sweep of its expiry,
+// whether or not the key sees another request), so the sum admitted by all
+// nodes never exceeds the configured limit; tokens parked in live leases
+// can make it admit somewhat less.
+//
+// Lease size follows each key's request rate on that node: a key that used
+// r tokens/s asks for about r * leaseTtl next time, so a steady key costs
+// one round trip per lease TTL and a cold key borrows a single token.
+//
+// Wire format (host byte order, stream socket):
+//   LeaseRequest  header then keyLength key bytes
+//   LeaseReply    for LEASE requests only; RETURN is one-way
+struct LeaseRequest
+{
+    static constexpr uint8_t LEASE = 1;
+    static constexpr uint8_t RETURN = 2;
+
+    uint8_t op;
+    uint8_t type;       // UserType, selects the key's tier config
+    uint16_t keyLength;
+    uint32_t tokens;    // wanted (LEASE) or handed back (RETURN)
+};
+
+struct LeaseReply
+{
+    uint32_t granted;
+    uint32_t reserved;
+    int64_t ttlNanos;
+};
+
+static_assert(sizeof(LeaseRequest) == 8 && sizeof(LeaseReply) == 16, "Lease messages must be packed");
+
+namespace lease_io
+{
+    inline bool writeAll(int fd, const void *data, size_t length)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (length)
+        {
+            ssize_t n = ::send(fd, p, length, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    inline bool readAll(int fd, void *data, size_t length)
+    {
+        char *p = static_cast<char *>(data);
+        while (length)
+        {
+            ssize_t n = ::read(fd, p, length);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    inline sockaddr_un address(const std::string &path)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            throw std::invalid_argument("Socket path too long");
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return addr;
+    }
+}
+
+// ---------------- Quota Server ----------------
+// Single-threaded poll loop; every key is a token bucket with its tier's
+// maxRequests per timeWindow (the algorithm field is not used: leasing
+// needs divisible quota). A grant is capped at 1/MAX_GRANT_DIVISOR of the
+// key's capacity so one node cannot drain a key for all the others.
+class QuotaServer
+{
+public:
+    static constexpr uint32_t MAX_GRANT_DIVISOR = 8;
+
+    struct Stats
+    {
+        uint64_t leases = 0;
+        uint64_t returns = 0;
+        uint64_t tokensGranted = 0;
+        uint64_t tokensReturned = 0;
+    };
+
+private:
+    struct Connection
+    {
+        int fd;
+        std::string pending;
+    };
+
+    int listener = -1;
+    std::string path;
+    int64_t leaseTtlNanos;
+    Clock *clock;
+    std::unordered_map<std::string, uint64_t> buckets;
+    std::vector<Connection> connections;
+    std::atomic<bool> running{false};
+    Stats stats;
+
+    static TokenBucketParams paramsFor(uint8_t type)
+    {
+        RateLimitConfig config = RateLimitPolicy::getConfig(static_cast<UserType>(type));
+        return TokenBucketParams(config.maxRequests, config.timeWindow.nanos);
+    }
+
+    // Takes up to `wanted` whole tokens; ttlNanos receives how long the
+    // lease lasts, or for an empty grant how long until a token refills.
+    uint32_t grant(const std::string &key, uint8_t type, uint32_t wanted, int64_t &ttlNanos)
+    {
+        TokenBucketParams params = paramsFor(type);
+        int64_t now = clock->nowNanos();
+        uint64_t tick = AtomicTokenBucket::toTick(now);
+        auto it = buckets.find(key);
+        if (it == buckets.end())
+            it = buckets.emplace(key, AtomicTokenBucket::initial(params, tick)).first;
+
+        uint64_t word = AtomicTokenBucket::refill(it->second, tick, params);
+        uint64_t whole = AtomicTokenBucket::tokensOf(word) >> AtomicTokenBucket::FRACTION_BITS;
+        uint64_t cap = std::max<uint64_t>(1, (params.capacity >> AtomicTokenBucket::FRACTION_BITS) / MAX_GRANT_DIVISOR);
+        uint64_t granted = std::min<uint64_t>({wanted, whole, cap});
+        ttlNanos = leaseTtlNanos;
+        if (granted == 0)
+        {
+            int64_t retry = AtomicTokenBucket::rejected(it->second, now, params, AtomicTokenBucket::ONE).retryAfterNanos;
+            ttlNanos = std::min(retry, leaseTtlNanos);
+        }
+        it->second = word - ((granted << AtomicTokenBucket::FRACTION_BITS) << AtomicTokenBucket::STAMP_BITS);
+        return static_cast<uint32_t>(granted);
+    }
+
+    void giveBack(const std::string &key, uint8_t type, uint32_t tokens)
+    {
+        auto it = buckets.find(key);
+        if (it == buckets.end())
+            return;
+        TokenBucketParams params = paramsFor(type);
+        uint64_t word = it->second;
+        uint64_t refunded = std::min(params.capacity,
+                                     AtomicTokenBucket::tokensOf(word) +
+                                         (static_cast<uint64_t>(tokens) << AtomicTokenBucket::FRACTION_BITS));
+        it->second = AtomicTokenBucket::pack(refunded, AtomicTokenBucket::stampOf(word));
+    }
+
+    // Handles every complete request buffered for c; false drops c.
+    bool serve(Connection &c)
+    {
+        size_t offset = 0;
+        while (c.pending.size() - offset >= sizeof(LeaseRequest))
+        {
+            LeaseRequest request;
+            std::memcpy(&request, c.pending.data() + offset, sizeof(request));
+            if (c.pending.size() - offset < sizeof(request) + request.keyLength)
+                break;
+            if (request.type >= TIER_COUNT)
+                return false;
+            std::string key = c.pending.substr(offset + sizeof(request), request.keyLength);
+            offset += sizeof(request) + request.keyLength;
+
+            if (request.op == LeaseRequest::LEASE)
+            {
+                LeaseReply reply{0, 0, 0};
+                reply.granted = grant(key, request.type, request.tokens, reply.ttlNanos);
+                stats.leases++;
+                stats.tokensGranted += reply.granted;
+                if (!lease_io::writeAll(c.fd, &reply, sizeof(reply)))
+                    return false;
+            }
+            else if (request.op == LeaseRequest::RETURN)
+            {
+                giveBack(key, request.type, request.tokens);
+                stats.returns++;
+                stats.tokensReturned += request.tokens;
+            }
+            else
+                return false;
+        }
+        c.pending.erase(0, offset);
+        return true;
+    }
+
+public:
+    QuotaServer(const std::string &path, int64_t leaseTtlNanos = 200000000, Clock &clock = systemClock())
+        : path(path), leaseTtlNanos(leaseTtlNanos), clock(&clock)
+    {
+        if (leaseTtlNanos <= 0)
+            throw std::invalid_argument("Lease TTL must be positive");
+        sockaddr_un addr = lease_io::address(path);
+        listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+            throw std::runtime_error("Cannot create quota socket");
+        ::unlink(path.c_str());
+        if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listener, 128) != 0)
+        {
+            ::close(listener);
+            throw std::runtime_error("Cannot listen on " + path);
+        }
+    }
+
+    QuotaServer(const QuotaServer &) = delete;
+    QuotaServer &operator=(const QuotaServer &) = delete;
+
+    ~QuotaServer()
+    {
+        for (Connection &c : connections)
+            ::close(c.fd);
+        ::close(listener);
+        ::unlink(path.c_str());
+    }
+
+    // Serves until stop() is called (checked every 50 ms).
+    void run()
+    {
+        running.store(true);
+        std::vector<pollfd> fds;
+        char buffer[64 * 1024];
+        while (running.load(std::memory_order_relaxed))
+        {
+            fds.assign(1, pollfd{listener, POLLIN, 0});
+            for (Connection &c : connections)
+                fds.push_back(pollfd{c.fd, POLLIN, 0});
+            if (::poll(fds.data(), fds.size(), 50) <= 0)
+                continue;
+
+            std::vector<bool> dropped(connections.size(), false);
+            for (size_t i = 1; i < fds.size(); i++)
+            {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                    continue;
+                Connection &c = connections[i - 1];
+                ssize_t n = ::read(c.fd, buffer, sizeof(buffer));
+                if (n <= 0)
+                {
+                    dropped[i - 1] = n == 0 || errno != EINTR;
+                    continue;
+                }
+                c.pending.append(buffer, static_cast<size_t>(n));
+                dropped[i - 1] = !serve(c);
+            }
+            for (size_t i = connections.size(); i-- > 0;)
+            {
+                if (dropped[i])
+                {
+                    ::close(connections[i].fd);
+                    connections.erase(connections.begin() + i);
+                }
+            }
+            if (fds[0].revents & POLLIN)
+            {
+                int fd = ::accept(listener, nullptr, nullptr);
+                if (fd >= 0)
+                    connections.push_back(Connection{fd, std::string()});
+            }
+        }
+    }
+
+    void stop() { running.store(false); }
+    const Stats &getStats() const { return stats; }
+};
+
+// ---------------- Leased Limiter ----------------
+// Node side. Keys are sharded as in RateLimiterService; a request spends a
+// token from the key's live lease, and only a missing, empty or expired
+// lease costs a round trip to the server. Each shard has its own
+// connection, used only under that shard's lock, so a slow reply holds up
+// the keys of one shard, not the whole node.
+//
+// Each shard also keeps a TimingWheel of lease expiries. It is advanced on
+// every request to the shard and by a sweeper thread every sweepInterval
+// (0 leaves it to the caller's returnExpired()), so a lease's leftover
+// tokens go back to the server once it expires even if its key goes quiet.
+class LeasedRateLimiterService
+{
+public:
+    struct Stats
+    {
+        uint64_t decisions = 0;
+        uint64_t leaseRequests = 0;
+        uint64_t returns = 0;
+    };
+
+    // Bounds on the tokens asked for in one lease.
+    static constexpr uint32_t MIN_LEASE = 1;
+    static constexpr uint32_t MAX_LEASE = 4096;
+
+    // Granularity of the lease expiry wheels.
+    static constexpr int64_t EXPIRY_TICK_NANOS = 10000000;
+
+private:
+    struct Lease
+    {
+        uint32_t tokens = 0;
+        uint32_t used = 0;
+        uint32_t nextRequest = MIN_LEASE;
+        int64_t start = 0;
+        int64_t expiry = 0;
+        uint64_t wheelDeadline = 0;     // tick of this lease's wheel entry, 0 if none
+        UserType type = UserType::FREE;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        int fd = -1;
+        std::unordered_map<std::string, Lease> leases;
+        TimingWheel<std::string> wheel{EXPIRY_TICK_NANOS};
+    };
+
+    static constexpr int SHARD_BITS = 6;
+
+    std::unique_ptr<Shard[]> shards;
+    Clock *clock;
+    std::atomic<uint64_t> decisions{0}, leaseRequests{0}, returns{0};
+    std::chrono::nanoseconds sweepInterval;
+    std::mutex sweepMutex;
+    std::condition_variable wake;
+    bool running = true;
+    std::thread sweeper;
+
+    Shard &shardFor(const std::string &userId)
+    {
+        uint64_t h = std::hash<std::string>{}(userId);
+        return shards[(h * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS)];
+    }
+
+    static void send(Shard &shard, uint8_t op, const std::string &userId, UserType type, uint32_t tokens,
+                     LeaseReply *reply)
+    {
+        if (userId.size() > UINT16_MAX)
+            throw std::invalid_argument("Key too long for a lease request");
+        LeaseRequest request{op, static_cast<uint8_t>(type), static_cast<uint16_t>(userId.size()), tokens};
+        std::string message(reinterpret_cast<const char *>(&request), sizeof(request));
+        message += userId;
+        if (!lease_io::writeAll(shard.fd, message.data(), message.size()) ||
+            (reply && !lease_io::readAll(shard.fd, reply, sizeof(*reply))))
+            throw std::runtime_error("Quota server connection lost");
+    }
+
+    // Hands back what is left of an expired lease and sizes the next one
+    // from the rate the last one was spent at.
+    void retire(Shard &shard, const std::string &userId, Lease &lease, int64_t now)
+    {
+        if (lease.tokens > lease.used)
+        {
+            send(shard, LeaseRequest::RETURN, userId, lease.type, lease.tokens - lease.used, nullptr);
+            returns.fetch_add(1, std::memory_order_relaxed);
+        }
+        double seconds = std::max<double>(now - lease.start, 1) / 1e9;
+        double ttl = std::max<double>(lease.expiry - lease.start, 1) / 1e9;
+        double wanted = std::ceil(lease.used / seconds * ttl);
+        lease.nextRequest = static_cast<uint32_t>(std::clamp<double>(wanted, MIN_LEASE, MAX_LEASE));
+        lease.tokens = lease.used = 0;
+    }
+
+    // Wheel callback: retires the lease if it is still the one scheduled and
+    // has run out its time; a lease renewed since moves to its new expiry.
+    int64_t onExpire(Shard &shard, const std::string &userId, uint64_t tick, int64_t now)
+    {
+        auto it = shard.leases.find(userId);
+        if (it == shard.leases.end() || it->second.wheelDeadline != tick)
+            return 0;
+        Lease &lease = it->second;
+        if (lease.tokens && now < lease.expiry)
+        {
+            lease.wheelDeadline = shard.wheel.toTick(lease.expiry);
+            return lease.expiry;
+        }
+        lease.wheelDeadline = 0;
+        if (lease.tokens)
+            retire(shard, userId, lease, now);
+        return 0;
+    }
+
+    void expire(Shard &shard, int64_t now)
+    {
+        shard.wheel.advance(now, [&](const std::string &userId, uint64_t tick)
+                            { return onExpire(shard, userId, tick, now); });
+    }
+
+    void watch(Shard &shard, const std::string &userId, Lease &lease)
+    {
+        if (lease.wheelDeadline)
+            return;
+        lease.wheelDeadline = shard.wheel.toTick(lease.expiry);
+        shard.wheel.schedule(userId, lease.expiry);
+    }
+
+    void closeAll()
+    {
+        for (int i = 0; i < (1 << SHARD_BITS); i++)
+            if (shards[i].fd >= 0)
+                ::close(shards[i].fd);
+    }
+
+public:
+    explicit LeasedRateLimiterService(const std::string &serverPath, Clock &clock = systemClock(),
+                                      std::chrono::nanoseconds sweepInterval = std::chrono::milliseconds(10))
+        : shards(std::make_unique<Shard[]>(1 << SHARD_BITS)), clock(&clock), sweepInterval(sweepInterval)
+    {
+        sockaddr_un addr = lease_io::address(serverPath);
+        for (int i = 0; i < (1 << SHARD_BITS); i++)
+        {
+            int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+            {
+                if (fd >= 0)
+                    ::close(fd);
+                closeAll();
+                throw std::runtime_error("Cannot connect to quota server at " + serverPath);
+            }
+            shards[i].fd = fd;
+        }
+        if (sweepInterval.count() > 0)
+        {
+            sweeper = std::thread([this]
+            {
+                std::unique_lock<std::mutex> lock(sweepMutex);
+                while (!wake.wait_for(lock, this->sweepInterval, [this] { return !running; }))
+                {
+                    lock.unlock();
+                    try
+                    {
+                        returnExpired();
+                    }
+                    catch (const std::exception &)
+                    {
+                        // The connection is gone; requests will report it.
+                        return;
+                    }
+                    lock.lock();
+                }
+            });
+        }
+    }
+
+    LeasedRateLimiterService(const LeasedRateLimiterService &) = delete;
+    LeasedRateLimiterService &operator=(const LeasedRateLimiterService &) = delete;
+
+    ~LeasedRateLimiterService()
+    {
+        if (sweeper.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(sweepMutex);
+                running = false;
+            }
+            wake.notify_one();
+            sweeper.join();
+        }
+        try
+        {
+            releaseAll();
+        }
+        catch (const std::exception &)
+        {
+        }
+        closeAll();
+    }
+
+    bool handleRequest(const std::string &userId, UserType type)
+    {
+        decisions.fetch_add(1, std::memory_order_relaxed);
+        Shard &shard = shardFor(userId);
+        int64_t now = clock->nowNanos();
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        expire(shard, now);
+        Lease &lease = shard.leases[userId];
+
+        if (lease.type != type)
+        {
+            retire(shard, userId, lease, now);
+            lease.type = type;
+            lease.nextRequest = MIN_LEASE;
+            lease.expiry = 0;
+        }
+        if (now < lease.expiry)
+        {
+            if (lease.used < lease.tokens)
+            {
+                lease.used++;
+                return true;
+            }
+            // An empty grant: the server has nothing before expiry.
+            if (lease.tokens == 0)
+                return false;
+        }
+        if (lease.tokens)
+            retire(shard, userId, lease, now);
+
+        LeaseReply reply;
+        send(shard, LeaseRequest::LEASE, userId, type, lease.nextRequest, &reply);
+        leaseRequests.fetch_add(1, std::memory_order_relaxed);
+        lease.tokens = reply.granted;
+        lease.used = 0;
+        lease.start = now;
+        lease.expiry = now + reply.ttlNanos;
+        if (reply.granted == 0)
+            return false;
+        watch(shard, userId, lease);
+        lease.used = 1;
+        return true;
+    }
+
+    bool handleRequest(const User &user)
+    {
+        return handleRequest(user.userId, user.type);
+    }
+
+    // Returns the leftovers of every lease that has expired by now. The
+    // sweeper thread calls this; call it directly when it is disabled.
+    void returnExpired()
+    {
+        int64_t now = clock->nowNanos();
+        for (int i = 0; i < (1 << SHARD_BITS); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            expire(shards[i], now);
+        }
+    }
+
+    // Returns every unspent token, e.g. before the node shuts down.
+    void releaseAll()
+    {
+        int64_t now = clock->nowNanos();
+        for (int i = 0; i < (1 << SHARD_BITS); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            for (auto &[userId, lease] : shards[i].leases)
+                retire(shards[i], userId, lease, now);
+        }
+    }
+
+    Stats getStats() const
+    {
+        return Stats{decisions.load(), leaseRequests.load(), returns.load()};
+    }
+};
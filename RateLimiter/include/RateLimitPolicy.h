@@ -0,0 +1,79 @@
+#pragma once
+#include "RateLimiter.h"
+#include <stdexcept>
+#include <string>
+
+enum class UserType {
+    FREE,
+    PREMIUM_1,
+    PREMIUM_2,
+    PREMIUM_3
+};
+
+struct User {
+    std::string userId;
+    UserType type;
+};
+
+//---------------------Rate limit policy class ----------------------
+// The tier table is constexpr so StaticLimiter can build a fully inlined
+// limiter per tier at compile time; getConfig stays the runtime entry point.
+constexpr RateLimitConfig TIER_CONFIGS[] = {
+    {5, 10, AlgorithmType::COUNTER},                  // FREE
+    {20, 30, AlgorithmType::SLIDING_WINDOW_COUNTER},  // PREMIUM_1
+    {50, 60, AlgorithmType::TOKEN_BUCKET},            // PREMIUM_2
+    {100, 60, AlgorithmType::TOKEN_BUCKET},           // PREMIUM_3
+};
+
+constexpr int TIER_COUNT = sizeof(TIER_CONFIGS) / sizeof(TIER_CONFIGS[0]);
+
+// Caps on the combined traffic of each tier and of the whole service,
+// enforced by HierarchicalRateLimiter on top of the per-user limits above.
+// Aggregates refill like a token bucket; a timeWindow of 0 means no cap.
+struct AggregateLimit {
+    int maxRequests;
+    TimeWindow timeWindow;
+};
+
+constexpr AggregateLimit TIER_AGGREGATE_LIMITS[] = {
+    {20000, 10},   // FREE
+    {20000, 30},   // PREMIUM_1
+    {30000, 60},   // PREMIUM_2
+    {30000, 60},   // PREMIUM_3
+};
+
+constexpr AggregateLimit GLOBAL_LIMIT = {50000, 10};
+
+static_assert(sizeof(TIER_AGGREGATE_LIMITS) / sizeof(TIER_AGGREGATE_LIMITS[0]) == TIER_COUNT,
+              "Every tier needs an aggregate limit");
+
+// How tiers share backend capacity once AdmissionScheduler has to queue:
+// weight is the tier's share under deficit round robin; a request waits
+// behind at most maxQueue others of its tier and for at most maxWait before
+// it is shed. FREE has the smallest share and the shortest wait, so it is
+// shed first.
+struct TierSchedule {
+    uint32_t weight;
+    size_t maxQueue;
+    TimeWindow maxWait;
+};
+
+constexpr TierSchedule TIER_SCHEDULE[] = {
+    {1, 1000, std::chrono::milliseconds(20)},    // FREE
+    {2, 2000, std::chrono::milliseconds(100)},   // PREMIUM_1
+    {4, 4000, std::chrono::milliseconds(100)},   // PREMIUM_2
+    {8, 4000, std::chrono::milliseconds(100)},   // PREMIUM_3
+};
+
+static_assert(sizeof(TIER_SCHEDULE) / sizeof(TIER_SCHEDULE[0]) == TIER_COUNT,
+              "Every tier needs a schedule");
+
+class RateLimitPolicy {
+public:
+    static constexpr RateLimitConfig getConfig(UserType type) {
+        int tier = static_cast<int>(type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+        return TIER_CONFIGS[tier];
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------- Acquire Result ----------------
+// Outcome of charging `cost` units to a key. remaining is the whole units
+// still available right after the decision. retryAfterNanos is 0 when the
+// request was allowed; otherwise it is the exact wait (absent other traffic
+// on the key) until the same cost would be accepted, or NEVER when it
+// cannot be, because cost exceeds what the limit can ever hold.
+struct AcquireResult
+{
+    static constexpr int64_t NEVER = INT64_MAX;
+
+    bool allowed = false;
+    int64_t remaining = 0;
+    int64_t retryAfterNanos = 0;
+};
+
+// ---------------- Interface ----------------
+// A limiter instance is not synchronized on its own; RateLimiterService
+// serializes access to each limiter through the shard that owns its key.
+class RateLimiter
+{
+public:
+    virtual bool allowRequest(const std::string &userId) = 0;
+
+    // Charges cost units at once; a rejected request charges nothing.
+    virtual AcquireResult tryAcquire(const std::string &userId, uint32_t cost) = 0;
+
+    // Reports that a request admitted for userId finished after
+    // latencyNanos. Rate limiters ignore it; AdaptiveConcurrencyLimiter
+    // frees the request's slot and adapts its limit from the latency.
+    virtual void onComplete(const std::string &, int64_t) {}
+
+    // One decision per key, identical to calling allowRequest on each in
+    // order. Limiters with a cheaper batch path override it.
+    virtual std::vector<bool> allowRequests(const std::vector<std::string> &userIds)
+    {
+        std::vector<bool> allowed(userIds.size());
+        for (size_t i = 0; i < userIds.size(); i++)
+            allowed[i] = allowRequest(userIds[i]);
+        return allowed;
+    }
+
+    virtual ~RateLimiter() = default;
+};
+
+// ---------------- Config ----------------
+enum class AlgorithmType
+{
+    COUNTER,
+    SLIDING_WINDOW,
+    TOKEN_BUCKET,
+    LEAKY_BUCKET,
+    ATOMIC_TOKEN_BUCKET,
+    SLIDING_WINDOW_COUNTER,
+    SLOPPY_COUNTER
+};
+
+constexpr int ALGORITHM_COUNT = static_cast<int>(AlgorithmType::SLOPPY_COUNTER) + 1;
+
+// ---------------- Time Window ----------------
+// Length of a limit's window, in nanoseconds. A plain integer is a number
+// of seconds, so tables like {5, 10, AlgorithmType::COUNTER} keep their
+// meaning; a std::chrono duration gives any other length, e.g.
+// {20, std::chrono::milliseconds(100), AlgorithmType::TOKEN_BUCKET}.
+struct TimeWindow
+{
+    int64_t nanos = 0;
+
+    constexpr TimeWindow(int64_t seconds = 0) : nanos(seconds * 1000000000) {}
+
+    template <typename Rep, typename Period>
+    constexpr TimeWindow(std::chrono::duration<Rep, Period> length)
+        : nanos(std::chrono::duration_cast<std::chrono::nanoseconds>(length).count()) {}
+
+    static constexpr TimeWindow fromNanos(int64_t nanos) { return TimeWindow(std::chrono::nanoseconds(nanos)); }
+
+    constexpr double seconds() const { return nanos / 1e9; }
+
+    friend constexpr bool operator==(TimeWindow a, TimeWindow b) { return a.nanos == b.nanos; }
+    friend constexpr bool operator!=(TimeWindow a, TimeWindow b) { return a.nanos != b.nanos; }
+};
+
+// maxOverAdmission applies to SLOPPY_COUNTER only: the most it may admit
+// beyond (or hold back from) maxRequests per window, in requests. 0 picks
+// maxRequests / 16.
+struct RateLimitConfig
+{
+    int maxRequests;
+    TimeWindow timeWindow;
+    AlgorithmType algorithm;
+    int64_t maxOverAdmission = 0;
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include "RateLimiter.h"
+#include "CounterRateLimiter.h"
+#include "SlidingWindowRateLimiter.h"
+#include "SlidingWindowCounterRateLimiter.h"
+#include "TokenBucketRateLimiter.h"
+#include "AtomicTokenBucketRateLimiter.h"
+#include "SloppyCounterRateLimiter.h"
+#include "LeakyBucketRateLimiter.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// ---------------- Factory ----------------
+class RateLimiterFactory
+{
+public:
+    static std::unique_ptr<RateLimiter>
+    createLimiter(const RateLimitConfig &config, Clock &clock = systemClock())
+    {
+        switch (config.algorithm)
+        {
+        case AlgorithmType::COUNTER:
+            return std::make_unique<CounterRateLimiter>(
+                config.maxRequests, config.timeWindow, clock);
+        case AlgorithmType::SLIDING_WINDOW:
+            return std::make_unique<SlidingWindowRateLimiter>(
+                config.maxRequests,
+                config.timeWindow, clock);
+        case AlgorithmType::SLIDING_WINDOW_COUNTER:
+            return std::make_unique<SlidingWindowCounterRateLimiter>(
+                config.maxRequests,
+                config.timeWindow, clock);
+        case AlgorithmType::TOKEN_BUCKET:
+            return std::make_unique<TokenBucketRateLimiter>(
+                config.maxRequests,
+                config.timeWindow, clock);
+        case AlgorithmType::LEAKY_BUCKET:
+            return std::make_unique<LeakyBucketRateLimiter>(
+                config.maxRequests,
+                config.timeWindow, 1, clock);
+        case AlgorithmType::ATOMIC_TOKEN_BUCKET:
+            return std::make_unique<AtomicTokenBucketRateLimiter>(
+                config.maxRequests,
+                config.timeWindow, clock);
+        case AlgorithmType::SLOPPY_COUNTER:
+            return std::make_unique<SloppyCounterRateLimiter>(
+                config.maxRequests,
+                config.timeWindow, config.maxOverAdmission, clock);
+        default:
+            throw std::invalid_argument("Unsupported algorithm");
+        }
+    }
+
+    // Units a limiter would still admit for key right now; a zero-cost
+    // tryAcquire charges nothing on every algorithm.
+    static int64_t headroom(RateLimiter &limiter, const std::string &key)
+    {
+        return limiter.tryAcquire(key, 0).remaining;
+    }
+
+    // Used quota a migration could not charge to the new limiter because
+    // it exceeded that limiter's headroom (a downgrade), kept so the next
+    // migration still counts it. It lapses once the window it was used in
+    // would have refilled it.
+    struct CarriedUsage
+    {
+        int64_t units = 0;
+        int64_t untilNanos = 0;
+    };
+
+    // Replaces key's limiter with one for `to`, carrying over the quota the
+    // key has used: the units missing from the old limiter's headroom
+    // (against a fresh one for `from`), plus any still-live carried usage,
+    // are charged to the new limiter at once, capped at its own headroom;
+    // the rest stays in `carried`. Moving to another tier and back therefore
+    // never hands out a fresh allowance. The charge refills on the new
+    // limiter's schedule from now.
+    static std::unique_ptr<RateLimiter> migrate(RateLimiter &old, const RateLimitConfig &from,
+                                                const RateLimitConfig &to, const std::string &key,
+                                                CarriedUsage &carried, Clock &clock = systemClock())
+    {
+        int64_t oldHeadroom = headroom(old, key);
+        std::unique_ptr<RateLimiter> next = createLimiter(to, clock);
+        carryUsage(oldHeadroom, from, headroom(*next, key), key, carried, clock,
+                   [&](uint32_t units) { next->tryAcquire(key, units); });
+        return next;
+    }
+
+    // migrate's accounting, for owners that keep a key's state in something
+    // other than a RateLimiter: oldHeadroom and newHeadroom are the old and
+    // new state's headroom for key, and charge(units) takes units from the
+    // new state.
+    template <typename Charge>
+    static void carryUsage(int64_t oldHeadroom, const RateLimitConfig &from, int64_t newHeadroom,
+                           const std::string &key, CarriedUsage &carried, Clock &clock, Charge charge)
+    {
+        int64_t now = clock.nowNanos();
+        int64_t used = std::max<int64_t>(headroom(*createLimiter(from, clock), key) - oldHeadroom, 0);
+        if (now < carried.untilNanos)
+            used += carried.units;
+        else
+            carried.untilNanos = 0;
+        int64_t charged = std::min(used, newHeadroom);
+        if (charged > 0)
+            charge(static_cast<uint32_t>(charged));
+        carried.units = used - charged;
+        carried.untilNanos = std::max(carried.untilNanos, now + from.timeWindow.nanos);
+    }
+};
@@ -0,0 +1,603 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimiterFactory.h"
+#include "RateLimitPolicy.h"
+#include "PolicyStore.h"
+#include "Metrics.h"
+#include "HeavyHitterFilter.h"
+#include "TimingWheel.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ---------------- Eviction ----------------
+// Idle keys (no request for idleTtlNanos) are dropped by a per-shard timing
+// wheel that is advanced from the request path, so expiry is amortized O(1)
+// per request and never scans a shard. maxTrackedKeys caps live limiters; on
+// overflow the keys nearest to idle expiry are evicted first. Configs added
+// with addConfig survive eviction (only the limiter state is dropped), while
+// configs derived from RateLimitPolicy are dropped with the limiter.
+// EvictionPolicy and EvictionStats live in TimingWheel.h.
+
+// ---------------- Service ----------------
+// Per-user state is partitioned across a power-of-two number of shards.
+// Each shard owns its own maps and mutex, so requests for users that land in
+// different shards never contend. A service built with one shard behaves like
+// the old single-map service wrapped in one global lock.
+//
+// Users whose config comes from the tier policy follow it live: a request
+// passing a different UserType, or the first request after the PolicyStore
+// is reloaded, moves the user to the new config with
+// RateLimiterFactory::migrate, so quota already used carries over instead
+// of being reset. Checking costs one atomic load while neither changes.
+//
+// With a PrefilterPolicy budget, policy users without state go through a
+// HeavyHitterFilter first and only get a config and limiter once they are
+// heavy hitters; keys with no config at all are rejected statelessly.
+class RateLimiterService
+{
+private:
+    struct LimiterEntry
+    {
+        // The key's limiter, or for ATOMIC_TOKEN_BUCKET none: the bucket is
+        // the bare packed word below, charged under the shard lock.
+        std::unique_ptr<RateLimiter> limiter;
+        uint64_t bucket = 0;
+        TokenBucketParams bucketParams;
+        int64_t lastSeen = 0;
+        uint64_t wheelDeadline = 0;
+        bool configFromPolicy = false;
+        int tier = -1;              // UserType the config came from, if known
+        uint64_t policyVersion = 0; // PolicyStore version last checked against
+        RateLimiterFactory::CarriedUsage carried;
+        AlgorithmType algorithm = AlgorithmType::COUNTER;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, RateLimitConfig> configs;
+        std::unordered_map<std::string, LimiterEntry> limiters;
+        TimingWheel<std::string> wheel{1000000000};
+        uint64_t expired = 0;
+        uint64_t evictedForCapacity = 0;
+        ShardMetrics metrics;
+        std::unique_ptr<HeavyHitterFilter> prefilter;
+    };
+
+    // Reschedule attempts before a capacity eviction takes the next key
+    // regardless of how recently it was used.
+    static constexpr int CAPACITY_PROBES = 8;
+
+    // Users changed per shard lock acquisition by changeTiers.
+    static constexpr size_t TIER_CHANGE_CHUNK = 256;
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shardCount;
+    int shardBits;
+    EvictionPolicy eviction;
+    Clock *clock;
+    PolicyStore *policies;
+    size_t maxKeysPerShard = 0;
+
+    // Computed once per request: it picks the shard, feeds the pre-filter
+    // and identifies the key in the metrics' top-rejected list.
+    static uint64_t keyHash(const std::string &userId)
+    {
+        return std::hash<std::string>{}(userId);
+    }
+
+    size_t shardIndex(uint64_t hash) const
+    {
+        // Fibonacci hashing on the top bits keeps the shard index independent
+        // of the low bits the shard's own unordered_map buckets on.
+        if (shardBits == 0)
+            return 0;
+        return (hash * 0x9E3779B97F4A7C15ull) >> (64 - shardBits);
+    }
+
+    Shard &shardFor(const std::string &userId)
+    {
+        return shards[shardIndex(keyHash(userId))];
+    }
+
+    void evict(Shard &shard, std::unordered_map<std::string, LimiterEntry>::iterator it)
+    {
+        if (it->second.configFromPolicy)
+            shard.configs.erase(it->first);
+        shard.limiters.erase(it);
+    }
+
+    // Wheel callback. Stale entries (key gone, or rescheduled since) are
+    // dropped; keys used since they were scheduled move to their new idle
+    // deadline unless `force` is set.
+    int64_t onExpire(Shard &shard, const std::string &userId, uint64_t tick, bool force,
+                     uint64_t &counter)
+    {
+        auto it = shard.limiters.find(userId);
+        if (it == shard.limiters.end() || it->second.wheelDeadline != tick)
+            return 0;
+        int64_t deadline = it->second.lastSeen + eviction.idleTtlNanos;
+        uint64_t deadlineTick = shard.wheel.toTick(deadline);
+        if (!force && deadlineTick > tick)
+        {
+            it->second.wheelDeadline = deadlineTick;
+            return deadline;
+        }
+        evict(shard, it);
+        counter++;
+        return 0;
+    }
+
+    void expireIdle(Shard &shard, int64_t now)
+    {
+        shard.wheel.advance(now, [&](const std::string &userId, uint64_t tick)
+                            { return onExpire(shard, userId, tick, false, shard.expired); });
+    }
+
+    // Makes room for one more key.
+    void enforceCeiling(Shard &shard)
+    {
+        int probes = 0;
+        while (shard.limiters.size() >= maxKeysPerShard)
+        {
+            bool force = ++probes > CAPACITY_PROBES;
+            if (!shard.wheel.expireEarliest([&](const std::string &userId, uint64_t tick)
+                                            { return onExpire(shard, userId, tick, force,
+                                                              shard.evictedForCapacity); }))
+                break;
+        }
+    }
+
+    // Gives entry fresh state for config. A service key never shares its
+    // limiter, so ATOMIC_TOKEN_BUCKET keeps one AtomicTokenBucket word in the
+    // entry instead of a keyed AtomicTokenBucketRateLimiter.
+    void install(LimiterEntry &entry, const RateLimitConfig &config)
+    {
+        entry.algorithm = config.algorithm;
+        if (config.algorithm != AlgorithmType::ATOMIC_TOKEN_BUCKET)
+        {
+            entry.limiter = RateLimiterFactory::createLimiter(config, *clock);
+            return;
+        }
+        entry.bucketParams = TokenBucketParams(config.maxRequests, config.timeWindow.nanos);
+        entry.bucket = AtomicTokenBucket::initial(entry.bucketParams, AtomicTokenBucket::toTick(clock->nowNanos()));
+        entry.limiter.reset();
+    }
+
+    AcquireResult acquire(LimiterEntry &entry, const std::string &userId, uint32_t cost)
+    {
+        if (entry.limiter)
+            return entry.limiter->tryAcquire(userId, cost);
+        return AtomicTokenBucket::tryAcquire(entry.bucket, clock->nowNanos(), entry.bucketParams,
+                                             static_cast<uint64_t>(cost) << AtomicTokenBucket::FRACTION_BITS);
+    }
+
+    bool allow(LimiterEntry &entry, const std::string &userId)
+    {
+        if (entry.limiter)
+            return entry.limiter->allowRequest(userId);
+        return AtomicTokenBucket::tryConsume(entry.bucket, AtomicTokenBucket::toTick(clock->nowNanos()),
+                                             entry.bucketParams);
+    }
+
+    LimiterEntry &entryFor(Shard &shard, const std::string &userId, int64_t now,
+                           bool configFromPolicy = false)
+    {
+        auto it = shard.limiters.find(userId);
+        if (it != shard.limiters.end())
+        {
+            it->second.lastSeen = now;
+            return it->second;
+        }
+
+        if (maxKeysPerShard && shard.limiters.size() >= maxKeysPerShard)
+            enforceCeiling(shard);
+
+        LimiterEntry entry;
+        // Unknown users get the value-initialized config (which rejects
+        // everything) without leaving a config entry behind.
+        auto config = shard.configs.find(userId);
+        const RateLimitConfig &initial = config != shard.configs.end() ? config->second : RateLimitConfig{};
+        install(entry, initial);
+        entry.lastSeen = now;
+        entry.configFromPolicy = configFromPolicy;
+        if (eviction.idleTtlNanos > 0)
+        {
+            int64_t deadline = now + eviction.idleTtlNanos;
+            entry.wheelDeadline = shard.wheel.toTick(deadline);
+            shard.wheel.schedule(userId, deadline);
+        }
+        return shard.limiters.emplace(userId, std::move(entry)).first->second;
+    }
+
+    // With the pre-filter on, a key with neither a config nor state is
+    // rejected (its value-initialized config would reject it anyway)
+    // without allocating anything for it.
+    bool rejectStateless(Shard &shard, const std::string &userId) const
+    {
+        return shard.prefilter && shard.configs.find(userId) == shard.configs.end() &&
+               shard.limiters.find(userId) == shard.limiters.end();
+    }
+
+    // entryFor, moved onto its tier's current policy first if it follows one.
+    LimiterEntry &currentEntry(Shard &shard, const std::string &userId, int64_t now)
+    {
+        LimiterEntry &entry = entryFor(shard, userId, now);
+        if (entry.configFromPolicy && entry.tier >= 0)
+            followPolicy(shard, userId, entry, entry.tier);
+        return entry;
+    }
+
+    // Moves a policy-derived user to tier's current config if it is not
+    // on it already, carrying its used quota over.
+    void followPolicy(Shard &shard, const std::string &userId, LimiterEntry &entry, int tier)
+    {
+        if (entry.tier == tier && entry.policyVersion == policies->version())
+            return;
+        auto policy = policies->read();
+        RateLimitConfig &config = shard.configs[userId];
+        const RateLimitConfig &target = policy->tiers[tier];
+        if (config.maxRequests != target.maxRequests || config.timeWindow != target.timeWindow ||
+            config.algorithm != target.algorithm || config.maxOverAdmission != target.maxOverAdmission)
+        {
+            int64_t oldHeadroom = acquire(entry, userId, 0).remaining;
+            install(entry, target);
+            RateLimiterFactory::carryUsage(oldHeadroom, config, acquire(entry, userId, 0).remaining, userId,
+                                           entry.carried, *clock,
+                                           [&](uint32_t units) { acquire(entry, userId, units); });
+            config = target;
+        }
+        entry.tier = tier;
+        entry.policyVersion = policy->version;
+    }
+
+    // The entry a typed request is decided on, created from the tier policy
+    // when the user has no config. Users without state go through the
+    // pre-filter first; when it admits the request on its sketch this
+    // records the decision and returns nullptr, with `remaining` set to the
+    // quota the sketch estimates is left. The sketch is charged the
+    // request's full cost, so larger requests promote a key sooner.
+    LimiterEntry *typedEntry(Shard &shard, const std::string &userId, uint64_t hash, UserType type,
+                             uint32_t cost, int64_t now, const ShardMetrics::Sample &sample,
+                             int64_t &remaining)
+    {
+        int tier = static_cast<int>(type);
+        bool fromPolicy = false;
+        uint32_t earlier = 0;
+        if (shard.configs.find(userId) == shard.configs.end())
+        {
+            RateLimitConfig config = policies->getConfig(type);
+            uint32_t estimate;
+            if (shard.prefilter)
+            {
+                if (shard.prefilter->admit(hash, config, clock->nowNanos(), cost, estimate))
+                {
+                    shard.metrics.record(tier, config.algorithm, true, userId, hash, sample);
+                    remaining = std::max<int64_t>(0, static_cast<int64_t>(config.maxRequests) - estimate);
+                    return nullptr;
+                }
+                earlier = shard.prefilter->admittedBefore(config, estimate, cost);
+            }
+            shard.configs[userId] = config;
+            fromPolicy = true;
+        }
+        LimiterEntry &entry = entryFor(shard, userId, now, fromPolicy);
+        if (entry.configFromPolicy)
+            followPolicy(shard, userId, entry, tier);
+        if (earlier)
+        {
+            // Promoted by the pre-filter: charge what it already admitted.
+            int64_t charge = std::min<int64_t>(earlier, acquire(entry, userId, 0).remaining);
+            if (charge > 0)
+                acquire(entry, userId, static_cast<uint32_t>(charge));
+        }
+        return &entry;
+    }
+
+    void changeTierLocked(Shard &shard, const std::string &userId, UserType type, int64_t now)
+    {
+        int tier = static_cast<int>(type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+        LimiterEntry &entry = entryFor(shard, userId, now, true);
+        entry.configFromPolicy = true;
+        followPolicy(shard, userId, entry, tier);
+    }
+
+    int64_t requestTime(Shard &shard)
+    {
+        if (eviction.idleTtlNanos <= 0)
+            return 0;
+        int64_t now = clock->nowNanos();
+        expireIdle(shard, now);
+        return now;
+    }
+
+public:
+    static size_t defaultShardCount()
+    {
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        return cores * 4;
+    }
+
+    explicit RateLimiterService(size_t shards = defaultShardCount(),
+                                const EvictionPolicy &eviction = EvictionPolicy(),
+                                Clock &clock = systemClock(),
+                                PolicyStore &policies = PolicyStore::global(),
+                                const PrefilterPolicy &prefilter = PrefilterPolicy())
+        : shardCount(1), shardBits(0), eviction(eviction), clock(&clock), policies(&policies)
+    {
+        if (eviction.maxTrackedKeys && eviction.idleTtlNanos <= 0)
+            throw std::invalid_argument("maxTrackedKeys requires an idle TTL");
+        if (eviction.tickNanos <= 0)
+            throw std::invalid_argument("Eviction tick must be positive");
+        while (shardCount < shards)
+        {
+            shardCount <<= 1;
+            shardBits++;
+        }
+        this->shards = std::make_unique<Shard[]>(shardCount);
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            this->shards[i].wheel = TimingWheel<std::string>(eviction.tickNanos);
+            if (prefilter.sketchBytes)
+                this->shards[i].prefilter =
+                    std::make_unique<HeavyHitterFilter>(prefilter.sketchBytes / shardCount, prefilter);
+        }
+        if (eviction.maxTrackedKeys)
+            maxKeysPerShard = std::max<size_t>(1, eviction.maxTrackedKeys / shardCount);
+    }
+
+    size_t getShardCount() const { return shardCount; }
+
+    void addConfig(const std::string &userId, const RateLimitConfig &config)
+    {
+        Shard &shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.configs[userId] = config;
+        auto it = shard.limiters.find(userId);
+        if (it != shard.limiters.end())
+            it->second.configFromPolicy = false;
+    }
+
+    bool handleRequest(const std::string &userId)
+    {
+        uint64_t hash = keyHash(userId);
+        Shard &shard = shards[shardIndex(hash)];
+        ShardMetrics::Sample sample;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        int64_t now = requestTime(shard);
+        if (rejectStateless(shard, userId))
+        {
+            shard.metrics.record(-1, AlgorithmType::COUNTER, false, userId, hash, sample);
+            return false;
+        }
+        LimiterEntry &entry = currentEntry(shard, userId, now);
+        bool allowed = allow(entry, userId);
+        shard.metrics.record(entry.tier, entry.algorithm, allowed, userId, hash, sample);
+        return allowed;
+    }
+
+    // handleRequest for `cost` units, with remaining quota and retry-after
+    // from the user's limiter.
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost)
+    {
+        uint64_t hash = keyHash(userId);
+        Shard &shard = shards[shardIndex(hash)];
+        ShardMetrics::Sample sample;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        int64_t now = requestTime(shard);
+        if (rejectStateless(shard, userId))
+        {
+            shard.metrics.record(-1, AlgorithmType::COUNTER, false, userId, hash, sample);
+            return AcquireResult{false, 0, AcquireResult::NEVER};
+        }
+        LimiterEntry &entry = currentEntry(shard, userId, now);
+        AcquireResult result = acquire(entry, userId, cost);
+        shard.metrics.record(entry.tier, entry.algorithm, result.allowed, userId, hash, sample);
+        return result;
+    }
+
+    bool handleRequest(const User &user)
+    {
+        return handleRequest(user.userId, user.type);
+    }
+
+    // Same as handleRequest(User) without building a User per request.
+    bool handleRequest(const std::string &userId, UserType type)
+    {
+        uint64_t hash = keyHash(userId);
+        Shard &shard = shards[shardIndex(hash)];
+        ShardMetrics::Sample sample;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        int64_t remaining;
+        LimiterEntry *entry = typedEntry(shard, userId, hash, type, 1, requestTime(shard), sample, remaining);
+        if (!entry)
+            return true;
+        bool allowed = allow(*entry, userId);
+        shard.metrics.record(entry->tier, entry->algorithm, allowed, userId, hash, sample);
+        return allowed;
+    }
+
+    // handleRequest(userId, type) for `cost` units, with remaining quota and
+    // retry-after. Requests admitted by the pre-filter report the quota the
+    // sketch estimates is left.
+    AcquireResult tryAcquire(const std::string &userId, UserType type, uint32_t cost)
+    {
+        uint64_t hash = keyHash(userId);
+        Shard &shard = shards[shardIndex(hash)];
+        ShardMetrics::Sample sample;
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        int64_t remaining;
+        LimiterEntry *entry = typedEntry(shard, userId, hash, type, cost, requestTime(shard), sample, remaining);
+        if (!entry)
+            return AcquireResult{true, remaining, 0};
+        AcquireResult result = acquire(*entry, userId, cost);
+        shard.metrics.record(entry->tier, entry->algorithm, result.allowed, userId, hash, sample);
+        return result;
+    }
+
+    // Batch form of handleRequest(string): same per-key results as calling
+    // it on each id in order, but each shard is locked once per batch.
+    std::vector<bool> handleRequests(const std::vector<std::string> &userIds)
+    {
+        std::vector<uint64_t> hashes(userIds.size());
+        std::vector<uint32_t> shardOf(userIds.size());
+        std::vector<uint32_t> start(shardCount + 1, 0);
+        for (size_t i = 0; i < userIds.size(); i++)
+        {
+            hashes[i] = keyHash(userIds[i]);
+            shardOf[i] = static_cast<uint32_t>(shardIndex(hashes[i]));
+            start[shardOf[i] + 1]++;
+        }
+        for (size_t s = 0; s < shardCount; s++)
+            start[s + 1] += start[s];
+
+        std::vector<uint32_t> order(userIds.size());
+        std::vector<uint32_t> cursor(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < userIds.size(); i++)
+            order[cursor[shardOf[i]]++] = static_cast<uint32_t>(i);
+
+        std::vector<bool> allowed(userIds.size());
+        ShardMetrics::Sample batchSample = ShardMetrics::Sample::untimed();
+        for (size_t s = 0; s < shardCount; s++)
+        {
+            if (start[s] == start[s + 1])
+                continue;
+            std::lock_guard<std::mutex> lock(shards[s].mutex);
+            int64_t now = requestTime(shards[s]);
+            for (uint32_t j = start[s]; j < start[s + 1]; j++)
+            {
+                const std::string &userId = userIds[order[j]];
+                if (rejectStateless(shards[s], userId))
+                {
+                    allowed[order[j]] = false;
+                    shards[s].metrics.record(-1, AlgorithmType::COUNTER, false, userId, hashes[order[j]],
+                                             batchSample);
+                    continue;
+                }
+                LimiterEntry &entry = currentEntry(shards[s], userId, now);
+                allowed[order[j]] = allow(entry, userId);
+                shards[s].metrics.record(entry.tier, entry.algorithm, allowed[order[j]], userId,
+                                         hashes[order[j]], batchSample);
+            }
+        }
+        return allowed;
+    }
+
+    // Moves userId to the policy config of `type` now, keeping the quota it
+    // has used (unlike resetLimiter). Users added with addConfig become
+    // policy users.
+    void changeTier(const std::string &userId, UserType type)
+    {
+        Shard &shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        changeTierLocked(shard, userId, type, requestTime(shard));
+    }
+
+    // changeTier for many users, grouped by shard. Each shard lock is held
+    // for at most TIER_CHANGE_CHUNK users at a time, so request threads
+    // wait for one chunk, not for the whole batch.
+    void changeTiers(const std::vector<User> &users)
+    {
+        std::vector<std::vector<uint32_t>> byShard(shardCount);
+        for (size_t i = 0; i < users.size(); i++)
+            byShard[shardIndex(keyHash(users[i].userId))].push_back(static_cast<uint32_t>(i));
+        for (size_t s = 0; s < shardCount; s++)
+        {
+            const std::vector<uint32_t> &members = byShard[s];
+            for (size_t begin = 0; begin < members.size(); begin += TIER_CHANGE_CHUNK)
+            {
+                size_t end = std::min(members.size(), begin + TIER_CHANGE_CHUNK);
+                std::lock_guard<std::mutex> lock(shards[s].mutex);
+                int64_t now = requestTime(shards[s]);
+                for (size_t j = begin; j < end; j++)
+                    changeTierLocked(shards[s], users[members[j]].userId, users[members[j]].type, now);
+            }
+        }
+    }
+
+    void resetLimiter(const std::string &userId)
+    {
+        Shard &shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.configs.erase(userId);
+        shard.limiters.erase(userId);
+    }
+
+    // Runs idle expiry on every shard now, for callers whose traffic is too
+    // sparse to advance the wheels from the request path.
+    void expireIdleKeys()
+    {
+        if (eviction.idleTtlNanos <= 0)
+            return;
+        int64_t now = clock->nowNanos();
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            expireIdle(shards[i], now);
+        }
+    }
+
+    // Decision counts, sampled latency, table gauges and the most rejected
+    // keys, aggregated over the shards. See MetricsSnapshot::dump for a text
+    // form.
+    MetricsSnapshot getMetrics()
+    {
+        MetricsSnapshot snapshot;
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            const Shard &shard = shards[i];
+            shard.metrics.collect(snapshot);
+            snapshot.trackedKeys += shard.limiters.size();
+            snapshot.configuredKeys += shard.configs.size();
+            // Node-based maps: a node per element (key inline up to the
+            // small-string size, plus the next pointer and cached hash) and
+            // a pointer per bucket.
+            snapshot.approxBytes +=
+                shard.limiters.size() * (sizeof(std::pair<const std::string, LimiterEntry>) + 2 * sizeof(void *)) +
+                shard.limiters.bucket_count() * sizeof(void *) +
+                shard.configs.size() * (sizeof(std::pair<const std::string, RateLimitConfig>) + 2 * sizeof(void *)) +
+                shard.configs.bucket_count() * sizeof(void *);
+        }
+        std::sort(snapshot.topRejected.begin(), snapshot.topRejected.end(),
+                  [](const auto &a, const auto &b) { return a.second > b.second; });
+        if (snapshot.topRejected.size() > ShardMetrics::TOP_KEYS)
+            snapshot.topRejected.resize(ShardMetrics::TOP_KEYS);
+        return snapshot;
+    }
+
+    PrefilterStats getPrefilterStats()
+    {
+        PrefilterStats stats;
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            if (shards[i].prefilter)
+                shards[i].prefilter->collect(stats);
+        }
+        return stats;
+    }
+
+    EvictionStats getEvictionStats()
+    {
+        EvictionStats stats;
+        for (size_t i = 0; i < shardCount; i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            stats.expired += shards[i].expired;
+            stats.evictedForCapacity += shards[i].evictedForCapacity;
+            stats.trackedKeys += shards[i].limiters.size();
+        }
+        return stats;
+    }
+};
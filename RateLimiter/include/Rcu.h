@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// ---------------- RCU ----------------
+// Read-copy-update cell for rarely written, often read data. Readers take a
+// ReadGuard: two atomic increments on a counter slot and a load, never a
+// lock, and they are never blocked by a writer. A writer publishes a new
+// object with update(), then waits for every reader that might still see
+// the old one before deleting it.
+//
+// Reader counts are split by epoch parity across READER_SLOTS cache lines
+// (threads are spread over the slots round-robin). update() flips the
+// epoch and waits only for the old parity to drain; a reader that raced
+// the flip re-checks the epoch and retries on the new parity.
+template <typename T>
+class Rcu
+{
+public:
+    static constexpr size_t READER_SLOTS = 64;
+
+private:
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<uint64_t> count[2] = {{0}, {0}};
+    };
+
+    std::atomic<const T *> current;
+    std::atomic<uint64_t> epoch{0};
+    std::unique_ptr<ReaderSlot[]> slots;
+    std::mutex writerMutex;
+
+    static size_t threadSlot()
+    {
+        static std::atomic<size_t> next{0};
+        thread_local size_t slot = next.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+        return slot;
+    }
+
+public:
+    class ReadGuard
+    {
+    private:
+        std::atomic<uint64_t> *counter;
+        const T *object;
+
+    public:
+        ReadGuard(std::atomic<uint64_t> *counter, const T *object) : counter(counter), object(object) {}
+        ReadGuard(const ReadGuard &) = delete;
+        ReadGuard &operator=(const ReadGuard &) = delete;
+        ~ReadGuard() { counter->fetch_sub(1, std::memory_order_release); }
+
+        const T &operator*() const { return *object; }
+        const T *operator->() const { return object; }
+    };
+
+    explicit Rcu(std::unique_ptr<const T> initial)
+        : current(initial.release()), slots(std::make_unique<ReaderSlot[]>(READER_SLOTS)) {}
+
+    Rcu(const Rcu &) = delete;
+    Rcu &operator=(const Rcu &) = delete;
+
+    // No reader may be active any more.
+    ~Rcu() { delete current.load(); }
+
+    ReadGuard read() const
+    {
+        ReaderSlot &slot = slots[threadSlot()];
+        for (;;)
+        {
+            uint64_t e = epoch.load();
+            std::atomic<uint64_t> &counter = slot.count[e & 1];
+            counter.fetch_add(1);
+            if (epoch.load() == e)
+                return ReadGuard(&counter, current.load());
+            counter.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Publishes next, waits out the readers of the old object and frees it.
+    // Writers are serialized; readers keep running throughout.
+    void update(std::unique_ptr<const T> next)
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        const T *old = current.exchange(next.release());
+        uint64_t e = epoch.fetch_add(1);
+        for (size_t i = 0; i < READER_SLOTS; i++)
+        {
+            while (slots[i].count[e & 1].load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();
+        }
+        delete old;
+    }
+};
@@ -0,0 +1,596 @@
+#pragma once
+#include "RateLimiter.h"
+#include "FlatStateTable.h"
+#include "FlatRateLimiterService.h"
+#include "SlotAlgorithms.h"
+#include "TimingWheel.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// ---------------- Rule Engine ----------------
+// Limits keyed by more than a user id: each LimitRule says which requests it
+// covers (user, endpoint, API key, IPv4 prefix; empty means any) and what
+// one counter covers (keyBy, any combination of the same attributes, none
+// for one counter shared by every matching request). For example:
+//
+//   per IP /24 on /login     endpoint "/login",  keyBy BY_IP, keyPrefixLength 24
+//   per user on /export      endpoint "/export", keyBy BY_USER
+//   per API key everywhere   keyBy BY_API_KEY
+//   per user under /api/     endpoint "/api/*",  keyBy BY_USER | BY_ENDPOINT
+//
+// The rule set is compiled once into a trie with one level per attribute,
+// endpoint, user and API key, each with exact children and an "any" child,
+// ending in a binary trie over the address bits. A lookup follows at most
+// the exact and the any branch per level (plus one branch per path segment
+// for "/prefix/*" endpoints) and walks at most 32 address bits, so its cost
+// depends on the request's attributes, not on how many rules there are.
+//
+// Every matching limit is then decided together: all of them or none are
+// charged. A rule whose keyBy names an attribute the request does not carry
+// (no API key, or no address for BY_IP, say) does not apply to it, nor does
+// a rule with an address prefix to a request without an address. Counters
+// live in sharded FlatStateTables, keyed by the rule and the keyBy values,
+// and use the slot algorithms of FlatRateLimiterService, so SLIDING_WINDOW
+// is rejected.
+//
+// Counters are created per distinct keyBy value, so a BY_IP rule lets a
+// client spraying source addresses create one per address. With an
+// EvictionPolicy, each shard's TimingWheel drops counters idle for
+// idleTtlNanos and for two of their rule's windows (by then a counter
+// decides exactly like a new one, so expiry never changes a decision), and
+// maxTrackedKeys caps them, evicting those nearest to expiry first.
+struct RequestAttributes
+{
+    std::string_view userId;
+    std::string_view endpoint;
+    std::optional<uint32_t> ip; // IPv4, host byte order
+    std::string_view apiKey;
+};
+
+struct LimitRule
+{
+    static constexpr uint8_t BY_USER = 1;
+    static constexpr uint8_t BY_ENDPOINT = 2;
+    static constexpr uint8_t BY_IP = 4;
+    static constexpr uint8_t BY_API_KEY = 8;
+
+    std::string name;
+    std::string userId;
+    std::string endpoint;       // exact, or a prefix ending in "/*"
+    std::string apiKey;
+    uint32_t ipPrefix = 0;
+    int ipPrefixLength = 0;     // 0: any address
+    uint8_t keyBy = BY_USER;
+    int keyPrefixLength = 32;   // with BY_IP, one counter per /keyPrefixLength
+    RateLimitConfig config;
+
+    static uint32_t prefixMask(int length)
+    {
+        return length <= 0 ? 0 : ~uint32_t(0) << (32 - length);
+    }
+
+    // Whether the rule applies to request; the reference the compiled trie
+    // must agree with.
+    bool matches(const RequestAttributes &request) const
+    {
+        if (!userId.empty() && request.userId != userId)
+            return false;
+        if (!apiKey.empty() && request.apiKey != apiKey)
+            return false;
+        if (!endpoint.empty())
+        {
+            std::string_view pattern(endpoint);
+            if (pattern.back() == '*')
+            {
+                pattern.remove_suffix(1);
+                if (request.endpoint.substr(0, pattern.size()) != pattern)
+                    return false;
+            }
+            else if (request.endpoint != pattern)
+                return false;
+        }
+        if (ipPrefixLength > 0 && (!request.ip || ((*request.ip ^ ipPrefix) & prefixMask(ipPrefixLength)) != 0))
+            return false;
+        return carriesKey(request);
+    }
+
+    bool carriesKey(const RequestAttributes &request) const
+    {
+        return !((keyBy & BY_USER) && request.userId.empty()) &&
+               !((keyBy & BY_ENDPOINT) && request.endpoint.empty()) &&
+               !((keyBy & BY_API_KEY) && request.apiKey.empty()) &&
+               !((keyBy & BY_IP) && !request.ip);
+    }
+};
+
+class RuleEngine
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+    struct StringNode
+    {
+        std::unordered_map<std::string_view, uint32_t> exact;
+        std::unordered_map<std::string_view, uint32_t> prefix; // endpoint level only
+        uint32_t any = NONE;
+    };
+
+    struct IpNode
+    {
+        uint32_t child[2] = {NONE, NONE};
+        std::vector<uint32_t> rules;
+    };
+
+    // Trie levels, in this order; the last one's children are IpNode roots.
+    enum Level { ENDPOINT, USER, API_KEY, LEVELS };
+
+    // A counter slot's configIndex is unused (the rule is in its key), so
+    // it holds when the counter was last used, in stamp units mod 2^16.
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        FlatStateTable table;
+        TimingWheel<std::string> wheel{1000000000};
+        uint64_t expired = 0;
+        uint64_t evictedForCapacity = 0;
+    };
+
+    // Reschedule attempts before a capacity eviction takes the next counter
+    // regardless of how recently it was used.
+    static constexpr int CAPACITY_PROBES = 8;
+
+    // One matched limit while a request is being decided.
+    struct Pending
+    {
+        uint32_t rule;
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        uint64_t hash;
+        size_t shard;
+        FlatSlot *slot;
+        SlotState next;
+        bool allowed;
+    };
+
+    struct Scratch
+    {
+        std::vector<uint32_t> nodes, nextNodes;
+        std::vector<uint32_t> matched;
+        std::vector<Pending> pending;
+        std::string keys;
+    };
+
+    std::vector<LimitRule> rules;
+    std::vector<FlatRateLimiterService::CompiledLimit> limits;
+    std::vector<StringNode> levels[LEVELS];
+    std::vector<IpNode> ipNodes;
+    std::unique_ptr<Shard[]> shards;
+    int shardBits;
+    Clock *clock;
+    EvictionPolicy eviction;
+    size_t maxKeysPerShard = 0;
+    int64_t stampNanos = 1;
+    std::vector<int64_t> idleAfter; // per rule: idle time before its counters may go
+
+    static std::string_view attribute(const RequestAttributes &request, int level)
+    {
+        return level == ENDPOINT ? request.endpoint : level == USER ? request.userId : request.apiKey;
+    }
+
+    static const std::string &pattern(const LimitRule &rule, int level)
+    {
+        return level == ENDPOINT ? rule.endpoint : level == USER ? rule.userId : rule.apiKey;
+    }
+
+    uint32_t newChild(int level)
+    {
+        if (level + 1 == LEVELS)
+        {
+            ipNodes.emplace_back();
+            return static_cast<uint32_t>(ipNodes.size() - 1);
+        }
+        levels[level + 1].emplace_back();
+        return static_cast<uint32_t>(levels[level + 1].size() - 1);
+    }
+
+    // Views point into `rules`, which never changes after construction.
+    void insert(uint32_t index)
+    {
+        const LimitRule &rule = rules[index];
+        uint32_t node = 0;
+        for (int level = 0; level < LEVELS; level++)
+        {
+            std::string_view value = pattern(rule, level);
+            uint32_t *child;
+            if (value.empty())
+                child = &levels[level][node].any;
+            else if (level == ENDPOINT && value.back() == '*')
+                child = &levels[level][node].prefix.try_emplace(value.substr(0, value.size() - 1), NONE).first->second;
+            else
+                child = &levels[level][node].exact.try_emplace(value, NONE).first->second;
+            if (*child == NONE)
+                *child = newChild(level); // grows the next level only, so child stays valid
+            node = *child;
+        }
+        for (int bit = 0; bit < rule.ipPrefixLength; bit++)
+        {
+            int side = (rule.ipPrefix >> (31 - bit)) & 1;
+            if (ipNodes[node].child[side] == NONE)
+            {
+                uint32_t created = static_cast<uint32_t>(ipNodes.size());
+                ipNodes.emplace_back();
+                ipNodes[node].child[side] = created;
+            }
+            node = ipNodes[node].child[side];
+        }
+        ipNodes[node].rules.push_back(index);
+    }
+
+    static void validate(const LimitRule &rule)
+    {
+        if (rule.ipPrefixLength < 0 || rule.ipPrefixLength > 32 || rule.keyPrefixLength < 0 ||
+            rule.keyPrefixLength > 32)
+            throw std::invalid_argument("Rule " + rule.name + ": prefix lengths must be 0-32");
+        if ((rule.keyBy & ~(LimitRule::BY_USER | LimitRule::BY_ENDPOINT | LimitRule::BY_IP | LimitRule::BY_API_KEY)) != 0)
+            throw std::invalid_argument("Rule " + rule.name + ": unknown keyBy attribute");
+        const std::string &endpoint = rule.endpoint;
+        size_t star = endpoint.find('*');
+        if (star != std::string::npos &&
+            (star + 1 != endpoint.size() || endpoint.size() < 2 || endpoint[star - 1] != '/'))
+            throw std::invalid_argument("Rule " + rule.name + ": endpoint wildcard must be a trailing /*");
+    }
+
+    // Appends the counter key for rule `index` to out: the rule index, then
+    // each keyBy attribute, length-prefixed so no two keys run together.
+    void appendKey(uint32_t index, const RequestAttributes &request, std::string &out) const
+    {
+        const LimitRule &rule = rules[index];
+        out.append(reinterpret_cast<const char *>(&index), sizeof(index));
+        auto field = [&out](std::string_view value) {
+            uint16_t length = static_cast<uint16_t>(std::min<size_t>(value.size(), UINT16_MAX));
+            out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            out.append(value.data(), length);
+        };
+        if (rule.keyBy & LimitRule::BY_USER)
+            field(request.userId);
+        if (rule.keyBy & LimitRule::BY_ENDPOINT)
+            field(request.endpoint);
+        if (rule.keyBy & LimitRule::BY_API_KEY)
+            field(request.apiKey);
+        if (rule.keyBy & LimitRule::BY_IP)
+        {
+            uint32_t network = *request.ip & LimitRule::prefixMask(rule.keyPrefixLength);
+            out.append(reinterpret_cast<const char *>(&network), sizeof(network));
+        }
+    }
+
+    uint16_t stampOf(int64_t now) const
+    {
+        return static_cast<uint16_t>(now / stampNanos);
+    }
+
+    // Wheel callback: drops the counter if it has been idle long enough (or
+    // `force`), otherwise returns when it will have been.
+    int64_t onExpire(Shard &shard, const std::string &key, int64_t now, bool force, uint64_t &counter)
+    {
+        uint64_t hash = FlatStateTable::hashKey(key);
+        FlatSlot *slot = shard.table.find(key, hash);
+        if (!slot)
+            return 0;
+        uint32_t rule;
+        std::memcpy(&rule, key.data(), sizeof(rule));
+        int64_t idle = static_cast<int64_t>(static_cast<uint16_t>(stampOf(now) - slot->configIndex)) * stampNanos;
+        if (!force && idle < idleAfter[rule])
+            return now - idle + idleAfter[rule];
+        shard.table.erase(key, hash);
+        counter++;
+        return 0;
+    }
+
+    void expireIdle(Shard &shard, int64_t now)
+    {
+        shard.wheel.advance(now, [&](const std::string &key, uint64_t)
+                            { return onExpire(shard, key, now, false, shard.expired); });
+    }
+
+    // Makes room for `incoming` more counters.
+    void enforceCeiling(Shard &shard, size_t incoming, int64_t now)
+    {
+        int probes = 0;
+        while (shard.table.size() + incoming > maxKeysPerShard)
+        {
+            bool force = ++probes > CAPACITY_PROBES;
+            if (!shard.wheel.expireEarliest([&](const std::string &key, uint64_t)
+                                            { return onExpire(shard, key, now, force, shard.evictedForCapacity); }))
+                break;
+        }
+    }
+
+    static Scratch &scratch()
+    {
+        thread_local Scratch buffers;
+        return buffers;
+    }
+
+public:
+    explicit RuleEngine(std::vector<LimitRule> ruleSet,
+                        size_t shards = FlatRateLimiterService::defaultShardCount(),
+                        Clock &clock = systemClock(),
+                        const EvictionPolicy &eviction = EvictionPolicy())
+        : rules(std::move(ruleSet)), shardBits(0), clock(&clock), eviction(eviction)
+    {
+        if (rules.size() >= NONE)
+            throw std::length_error("Too many rules");
+        if (eviction.maxTrackedKeys && eviction.idleTtlNanos <= 0)
+            throw std::invalid_argument("maxTrackedKeys requires an idle TTL");
+        if (eviction.tickNanos <= 0)
+            throw std::invalid_argument("Eviction tick must be positive");
+        levels[ENDPOINT].emplace_back();
+        limits.reserve(rules.size());
+        for (uint32_t i = 0; i < rules.size(); i++)
+        {
+            validate(rules[i]);
+            limits.push_back(FlatRateLimiterService::compile(rules[i].config));
+            insert(i);
+        }
+
+        size_t shardCount = 1;
+        while (shardCount < shards)
+        {
+            shardCount <<= 1;
+            shardBits++;
+        }
+        this->shards = std::make_unique<Shard[]>(shardCount);
+
+        if (eviction.idleTtlNanos > 0)
+        {
+            // Stamps are 16 bits: a unit of 1/4096 of the longest idle time
+            // leaves room for 16 of them before a stamp wraps. One unit is
+            // added back since a stamp difference can overstate idle time.
+            int64_t longest = 0;
+            for (const LimitRule &rule : rules)
+                longest = std::max(longest, std::max(eviction.idleTtlNanos, 2 * rule.config.timeWindow.nanos));
+            stampNanos = std::max(eviction.tickNanos, longest / 4096 + 1);
+            for (const LimitRule &rule : rules)
+                idleAfter.push_back(std::max(eviction.idleTtlNanos, 2 * rule.config.timeWindow.nanos) + stampNanos);
+            for (size_t i = 0; i < shardCount; i++)
+                this->shards[i].wheel = TimingWheel<std::string>(eviction.tickNanos);
+        }
+        if (eviction.maxTrackedKeys)
+            maxKeysPerShard = std::max<size_t>(1, eviction.maxTrackedKeys / shardCount);
+    }
+
+    RuleEngine(const RuleEngine &) = delete;
+    RuleEngine &operator=(const RuleEngine &) = delete;
+
+    size_t ruleCount() const { return rules.size(); }
+    const LimitRule &rule(size_t index) const { return rules[index]; }
+
+    // Indices of the rules that apply to request, ascending.
+    void match(const RequestAttributes &request, std::vector<uint32_t> &matched) const
+    {
+        Scratch &buffers = scratch();
+        std::vector<uint32_t> &nodes = buffers.nodes, &next = buffers.nextNodes;
+        matched.clear();
+        nodes.assign(1, 0);
+        for (int level = 0; level < LEVELS; level++)
+        {
+            std::string_view value = attribute(request, level);
+            next.clear();
+            for (uint32_t index : nodes)
+            {
+                const StringNode &node = levels[level][index];
+                if (node.any != NONE)
+                    next.push_back(node.any);
+                if (value.empty())
+                    continue;
+                auto exact = node.exact.find(value);
+                if (exact != node.exact.end())
+                    next.push_back(exact->second);
+                if (node.prefix.empty())
+                    continue;
+                for (size_t slash = value.find('/'); slash != std::string_view::npos;
+                     slash = value.find('/', slash + 1))
+                {
+                    auto prefix = node.prefix.find(value.substr(0, slash + 1));
+                    if (prefix != node.prefix.end())
+                        next.push_back(prefix->second);
+                }
+            }
+            nodes.swap(next);
+        }
+        for (uint32_t root : nodes)
+        {
+            uint32_t node = root;
+            for (int bit = 0; node != NONE; bit++)
+            {
+                for (uint32_t index : ipNodes[node].rules)
+                {
+                    if (rules[index].carriesKey(request))
+                        matched.push_back(index);
+                }
+                node = bit < 32 && request.ip ? ipNodes[node].child[(*request.ip >> (31 - bit)) & 1] : NONE;
+            }
+        }
+        std::sort(matched.begin(), matched.end());
+    }
+
+    // Decides every matching limit at one instant and charges all of them
+    // only if all admit. remaining is the least any matching limit has left;
+    // a rejection's retryAfterNanos is the longest wait among the limits
+    // that rejected. A request no rule matches is admitted with remaining
+    // NEVER. deniedBy, when given, receives the lowest rejecting rule index
+    // (NONE if admitted).
+    AcquireResult tryAcquire(const RequestAttributes &request, uint32_t cost = 1, uint32_t *deniedBy = nullptr)
+    {
+        Scratch &buffers = scratch();
+        match(request, buffers.matched);
+        if (deniedBy)
+            *deniedBy = NONE;
+        if (buffers.matched.empty())
+            return AcquireResult{true, AcquireResult::NEVER, 0};
+
+        std::vector<Pending> &pending = buffers.pending;
+        std::string &keys = buffers.keys;
+        pending.clear();
+        keys.clear();
+        for (uint32_t index : buffers.matched)
+        {
+            Pending item{};
+            item.rule = index;
+            item.keyOffset = static_cast<uint32_t>(keys.size());
+            appendKey(index, request, keys);
+            item.keyLength = static_cast<uint32_t>(keys.size() - item.keyOffset);
+            pending.push_back(item);
+        }
+        for (Pending &item : pending)
+        {
+            item.hash = FlatStateTable::hashKey(std::string_view(keys).substr(item.keyOffset, item.keyLength));
+            item.shard = shardBits ? item.hash >> (64 - shardBits) : 0;
+        }
+        // Shards are locked in ascending order, so requests sharing several
+        // cannot deadlock.
+        std::stable_sort(pending.begin(), pending.end(),
+                         [](const Pending &a, const Pending &b) { return a.shard < b.shard; });
+
+        struct Locks
+        {
+            Shard *shards;
+            std::vector<Pending> &pending;
+            size_t held = 0;
+            ~Locks()
+            {
+                for (size_t i = held; i-- > 0;)
+                {
+                    if (i == 0 || pending[i].shard != pending[i - 1].shard)
+                        shards[pending[i].shard].mutex.unlock();
+                }
+            }
+        } locks{shards.get(), pending};
+        for (; locks.held < pending.size(); locks.held++)
+        {
+            size_t i = locks.held;
+            if (i == 0 || pending[i].shard != pending[i - 1].shard)
+                shards[pending[i].shard].mutex.lock();
+        }
+
+        // Expiry and the ceiling run first, and room for every new key of a
+        // shard is reserved before the first insert, so no erase or rehash
+        // moves a slot found before it.
+        int64_t now = clock->nowNanos();
+        uint16_t stamp = stampOf(now);
+        for (size_t i = 0, end; i < pending.size(); i = end)
+        {
+            for (end = i + 1; end < pending.size() && pending[end].shard == pending[i].shard; end++)
+                ;
+            Shard &shard = shards[pending[i].shard];
+            FlatStateTable &table = shard.table;
+            if (eviction.idleTtlNanos > 0)
+                expireIdle(shard, now);
+            if (maxKeysPerShard)
+            {
+                size_t incoming = 0;
+                for (size_t j = i; j < end; j++)
+                    incoming += !table.find(std::string_view(keys).substr(pending[j].keyOffset, pending[j].keyLength),
+                                            pending[j].hash);
+                if (incoming)
+                    enforceCeiling(shard, incoming, now);
+            }
+            table.reserve(table.size() + (end - i));
+            for (size_t j = i; j < end; j++)
+            {
+                bool inserted;
+                std::string_view key = std::string_view(keys).substr(pending[j].keyOffset, pending[j].keyLength);
+                pending[j].slot = &table.findOrInsert(key, pending[j].hash, stamp, inserted);
+                pending[j].slot->configIndex = stamp;
+                if (inserted && eviction.idleTtlNanos > 0)
+                    shard.wheel.schedule(std::string(key), now + idleAfter[pending[j].rule]);
+            }
+        }
+
+        AcquireResult result{true, AcquireResult::NEVER, 0};
+        uint32_t firstDenied = NONE;
+        for (Pending &item : pending)
+        {
+            item.next[0] = item.slot->state[0];
+            item.next[1] = item.slot->state[1];
+            AcquireResult one;
+            item.allowed = FlatRateLimiterService::decide(item.next, limits[item.rule], now, cost, &one);
+            result.remaining = std::min(result.remaining, one.remaining);
+            if (!item.allowed)
+            {
+                result.allowed = false;
+                result.retryAfterNanos = std::max(result.retryAfterNanos, one.retryAfterNanos);
+                firstDenied = std::min(firstDenied, item.rule);
+            }
+        }
+
+        // Commit every charge when admitted; otherwise keep only what the
+        // rejecting limits did (a rejection only rolls windows forward).
+        for (const Pending &item : pending)
+        {
+            if (!result.allowed && item.allowed)
+                continue;
+            item.slot->state[0] = item.next[0];
+            item.slot->state[1] = item.next[1];
+        }
+        if (deniedBy)
+            *deniedBy = firstDenied;
+        return result;
+    }
+
+    bool handleRequest(const RequestAttributes &request)
+    {
+        return tryAcquire(request).allowed;
+    }
+
+    // Runs idle expiry on every shard now, for callers whose traffic is too
+    // sparse to advance the wheels from the request path.
+    void expireIdleKeys()
+    {
+        if (eviction.idleTtlNanos <= 0)
+            return;
+        int64_t now = clock->nowNanos();
+        for (size_t i = 0; i < (size_t(1) << shardBits); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            expireIdle(shards[i], now);
+        }
+    }
+
+    EvictionStats getEvictionStats()
+    {
+        EvictionStats stats;
+        for (size_t i = 0; i < (size_t(1) << shardBits); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            stats.expired += shards[i].expired;
+            stats.evictedForCapacity += shards[i].evictedForCapacity;
+            stats.trackedKeys += shards[i].table.size();
+        }
+        return stats;
+    }
+
+    // Counters live now, over all rules.
+    size_t size()
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < (size_t(1) << shardBits); i++)
+        {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            total += shards[i].table.size();
+        }
+        return total;
+    }
+};
@@ -0,0 +1,284 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "AtomicTokenBucketRateLimiter.h"
+#include "FlatStateTable.h"
+#include "Clock.h"
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------- Shared-Memory Table ----------------
+// Per-key limiter state in a POSIX shared-memory segment, so every process
+// on the host that maps it (typically the workers of a pre-fork server)
+// enforces one limit per key instead of one per worker.
+//
+//   SharedTableHeader
+//   SharedSlot[capacity]   open addressing, linear probing
+//
+// A slot is two words: the key's 64-bit hash (0 = empty) and the bitwise
+// complement of a packed AtomicTokenBucket word. A fresh segment is zeroed,
+// so an unset word reads as AtomicTokenBucket::EMPTY (a full bucket), while
+// every real state, a bucket drained at tick 0 included, stores nonzero.
+// A key is claimed with one CAS on the hash and charged with CAS loops on
+// the bucket word, so there are no locks to be left held: a worker killed
+// at any instant has either published its CAS or not, and whatever it left
+// is a valid state for the others. Two consequences:
+//
+//   - keys are identified by their hash alone; two keys with the same
+//     64-bit hash share a bucket (about 3e-6 odds across 10M keys)
+//   - slots are never freed; size the segment for the keys it will see.
+//     An idle key's bucket refills, so a stale slot costs only memory.
+//
+// Every tier is enforced as a continuous token bucket with its
+// maxRequests / timeWindow, whatever its configured algorithm: the other
+// algorithms need more than one word of state per key.
+struct SharedTableHeader
+{
+    static constexpr char MAGIC[8] = {'R', 'L', 'S', 'H', 'M', 'T', 'B', '1'};
+    char magic[8];
+    uint32_t version;
+    std::atomic<uint32_t> ready;   // set last by the creating process
+    uint64_t capacity;             // slots, a power of two
+    std::atomic<uint64_t> count;
+};
+
+struct SharedSlot
+{
+    std::atomic<uint64_t> hash;
+    std::atomic<uint64_t> word;
+};
+
+static_assert(sizeof(SharedTableHeader) == 32 && sizeof(SharedSlot) == 16 &&
+              std::atomic<uint64_t>::is_always_lock_free,
+              "Shared table words must be plain lock-free 64-bit atomics");
+
+class SharedMemoryRateLimiterService
+{
+private:
+    std::string name;
+    void *mapped = nullptr;
+    size_t mappedBytes = 0;
+    SharedTableHeader *header = nullptr;
+    SharedSlot *slots = nullptr;
+    uint64_t mask = 0;
+    std::array<TokenBucketParams, TIER_COUNT> params;
+    Clock *clock;
+
+    static size_t bytesFor(uint64_t capacity)
+    {
+        return sizeof(SharedTableHeader) + capacity * sizeof(SharedSlot);
+    }
+
+    void map(int fd, size_t bytes)
+    {
+        mapped = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            mapped = nullptr;
+            throw std::runtime_error("Cannot map shared rate limit table " + name);
+        }
+        mappedBytes = bytes;
+        header = static_cast<SharedTableHeader *>(mapped);
+        slots = reinterpret_cast<SharedSlot *>(header + 1);
+    }
+
+    void create(int fd, uint64_t capacity)
+    {
+        if (::ftruncate(fd, static_cast<off_t>(bytesFor(capacity))) != 0)
+            throw std::runtime_error("Cannot size shared rate limit table " + name);
+        map(fd, bytesFor(capacity));
+        std::memcpy(header->magic, SharedTableHeader::MAGIC, sizeof(header->magic));
+        header->version = 2;
+        header->capacity = capacity;
+        header->ready.store(1, std::memory_order_release);
+    }
+
+    // Waits for the creator to finish, then maps the size it chose. Returns
+    // false if the segment is still uninitialized after a second: creating
+    // one takes microseconds, so its creator died part way through.
+    bool attach(int fd)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        for (;;)
+        {
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(SharedTableHeader))
+            {
+                map(fd, static_cast<size_t>(st.st_size));
+                if (header->ready.load(std::memory_order_acquire))
+                    break;
+                ::munmap(mapped, mappedBytes);
+                mapped = nullptr;
+            }
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (std::memcmp(header->magic, SharedTableHeader::MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != 2 || header->capacity < 16 || (header->capacity & (header->capacity - 1)) ||
+            bytesFor(header->capacity) > mappedBytes)
+            throw std::runtime_error("Not a version 2 shared rate limit table: " + name);
+        return true;
+    }
+
+    // Unlinks the abandoned segment behind fd, unless another process has
+    // already replaced it under the same name.
+    void unlinkAbandoned(int fd)
+    {
+        struct stat ours, published;
+        int current = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (current < 0)
+            return;
+        bool same = ::fstat(fd, &ours) == 0 && ::fstat(current, &published) == 0 &&
+                    ours.st_dev == published.st_dev && ours.st_ino == published.st_ino;
+        ::close(current);
+        if (same)
+            ::shm_unlink(name.c_str());
+    }
+
+    // The key's slot, claiming an empty one if the key is new.
+    SharedSlot &slotFor(uint64_t hash)
+    {
+        uint64_t i = hash & mask;
+        for (uint64_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask)
+        {
+            SharedSlot &slot = slots[i];
+            uint64_t seen = slot.hash.load(std::memory_order_acquire);
+            if (seen == 0)
+            {
+                if (slot.hash.compare_exchange_strong(seen, hash, std::memory_order_acq_rel))
+                {
+                    header->count.fetch_add(1, std::memory_order_relaxed);
+                    return slot;
+                }
+                // Lost the race; seen now holds the winner's hash.
+            }
+            if (seen == hash)
+                return slot;
+        }
+        throw std::length_error("Shared rate limit table full");
+    }
+
+public:
+    // Opens the segment `name` (e.g. "/ratelimit"), creating it with room
+    // for `capacity` keys if it does not exist. A process that finds it
+    // already created uses the existing size. Create it before forking the
+    // workers, or let the first worker win the race. If the creator died
+    // before marking the segment ready, the next process to open it unlinks
+    // it and creates a new one.
+    SharedMemoryRateLimiterService(const std::string &name, size_t capacity, Clock &clock = systemClock())
+        : name(name), clock(&clock)
+    {
+        for (int t = 0; t < TIER_COUNT; t++)
+            params[t] = TokenBucketParams(TIER_CONFIGS[t].maxRequests,
+                                          TIER_CONFIGS[t].timeWindow.nanos);
+
+        uint64_t slotCount = 16;
+        while (slotCount * 3 < capacity * 4)
+            slotCount <<= 1;
+
+        for (int attempt = 0;; attempt++)
+        {
+            int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            bool creator = fd >= 0;
+            if (!creator && errno == EEXIST)
+                fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0)
+            {
+                // Unlinked between our two opens; create it afresh.
+                if (errno == ENOENT && attempt < 3)
+                    continue;
+                throw std::runtime_error("Cannot open shared rate limit table " + name);
+            }
+            bool attached = true;
+            try
+            {
+                if (creator)
+                    create(fd, slotCount);
+                else if (!(attached = attach(fd)))
+                    unlinkAbandoned(fd);
+            }
+            catch (...)
+            {
+                if (mapped)
+                    ::munmap(mapped, mappedBytes);
+                ::close(fd);
+                if (creator)
+                    ::shm_unlink(name.c_str());
+                throw;
+            }
+            ::close(fd);
+            if (attached)
+                break;
+            if (attempt >= 3)
+                throw std::runtime_error("Shared rate limit table " + name + " was never initialized");
+        }
+        mask = header->capacity - 1;
+    }
+
+    SharedMemoryRateLimiterService(const SharedMemoryRateLimiterService &) = delete;
+    SharedMemoryRateLimiterService &operator=(const SharedMemoryRateLimiterService &) = delete;
+
+    // Unmaps this process's view; the segment lives on until remove().
+    ~SharedMemoryRateLimiterService()
+    {
+        ::munmap(mapped, mappedBytes);
+    }
+
+    static void remove(const std::string &name)
+    {
+        ::shm_unlink(name.c_str());
+    }
+
+    AcquireResult tryAcquire(std::string_view userId, UserType type, uint32_t cost = 1)
+    {
+        int tier = static_cast<int>(type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+        const TokenBucketParams &limit = params[tier];
+        SharedSlot &slot = slotFor(FlatStateTable::hashKey(userId));
+        int64_t now = clock->nowNanos();
+        uint64_t tick = AtomicTokenBucket::toTick(now);
+        uint64_t units = static_cast<uint64_t>(cost) << AtomicTokenBucket::FRACTION_BITS;
+
+        uint64_t stored = slot.word.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            uint64_t current = ~stored;
+            uint64_t base = current == AtomicTokenBucket::EMPTY ? AtomicTokenBucket::initial(limit, tick) : current;
+            uint64_t next = AtomicTokenBucket::refill(base, tick, limit);
+            if (AtomicTokenBucket::tokensOf(next) < units)
+                return AtomicTokenBucket::rejected(base, now, limit, units);
+            next -= units << AtomicTokenBucket::STAMP_BITS;
+            if (slot.word.compare_exchange_weak(stored, ~next, std::memory_order_relaxed,
+                                                std::memory_order_relaxed))
+                return AtomicTokenBucket::admitted(next);
+        }
+    }
+
+    bool handleRequest(std::string_view userId, UserType type)
+    {
+        return tryAcquire(userId, type).allowed;
+    }
+
+    bool handleRequest(const User &user)
+    {
+        return handleRequest(user.userId, user.type);
+    }
+
+    size_t size() const { return header->count.load(std::memory_order_relaxed); }
+    size_t capacity() const { return header->capacity; }
+    size_t memoryBytes() const { return mappedBytes; }
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+//--------------Sliding Window Counter Limiter ------------------
+// Approximates SlidingWindowRateLimiter with two fixed-window counters per
+// key. The previous window's count is weighted by how much of it still
+// overlaps the sliding window ending now:
+//
+//   estimate = previous * (window - elapsedInCurrent) / window + current
+//
+// State is 16 bytes per key and every decision is O(1), instead of one
+// timestamp per accepted request and a pop loop. The estimate assumes the
+// previous window's requests were spread evenly, so it can over- or
+// under-admit slightly when traffic inside a window is very bursty.
+
+// Decision for `cost` more units given the counts of the window containing
+// now (already rolled forward) and now's offset into it. The estimate only
+// falls as the previous window slides out, so the wait is where
+//   previous * (window - t) <= (max - current - cost) * window
+// first holds in this window, or, when current + cost alone is over the
+// limit, the same inequality one window later with current as previous.
+inline AcquireResult slidingWindowCounterAcquire(uint64_t previous, uint64_t current, int64_t elapsed,
+                                                 int maxRequests, int64_t windowNanos, uint32_t cost)
+{
+    using u128 = unsigned __int128;
+    AcquireResult result;
+    uint64_t limit = static_cast<uint64_t>(std::max(maxRequests, 0));
+    u128 window = static_cast<u128>(windowNanos);
+    u128 capacity = static_cast<u128>(limit) * window;
+    u128 used = static_cast<u128>(previous) * static_cast<u128>(windowNanos - elapsed) +
+                static_cast<u128>(current) * window;
+    u128 wanted = used + static_cast<u128>(cost) * window;
+
+    if (limit > 0 && wanted <= capacity)
+    {
+        result.allowed = true;
+        result.remaining = static_cast<int64_t>((capacity - wanted) / window);
+        return result;
+    }
+    result.remaining = used < capacity ? static_cast<int64_t>((capacity - used) / window) : 0;
+    if (cost > limit || limit == 0)
+    {
+        result.retryAfterNanos = AcquireResult::NEVER;
+        return result;
+    }
+    if (current + cost <= limit)
+    {
+        // previous > 0 here, or the request would have been allowed.
+        u128 slack = static_cast<u128>(limit - current - cost) * window;
+        result.retryAfterNanos = windowNanos - static_cast<int64_t>(slack / previous) - elapsed;
+        return result;
+    }
+    u128 slack = static_cast<u128>(limit - cost) * window;
+    result.retryAfterNanos = (windowNanos - elapsed) + windowNanos - static_cast<int64_t>(slack / current);
+    return result;
+}
+
+class SlidingWindowCounterRateLimiter : public RateLimiter
+{
+private:
+    struct WindowState
+    {
+        int64_t windowStart = INT64_MIN;
+        uint32_t current = 0;
+        uint32_t previous = 0;
+    };
+
+    std::unordered_map<std::string, WindowState> windows;
+    int maxRequests;
+    int64_t windowNanos;
+    Clock *clock;
+
+    // State for userId rolled forward to the window that contains nowNanos.
+    WindowState &stateAt(const std::string &userId, int64_t nowNanos, int64_t &start)
+    {
+        WindowState &state = windows[userId];
+        start = nowNanos - nowNanos % windowNanos;
+
+        if (start != state.windowStart)
+        {
+            state.previous = (state.windowStart + windowNanos == start) ? state.current : 0;
+            state.current = 0;
+            state.windowStart = start;
+        }
+        return state;
+    }
+
+public:
+    SlidingWindowCounterRateLimiter(int maxReq, TimeWindow window, Clock &clock = systemClock())
+        : maxRequests(maxReq), windowNanos(window.nanos), clock(&clock)
+    {
+        if (windowNanos <= 0)
+            throw std::invalid_argument("Sliding window must be positive");
+    }
+
+    bool allowRequestAt(const std::string &userId, int64_t nowNanos)
+    {
+        int64_t start;
+        WindowState &state = stateAt(userId, nowNanos, start);
+
+        // (previous * remaining + (current + 1) * window) <= max * window,
+        // kept in integers so no division is needed on the hot path.
+        using u128 = unsigned __int128;
+        u128 remaining = static_cast<u128>(windowNanos - (nowNanos - start));
+        u128 weighted = static_cast<u128>(state.previous) * remaining +
+                        static_cast<u128>(state.current + 1) * static_cast<u128>(windowNanos);
+        if (maxRequests <= 0 ||
+            weighted > static_cast<u128>(maxRequests) * static_cast<u128>(windowNanos))
+            return false;
+
+        state.current++;
+        return true;
+    }
+
+    AcquireResult tryAcquireAt(const std::string &userId, int64_t nowNanos, uint32_t cost)
+    {
+        int64_t start;
+        WindowState &state = stateAt(userId, nowNanos, start);
+        AcquireResult result = slidingWindowCounterAcquire(state.previous, state.current, nowNanos - start,
+                                                           maxRequests, windowNanos, cost);
+        if (result.allowed)
+            state.current += cost;
+        return result;
+    }
+
+    bool allowRequest(const std::string &userId) override
+    {
+        return allowRequestAt(userId, clock->nowNanos());
+    }
+
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override
+    {
+        return tryAcquireAt(userId, clock->nowNanos(), cost);
+    }
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+//--------------Slinding Window Limiter ------------------
+// Keeps one timestamp per charged unit, oldest first, so the wait for a
+// rejected request is read straight off the entry that has to expire.
+class SlidingWindowRateLimiter : public RateLimiter
+{
+private:
+    std::unordered_map<std::string, std::deque<int64_t>> requests;
+    int maxRequests;
+    int64_t windowNanos;
+    Clock *clock;
+
+public:
+    SlidingWindowRateLimiter(int maxReq, TimeWindow window, Clock &clock = systemClock())
+        : maxRequests(maxReq), windowNanos(window.nanos), clock(&clock) {}
+
+    bool allowRequest(const std::string &userId) override
+    {
+        return tryAcquire(userId, 1).allowed;
+    }
+
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override
+    {
+        int64_t now = clock->nowNanos();
+        std::deque<int64_t> &log = requests[userId];
+
+        while (!log.empty() && now - log.front() >= windowNanos)
+            log.pop_front();
+
+        AcquireResult result;
+        int64_t limit = std::max(maxRequests, 0);
+        int64_t used = static_cast<int64_t>(log.size());
+        if (used + cost <= limit)
+        {
+            log.insert(log.end(), cost, now);
+            result.allowed = true;
+            result.remaining = limit - used - cost;
+            return result;
+        }
+        result.remaining = std::max<int64_t>(limit - used, 0);
+        if (cost > limit)
+        {
+            result.retryAfterNanos = AcquireResult::NEVER;
+            return result;
+        }
+        // The (used + cost - limit) oldest units must leave the window.
+        int64_t last = log[used + cost - limit - 1];
+        result.retryAfterNanos = last + windowNanos - now;
+        return result;
+    }
+
+    ~SlidingWindowRateLimiter() = default;
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <sched.h>
+
+//-------------------sloppy counter-----------------------------
+// Token bucket for a few very hot keys that many threads charge at once (a
+// large tenant, a global cap), where even AtomicTokenBucketRateLimiter's
+// single word becomes one contended cache line.
+//
+// Each key has a shared pool, refilled like TokenBucketRateLimiter
+// (maxTokens per window, starting full) but without truncation, and one
+// 64-byte slot per CPU. A decision takes tokens from the slot of the CPU it
+// runs on: an atomic on a line that stays in that core's cache and reads no
+// clock. Only when the slot runs dry does it lock the pool, refill it and
+// move the cost plus `allotment` tokens into the slot, so the pool sees
+// about one decision in `allotment`.
+//
+// Tokens in slots have already left the pool, which bounds the error both
+// ways by slots * allotment, never more than maxOverAdmission: the bound is
+// split into whole tokens per slot, and a bound smaller than the CPU count
+// uses only that many slots (none spare means every charge takes the pool
+// lock, which is exact):
+//
+//   over-admission   tokens moved into a slot in one window can be spent in
+//                    a later one, on top of what the pool hands out then
+//   under-admission  tokens idle in other CPUs' slots are not available to
+//                    a CPU whose slot and the pool are empty
+//
+// maxOverAdmission 0 picks maxTokens / 16; RateLimiterFactory passes the
+// config's maxOverAdmission. Each key costs slots * 64 bytes on top of the
+// limiter's own shard maps (about 2.7 KB per key when RateLimiterService
+// builds a limiter per user), so this is for a handful of hot keys, not
+// per-user state. Thread-safe: keys are found through maps sharded under
+// reader-writer locks, and each thread remembers the last key it charged,
+// so repeated charges to one hot key skip the shard lock.
+class SloppyCounterRateLimiter : public RateLimiter
+{
+private:
+    static constexpr int SHARD_BITS = 4;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<int64_t> tokens{0};
+    };
+
+    struct alignas(64) Key
+    {
+        std::mutex mutex;
+        int64_t pool;
+        int64_t lastRefill;
+        std::atomic<int64_t> poolView; // pool as of the last reconcile, for `remaining`
+        std::unique_ptr<Slot[]> slots;
+
+        Key(int64_t tokens, int64_t now, size_t slotCount)
+            : pool(tokens), lastRefill(now), poolView(tokens), slots(std::make_unique<Slot[]>(slotCount)) {}
+    };
+
+    struct alignas(64) Shard
+    {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<Key>> keys;
+    };
+
+    // A thread's last lookup; `owner` is the limiter's id rather than its
+    // address, so a limiter created where a destroyed one lived never
+    // matches a stale entry.
+    struct LastKey
+    {
+        uint64_t owner = 0;
+        std::string userId;
+        Key *key = nullptr;
+    };
+
+    int64_t maxTokens;
+    int64_t windowNanos;
+    int64_t allotment;
+    size_t slotCount;
+    uint64_t id;
+    std::unique_ptr<Shard[]> shards;
+    Clock *clock;
+
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> ids{1};
+        return ids.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t slotIndex() const
+    {
+        int cpu = sched_getcpu();
+        if (cpu < 0)
+        {
+            static std::atomic<int> threads{0};
+            thread_local int assigned = threads.fetch_add(1, std::memory_order_relaxed);
+            cpu = assigned;
+        }
+        return static_cast<size_t>(cpu) % slotCount;
+    }
+
+    Key &keyFor(const std::string &userId)
+    {
+        thread_local LastKey last;
+        if (last.owner == id && last.userId == userId)
+            return *last.key;
+
+        Shard &shard = shards[(std::hash<std::string>{}(userId) * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS)];
+        Key *key = nullptr;
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            auto it = shard.keys.find(userId);
+            if (it != shard.keys.end())
+                key = it->second.get();
+        }
+        if (!key)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            auto &slot = shard.keys[userId];
+            if (!slot)
+                slot = std::make_unique<Key>(maxTokens, clock->nowNanos(), slotCount);
+            key = slot.get();
+        }
+        last.owner = id;
+        last.userId = userId;
+        last.key = key;
+        return *key;
+    }
+
+    // Adds what accrued since lastRefill; the stamp advances only by the
+    // time the added whole tokens took, so fractions carry over.
+    void refill(Key &key, int64_t now) const
+    {
+        int64_t elapsed = now - key.lastRefill;
+        if (elapsed <= 0)
+            return;
+        if (elapsed >= windowNanos)
+        {
+            key.pool = maxTokens;
+            key.lastRefill = now;
+            return;
+        }
+        int64_t added = static_cast<int64_t>(static_cast<__int128>(elapsed) * maxTokens / windowNanos);
+        if (added == 0)
+            return;
+        if (key.pool + added >= maxTokens)
+        {
+            key.pool = maxTokens;
+            key.lastRefill = now;
+            return;
+        }
+        key.pool += added;
+        key.lastRefill += static_cast<int64_t>(
+            (static_cast<__int128>(added) * windowNanos + maxTokens - 1) / maxTokens);
+    }
+
+    // Slow path: the slot could not cover cost. Its leftover counts toward
+    // cost, and the slot ends with at most allotment tokens.
+    AcquireResult reconcile(Key &key, Slot &slot, uint32_t cost)
+    {
+        int64_t now = clock->nowNanos();
+        std::lock_guard<std::mutex> lock(key.mutex);
+        int64_t left = slot.tokens.exchange(0, std::memory_order_relaxed);
+        int64_t need = cost - left;
+        AcquireResult result;
+        if (need <= 0)
+        {
+            // Another thread on this CPU refilled the slot meanwhile.
+            int64_t kept = slot.tokens.fetch_add(-need, std::memory_order_relaxed) - need;
+            result.allowed = true;
+            result.remaining = key.poolView.load(std::memory_order_relaxed) + kept;
+            return result;
+        }
+        refill(key, now);
+        if (key.pool < need)
+        {
+            slot.tokens.fetch_add(left, std::memory_order_relaxed);
+            result.remaining = key.pool + left;
+            int64_t wait = static_cast<int64_t>(
+                (static_cast<__int128>(need - key.pool) * windowNanos + maxTokens - 1) / maxTokens);
+            result.retryAfterNanos = std::max<int64_t>(key.lastRefill + wait - now, 1);
+            key.poolView.store(key.pool, std::memory_order_relaxed);
+            return result;
+        }
+        int64_t grant = std::min<int64_t>(key.pool, need + allotment);
+        key.pool -= grant;
+        key.poolView.store(key.pool, std::memory_order_relaxed);
+        int64_t kept = slot.tokens.fetch_add(grant - need, std::memory_order_relaxed) + grant - need;
+        result.allowed = true;
+        result.remaining = key.pool + kept;
+        return result;
+    }
+
+public:
+    SloppyCounterRateLimiter(int maxReq, TimeWindow window, int64_t maxOverAdmission = 0,
+                             Clock &clock = systemClock())
+        : maxTokens(std::max(maxReq, 0)), windowNanos(window.nanos), id(nextId()),
+          shards(std::make_unique<Shard[]>(1 << SHARD_BITS)), clock(&clock)
+    {
+        if (windowNanos <= 0)
+            throw std::invalid_argument("Sloppy counter needs a positive window");
+        if (maxOverAdmission < 0)
+            throw std::invalid_argument("Sloppy counter needs a non-negative over-admission bound");
+        if (maxOverAdmission == 0)
+            maxOverAdmission = maxTokens / 16;
+        int64_t cpus = std::max(1u, std::thread::hardware_concurrency());
+        slotCount = static_cast<size_t>(std::clamp<int64_t>(maxOverAdmission, 1, cpus));
+        allotment = maxOverAdmission / static_cast<int64_t>(slotCount);
+    }
+
+    // Bound on over- and under-admission per window, in tokens.
+    int64_t slack() const { return allotment * static_cast<int64_t>(slotCount); }
+
+    bool allowRequest(const std::string &userId) override
+    {
+        return tryAcquire(userId, 1).allowed;
+    }
+
+    // remaining counts the pool as of its last reconcile plus this CPU's
+    // slot; tokens in other slots are not included. A zero cost charges
+    // nothing and reports the refilled pool plus every slot instead.
+    AcquireResult tryAcquire(const std::string &userId, uint32_t cost) override
+    {
+        if (cost > maxTokens)
+            return AcquireResult{false, 0, AcquireResult::NEVER};
+        Key &key = keyFor(userId);
+        if (cost == 0)
+        {
+            std::lock_guard<std::mutex> lock(key.mutex);
+            refill(key, clock->nowNanos());
+            int64_t total = key.pool;
+            for (size_t i = 0; i < slotCount; i++)
+                total += key.slots[i].tokens.load(std::memory_order_relaxed);
+            return AcquireResult{true, total, 0};
+        }
+        Slot &slot = key.slots[slotIndex()];
+        int64_t have = slot.tokens.load(std::memory_order_relaxed);
+        while (have >= cost)
+        {
+            if (slot.tokens.compare_exchange_weak(have, have - cost, std::memory_order_relaxed,
+                                                  std::memory_order_relaxed))
+                return AcquireResult{true, have - cost + key.poolView.load(std::memory_order_relaxed), 0};
+        }
+        return reconcile(key, slot, cost);
+    }
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include "AtomicTokenBucketRateLimiter.h"
+#include "SlidingWindowCounterRateLimiter.h"
+#include "LeakyBucketRateLimiter.h"
+#include <algorithm>
+#include <cstdint>
+
+// ---------------- Slot Algorithms ----------------
+// The limiting algorithms as free functions over two words of inline state,
+// charging `cost` units. A zeroed state is a key that has never been seen,
+// so a zero timestamp alone must not mark a key as new: 0 is a valid time.
+// FlatRateLimiterService calls them with limits read from a runtime config;
+// the StaticLimiter policies call them with compile-time constants, so the
+// compiler folds the limits straight into the decision. When `result` is
+// given it also receives the remaining quota and retry-after, computed the
+// same way as the matching RateLimiter's tryAcquire.
+//
+//   fixedWindow           window start, count (both zero until first use)
+//   slidingWindowCounter  aligned window start, current << 32 | previous
+//   tokenBucket           packed bucket word (AtomicTokenBucket layout), init flag
+//   gcra                  theoretical arrival time
+using SlotState = uint64_t[2];
+
+inline bool fixedWindowDecide(SlotState &state, int64_t now, int maxRequests,
+                              int64_t windowNanos, uint32_t cost = 1,
+                              AcquireResult *result = nullptr)
+{
+    // A window that started at 0 holds a non-zero count once it admitted
+    // anything; one that admitted nothing can be restarted harmlessly.
+    if ((state[0] == 0 && state[1] == 0) || now - static_cast<int64_t>(state[0]) >= windowNanos)
+    {
+        state[0] = static_cast<uint64_t>(now);
+        state[1] = 0;
+    }
+    uint64_t limit = static_cast<uint64_t>(std::max(maxRequests, 0));
+    bool allowed = state[1] + cost <= limit;
+    if (allowed)
+        state[1] += cost;
+    if (result)
+    {
+        result->allowed = allowed;
+        result->remaining = static_cast<int64_t>(limit - std::min(limit, state[1]));
+        result->retryAfterNanos = allowed ? 0
+                                  : cost > limit ? AcquireResult::NEVER
+                                                 : static_cast<int64_t>(state[0]) + windowNanos - now;
+    }
+    return allowed;
+}
+
+inline bool slidingWindowCounterDecide(SlotState &state, int64_t now, int maxRequests,
+                                       int64_t windowNanos, uint32_t cost = 1,
+                                       AcquireResult *result = nullptr)
+{
+    int64_t start = now - now % windowNanos;
+    uint64_t current = state[1] >> 32;
+    uint64_t previous = state[1] & 0xffffffffu;
+    if (static_cast<int64_t>(state[0]) != start)
+    {
+        previous = (static_cast<int64_t>(state[0]) + windowNanos == start) ? current : 0;
+        current = 0;
+        state[0] = static_cast<uint64_t>(start);
+    }
+    bool allowed;
+    if (result)
+    {
+        *result = slidingWindowCounterAcquire(previous, current, now - start, maxRequests, windowNanos, cost);
+        allowed = result->allowed;
+    }
+    else
+    {
+        using u128 = unsigned __int128;
+        u128 remaining = static_cast<u128>(windowNanos - (now - start));
+        u128 weighted = static_cast<u128>(previous) * remaining +
+                        static_cast<u128>(current + cost) * static_cast<u128>(windowNanos);
+        allowed = maxRequests > 0 &&
+                  weighted <= static_cast<u128>(maxRequests) * static_cast<u128>(windowNanos);
+    }
+    if (allowed)
+        current += cost;
+    state[1] = current << 32 | previous;
+    return allowed;
+}
+
+inline bool tokenBucketDecide(SlotState &state, int64_t now, const TokenBucketParams &params,
+                              uint32_t cost = 1, AcquireResult *result = nullptr)
+{
+    if (state[1] == 0)
+    {
+        state[0] = AtomicTokenBucket::initial(params, AtomicTokenBucket::toTick(now));
+        state[1] = 1;
+    }
+    uint64_t units = static_cast<uint64_t>(cost) << AtomicTokenBucket::FRACTION_BITS;
+    if (result)
+    {
+        *result = AtomicTokenBucket::tryAcquire(state[0], now, params, units);
+        return result->allowed;
+    }
+    return AtomicTokenBucket::tryConsume(state[0], AtomicTokenBucket::toTick(now), params, units);
+}
+
+// emissionInterval == INT64_MAX means a zero limit. Burst tolerance is zero,
+// matching LeakyBucketRateLimiter's default, so only a cost of one can pass.
+inline bool gcraDecide(SlotState &state, int64_t now, int64_t emissionInterval, uint32_t cost = 1,
+                       AcquireResult *result = nullptr)
+{
+    int64_t tat = static_cast<int64_t>(state[0]);
+    AcquireResult decision = gcraAcquire(tat, now, emissionInterval, 0, cost);
+    state[0] = static_cast<uint64_t>(tat);
+    if (result)
+        *result = decision;
+    return decision.allowed;
+}
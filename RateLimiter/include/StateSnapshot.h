@@ -0,0 +1,299 @@
+#pragma once
+#include "RateLimiter.h"
+#include "FlatStateTable.h"
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------- State Snapshot ----------------
+// FlatRateLimiterService state in a flat binary layout (host byte order),
+// read in place through mmap. Each shard's slot array and key arena are
+// stored exactly as they sit in memory, so a restart with the same shard
+// count copies them back whole instead of re-inserting every key:
+//
+//   SnapshotHeader
+//   SnapshotShard[shardCount]    where each shard's arrays live
+//   per shard: FlatSlot[capacity], key arena (each 64-byte aligned)
+//   SnapshotConfig[configCount]  the service's interned configs, by index
+//
+// Slot state holds clock timestamps, which only mean something to the clock
+// that wrote them. The header records the boot and the clock reading at
+// save time; a snapshot from another boot, or from ahead of the reader's
+// clock, is not restored.
+struct SnapshotHeader
+{
+    static constexpr uint32_t VERSION = 2;     // 2: windows in nanoseconds
+    static constexpr char MAGIC[8] = {'R', 'L', 'S', 'N', 'A', 'P', '0', '1'};
+    char magic[8];
+    uint32_t version;
+    uint32_t shardCount;
+    uint32_t configCount;
+    uint32_t reserved;
+    uint64_t hashCheck;     // FlatStateTable::hashKey of a fixed string
+    int64_t savedAtNanos;
+    uint8_t bootId[16];
+    uint64_t configsOffset;
+};
+
+struct SnapshotShard
+{
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t keyBytes;
+    uint64_t deadKeyBytes;
+    uint64_t slotsOffset;
+    uint64_t keysOffset;
+};
+
+struct SnapshotConfig
+{
+    int32_t maxRequests;
+    int32_t algorithm;      // AlgorithmType
+    int64_t windowNanos;
+};
+
+static_assert(sizeof(SnapshotHeader) == 64 && sizeof(SnapshotShard) == 48 && sizeof(SnapshotConfig) == 16,
+              "Snapshot layout must not depend on the compiler");
+
+namespace snapshot_io
+{
+    // Detects a snapshot written by a build whose key hash differs.
+    inline uint64_t hashCheck()
+    {
+        return FlatStateTable::hashKey("rate limiter snapshot");
+    }
+
+    // The kernel's per-boot UUID; all zero where it cannot be read.
+    inline void bootId(uint8_t out[16])
+    {
+        std::memset(out, 0, 16);
+        std::ifstream in("/proc/sys/kernel/random/boot_id");
+        std::string text;
+        if (!std::getline(in, text))
+            return;
+        int n = 0;
+        for (size_t i = 0; i + 1 < text.size() && n < 32; i++)
+        {
+            if (text[i] == '-')
+                continue;
+            int digit = std::isdigit(static_cast<unsigned char>(text[i])) ? text[i] - '0' : (text[i] | 0x20) - 'a' + 10;
+            out[n / 2] = static_cast<uint8_t>(out[n / 2] << 4 | (digit & 0xf));
+            n++;
+        }
+    }
+
+    // Flushes the directory holding `path`, so a rename into it survives a
+    // crash.
+    inline bool syncDirectory(const std::string &path)
+    {
+        size_t slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0)
+            return false;
+        bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+}
+
+// Writes a snapshot shard by shard; finish() fills in the header, syncs the
+// temporary file to disk and renames it over `path`, then syncs the
+// directory, so neither readers nor a restart after a crash see a partial
+// one.
+class SnapshotWriter
+{
+private:
+    std::string path;
+    std::string tempPath;
+    FILE *out;
+    std::vector<SnapshotShard> shards;
+    uint64_t offset;
+
+    void write(const void *data, size_t length)
+    {
+        if (length && std::fwrite(data, 1, length, out) != length)
+            throw std::runtime_error("Failed writing snapshot " + tempPath);
+        offset += length;
+    }
+
+    void align()
+    {
+        static const char zeros[64] = {};
+        write(zeros, (64 - offset % 64) % 64);
+    }
+
+public:
+    SnapshotWriter(const std::string &path, uint32_t shardCount)
+        : path(path), tempPath(path + ".tmp"), shards(shardCount), offset(0)
+    {
+        out = std::fopen(tempPath.c_str(), "wb");
+        if (!out)
+            throw std::runtime_error("Cannot create snapshot " + tempPath);
+        std::vector<char> placeholder(sizeof(SnapshotHeader) + shardCount * sizeof(SnapshotShard));
+        write(placeholder.data(), placeholder.size());
+    }
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    ~SnapshotWriter()
+    {
+        if (out)
+        {
+            std::fclose(out);
+            ::unlink(tempPath.c_str());
+        }
+    }
+
+    void addShard(uint32_t index, const FlatSlot *slots, size_t capacity, size_t count,
+                  const char *keys, size_t keyBytes, size_t deadKeyBytes)
+    {
+        SnapshotShard &shard = shards.at(index);
+        shard.capacity = capacity;
+        shard.count = count;
+        shard.keyBytes = keyBytes;
+        shard.deadKeyBytes = deadKeyBytes;
+        align();
+        shard.slotsOffset = offset;
+        write(slots, capacity * sizeof(FlatSlot));
+        align();
+        shard.keysOffset = offset;
+        write(keys, keyBytes);
+    }
+
+    void finish(const std::vector<RateLimitConfig> &configs, int64_t savedAtNanos)
+    {
+        SnapshotHeader header{};
+        std::memcpy(header.magic, SnapshotHeader::MAGIC, sizeof(header.magic));
+        header.version = SnapshotHeader::VERSION;
+        header.shardCount = static_cast<uint32_t>(shards.size());
+        header.configCount = static_cast<uint32_t>(configs.size());
+        header.hashCheck = snapshot_io::hashCheck();
+        header.savedAtNanos = savedAtNanos;
+        snapshot_io::bootId(header.bootId);
+        align();
+        header.configsOffset = offset;
+        for (const RateLimitConfig &config : configs)
+        {
+            SnapshotConfig saved{config.maxRequests, static_cast<int32_t>(config.algorithm), config.timeWindow.nanos};
+            write(&saved, sizeof(saved));
+        }
+
+        if (std::fseek(out, 0, SEEK_SET) != 0)
+            throw std::runtime_error("Failed writing snapshot " + tempPath);
+        write(&header, sizeof(header));
+        write(shards.data(), shards.size() * sizeof(SnapshotShard));
+        FILE *file = out;
+        out = nullptr;
+        bool synced = std::fflush(file) == 0 && ::fsync(::fileno(file)) == 0;
+        if (std::fclose(file) != 0 || !synced || std::rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            ::unlink(tempPath.c_str());
+            throw std::runtime_error("Failed writing snapshot " + path);
+        }
+        if (!snapshot_io::syncDirectory(path))
+            throw std::runtime_error("Failed syncing the directory of snapshot " + path);
+    }
+};
+
+// Maps a snapshot read-only and checks that every table it describes lies
+// inside the file. Slot contents are checked by FlatStateTable::restore.
+class SnapshotReader
+{
+private:
+    const char *base = nullptr;
+    size_t length = 0;
+    const SnapshotHeader *header = nullptr;
+
+public:
+    explicit SnapshotReader(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open snapshot " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader))
+        {
+            ::close(fd);
+            throw std::runtime_error("Snapshot too short: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            throw std::runtime_error("Cannot map snapshot " + path);
+        base = static_cast<const char *>(mapped);
+        ::madvise(mapped, length, MADV_SEQUENTIAL);
+        header = reinterpret_cast<const SnapshotHeader *>(base);
+
+        bool ok = std::memcmp(header->magic, SnapshotHeader::MAGIC, sizeof(header->magic)) == 0 &&
+                  header->version == SnapshotHeader::VERSION &&
+                  inside(sizeof(SnapshotHeader), uint64_t(header->shardCount) * sizeof(SnapshotShard)) &&
+                  inside(header->configsOffset, uint64_t(header->configCount) * sizeof(SnapshotConfig));
+        for (uint32_t i = 0; ok && i < header->shardCount; i++)
+        {
+            const SnapshotShard &s = shard(i);
+            ok = s.capacity < (uint64_t(1) << 40) && inside(s.slotsOffset, s.capacity * sizeof(FlatSlot)) &&
+                 inside(s.keysOffset, s.keyBytes) && s.slotsOffset % alignof(FlatSlot) == 0;
+        }
+        if (!ok)
+        {
+            ::munmap(mapped, length);
+            throw std::runtime_error("Not a version " + std::to_string(SnapshotHeader::VERSION) + " snapshot: " + path);
+        }
+    }
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    ~SnapshotReader()
+    {
+        ::munmap(const_cast<char *>(base), length);
+    }
+
+    bool inside(uint64_t offset, uint64_t bytes) const
+    {
+        return offset <= length && bytes <= length - offset;
+    }
+
+    const SnapshotHeader &getHeader() const { return *header; }
+
+    const SnapshotShard &shard(uint32_t index) const
+    {
+        return reinterpret_cast<const SnapshotShard *>(base + sizeof(SnapshotHeader))[index];
+    }
+
+    const FlatSlot *slots(uint32_t index) const
+    {
+        return reinterpret_cast<const FlatSlot *>(base + shard(index).slotsOffset);
+    }
+
+    const char *keys(uint32_t index) const { return base + shard(index).keysOffset; }
+
+    RateLimitConfig config(uint32_t index) const
+    {
+        const SnapshotConfig &saved = reinterpret_cast<const SnapshotConfig *>(base + header->configsOffset)[index];
+        return RateLimitConfig{saved.maxRequests, TimeWindow::fromNanos(saved.windowNanos),
+                               static_cast<AlgorithmType>(saved.algorithm)};
+    }
+
+    // True when the state was written on this boot, no later than `now` on
+    // the reader's clock, by a build with the same key hash.
+    bool usableAt(int64_t now) const
+    {
+        uint8_t boot[16];
+        snapshot_io::bootId(boot);
+        return header->hashCheck == snapshot_io::hashCheck() && header->savedAtNanos <= now &&
+               std::memcmp(header->bootId, boot, sizeof(boot)) == 0;
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include "RateLimiter.h"
+#include "RateLimitPolicy.h"
+#include "SlotAlgorithms.h"
+#include "FlatStateTable.h"
+#include "Clock.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+// ---------------- Static Limiter ----------------
+// Policy-based limiter for limits known at build time:
+//
+//   Limiter<Algorithm, Clock, Storage>
+//
+// Algorithm  one of the *Policy templates below; limits (window in
+//            nanoseconds) are template arguments, so the decision compiles
+//            to straight-line code
+// Clock      type with a static int64_t now() (nanoseconds)
+// Storage    type with SlotState &stateFor(std::string_view key)
+//
+// No virtual calls and no runtime config lookups. Like the other limiters a
+// Limiter is not synchronized. Configs loaded at runtime keep going through
+// RateLimiterFactory / FlatRateLimiterService.
+
+// ---- algorithms ----
+template <int MaxRequests, int64_t WindowNanos>
+struct FixedWindowPolicy
+{
+    static constexpr int64_t WINDOW_NANOS = WindowNanos;
+    static bool decide(SlotState &state, int64_t now, uint32_t cost = 1, AcquireResult *result = nullptr)
+    {
+        return fixedWindowDecide(state, now, MaxRequests, WINDOW_NANOS, cost, result);
+    }
+};
+
+template <int MaxRequests, int64_t WindowNanos>
+struct SlidingWindowCounterPolicy
+{
+    static_assert(WindowNanos > 0, "Sliding window must be positive");
+    static constexpr int64_t WINDOW_NANOS = WindowNanos;
+    static bool decide(SlotState &state, int64_t now, uint32_t cost = 1, AcquireResult *result = nullptr)
+    {
+        return slidingWindowCounterDecide(state, now, MaxRequests, WINDOW_NANOS, cost, result);
+    }
+};
+
+template <int MaxRequests, int64_t WindowNanos>
+struct TokenBucketPolicy
+{
+    static constexpr TokenBucketParams PARAMS{MaxRequests, WindowNanos};
+    static bool decide(SlotState &state, int64_t now, uint32_t cost = 1, AcquireResult *result = nullptr)
+    {
+        return tokenBucketDecide(state, now, PARAMS, cost, result);
+    }
+};
+
+template <int MaxRequests, int64_t WindowNanos>
+struct LeakyBucketPolicy
+{
+    static_assert(WindowNanos > 0, "Leaky bucket needs a positive window");
+    static constexpr int64_t EMISSION_INTERVAL =
+        MaxRequests > 0 ? WindowNanos / MaxRequests : INT64_MAX;
+    static bool decide(SlotState &state, int64_t now, uint32_t cost = 1, AcquireResult *result = nullptr)
+    {
+        return gcraDecide(state, now, EMISSION_INTERVAL, cost, result);
+    }
+};
+
+// AlgorithmType -> policy, for building limiters from constexpr configs.
+template <AlgorithmType Algorithm, int MaxRequests, int64_t WindowNanos>
+struct PolicyFor;
+
+template <int M, int64_t W>
+struct PolicyFor<AlgorithmType::COUNTER, M, W> { using type = FixedWindowPolicy<M, W>; };
+template <int M, int64_t W>
+struct PolicyFor<AlgorithmType::SLIDING_WINDOW_COUNTER, M, W> { using type = SlidingWindowCounterPolicy<M, W>; };
+template <int M, int64_t W>
+struct PolicyFor<AlgorithmType::TOKEN_BUCKET, M, W> { using type = TokenBucketPolicy<M, W>; };
+template <int M, int64_t W>
+struct PolicyFor<AlgorithmType::ATOMIC_TOKEN_BUCKET, M, W> { using type = TokenBucketPolicy<M, W>; };
+template <int M, int64_t W>
+struct PolicyFor<AlgorithmType::SLOPPY_COUNTER, M, W> { using type = TokenBucketPolicy<M, W>; };
+template <int M, int64_t W>
+struct PolicyFor<AlgorithmType::LEAKY_BUCKET, M, W> { using type = LeakyBucketPolicy<M, W>; };
+
+// ---- clocks ----
+struct MonotonicClock
+{
+    static int64_t now() { return monotonicNanos(); }
+};
+
+// ---- storage ----
+class FlatStorage
+{
+private:
+    FlatStateTable table;
+
+public:
+    SlotState &stateFor(std::string_view key)
+    {
+        uint64_t hash = FlatStateTable::hashKey(key);
+        bool inserted;
+        return table.findOrInsert(key, hash, 0, inserted).state;
+    }
+
+    size_t size() const { return table.size(); }
+};
+
+class MapStorage
+{
+private:
+    struct Entry
+    {
+        SlotState state = {0, 0};
+    };
+    std::unordered_map<std::string, Entry> states;
+
+public:
+    SlotState &stateFor(std::string_view key)
+    {
+        return states[std::string(key)].state;
+    }
+
+    size_t size() const { return states.size(); }
+};
+
+// ---- limiter ----
+template <typename Algorithm, typename Clock = MonotonicClock, typename Storage = FlatStorage>
+class Limiter
+{
+private:
+    Storage storage;
+
+public:
+    bool allowRequest(std::string_view key, uint32_t cost = 1)
+    {
+        return Algorithm::decide(storage.stateFor(key), Clock::now(), cost);
+    }
+
+    AcquireResult tryAcquire(std::string_view key, uint32_t cost = 1)
+    {
+        AcquireResult result;
+        Algorithm::decide(storage.stateFor(key), Clock::now(), cost, &result);
+        return result;
+    }
+
+    Storage &getStorage() { return storage; }
+};
+
+// Limiter for one tier, generated from TIER_CONFIGS.
+template <UserType Tier, typename Clock = MonotonicClock, typename Storage = FlatStorage>
+using TierLimiter = Limiter<
+    typename PolicyFor<RateLimitPolicy::getConfig(Tier).algorithm,
+                       RateLimitPolicy::getConfig(Tier).maxRequests,
+                       RateLimitPolicy::getConfig(Tier).timeWindow.nanos>::type,
+    Clock, Storage>;
+
+// One TierLimiter per entry of TIER_CONFIGS; handleRequest dispatches on the
+// user's tier with a jump over inlined per-tier code instead of a virtual call.
+template <typename Clock = MonotonicClock, typename Storage = FlatStorage>
+class StaticTierService
+{
+private:
+    template <size_t... I>
+    static auto makeLimiters(std::index_sequence<I...>)
+        -> std::tuple<TierLimiter<static_cast<UserType>(I), Clock, Storage>...>;
+
+    using Limiters = decltype(makeLimiters(std::make_index_sequence<TIER_COUNT>{}));
+    Limiters limiters;
+
+    template <size_t I = 0>
+    bool dispatch(int tier, std::string_view userId, uint32_t cost)
+    {
+        if constexpr (I + 1 < TIER_COUNT)
+        {
+            if (tier != static_cast<int>(I))
+                return dispatch<I + 1>(tier, userId, cost);
+        }
+        return std::get<I>(limiters).allowRequest(userId, cost);
+    }
+
+public:
+    bool handleRequest(const User &user, uint32_t cost = 1)
+    {
+        int tier = static_cast<int>(user.type);
+        if (tier < 0 || tier >= TIER_COUNT)
+            throw std::invalid_argument("Unknown user type");
+        return dispatch(tier, user.userId, cost);
+    }
+};
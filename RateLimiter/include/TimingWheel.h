@@ -0,0 +1,222 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// ---------------- Eviction Policy ----------------
+// How a keyed owner (RateLimiterService, RuleEngine) drops state with the
+// wheel below: keys idle for idleTtlNanos expire, and maxTrackedKeys caps
+// live keys by evicting those nearest to idle expiry first.
+struct EvictionPolicy
+{
+    int64_t idleTtlNanos = 0;          // 0 keeps keys forever
+    size_t maxTrackedKeys = 0;         // 0 means no ceiling; needs idleTtlNanos
+    int64_t tickNanos = 1000000000;    // expiry granularity
+};
+
+struct EvictionStats
+{
+    uint64_t expired = 0;
+    uint64_t evictedForCapacity = 0;
+    size_t trackedKeys = 0;
+};
+
+// ---------------- Timing Wheel ----------------
+// Hierarchical timing wheel: LEVELS wheels of 64 slots, level L covering
+// ticks in units of 64^L. An entry goes into the coarsest level it needs and
+// is cascaded one level down when that slot comes due, so scheduling and
+// expiring are O(1) amortized and nothing ever scans all entries.
+//
+// Each level keeps a bitmap of its non-empty slots, so advancing jumps
+// straight to the next tick that has a slot to fire or cascade: a long idle
+// costs a few bit scans per level, not a step per tick.
+//
+// Entries are (key, deadline tick) pairs and cannot be cancelled. Owners
+// reschedule lazily instead: the expiry callback receives the deadline the
+// entry was scheduled with, compares it with the key's current state and
+// returns either a new deadline (keep) or a non-positive value (drop).
+template <typename Key>
+class TimingWheel
+{
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr uint64_t SLOTS = 1ull << SLOT_BITS;
+    static constexpr uint64_t SPAN = 1ull << (SLOT_BITS * LEVELS);
+
+private:
+    struct Entry
+    {
+        Key key;
+        uint64_t deadline;
+    };
+
+    std::vector<Entry> slots[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS] = {};
+    int64_t tickNanos;
+    uint64_t currentTick = 0;
+    bool started = false;
+    size_t count = 0;
+
+    void place(Entry &&entry)
+    {
+        uint64_t deadline = entry.deadline > currentTick ? entry.deadline : currentTick + 1;
+        uint64_t delta = deadline - currentTick;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1))))
+            level++;
+        if (delta >= SPAN)
+            deadline = currentTick + SPAN - 1;
+        uint64_t index = (deadline >> (SLOT_BITS * level)) & (SLOTS - 1);
+        slots[level][index].push_back(std::move(entry));
+        occupied[level] |= 1ull << index;
+    }
+
+    // First tick after currentTick at which level's wheel reaches a
+    // non-empty slot, or UINT64_MAX if it has none.
+    uint64_t nextDue(int level) const
+    {
+        if (!occupied[level])
+            return UINT64_MAX;
+        int shift = SLOT_BITS * level;
+        uint64_t position = (currentTick >> shift) + 1;
+        int rotate = static_cast<int>(position & (SLOTS - 1));
+        uint64_t ahead = rotate ? (occupied[level] >> rotate) | (occupied[level] << (SLOTS - rotate))
+                                : occupied[level];
+        return (position + static_cast<uint64_t>(__builtin_ctzll(ahead))) << shift;
+    }
+
+    template <typename Fn>
+    void fire(int level, uint64_t index, Fn &onExpire)
+    {
+        std::vector<Entry> due;
+        due.swap(slots[level][index]);
+        occupied[level] &= ~(1ull << index);
+        fire(due, onExpire);
+    }
+
+    template <typename Fn>
+    void fire(std::vector<Entry> &due, Fn &onExpire)
+    {
+        for (Entry &entry : due)
+        {
+            if (entry.deadline > currentTick)
+            {
+                place(std::move(entry));
+                continue;
+            }
+            count--;
+            int64_t next = onExpire(entry.key, entry.deadline);
+            if (next > 0)
+                schedule(std::move(entry.key), next);
+        }
+    }
+
+    template <typename Fn>
+    void fireAll(Fn &onExpire)
+    {
+        std::vector<Entry> all;
+        for (auto &level : slots)
+        {
+            for (auto &slot : level)
+            {
+                for (Entry &entry : slot)
+                    all.push_back(std::move(entry));
+                slot.clear();
+            }
+        }
+        std::fill(std::begin(occupied), std::end(occupied), 0);
+        fire(all, onExpire);
+    }
+
+public:
+    explicit TimingWheel(int64_t tickNanos) : tickNanos(tickNanos) {}
+
+    int64_t getTickNanos() const { return tickNanos; }
+    size_t size() const { return count; }
+
+    // Ceiling to whole ticks, so an entry never fires before its deadline.
+    uint64_t toTick(int64_t nanos) const
+    {
+        return static_cast<uint64_t>((nanos + tickNanos - 1) / tickNanos);
+    }
+
+    void schedule(Key key, int64_t deadlineNanos)
+    {
+        count++;
+        place(Entry{std::move(key), toTick(deadlineNanos)});
+    }
+
+    // Fires every entry whose deadline is at or before nowNanos.
+    // onExpire(key, scheduledDeadlineTick) -> new deadline in nanoseconds,
+    // or <= 0 to drop the entry.
+    template <typename Fn>
+    void advance(int64_t nowNanos, Fn onExpire)
+    {
+        uint64_t target = static_cast<uint64_t>(nowNanos / tickNanos);
+        if (!started)
+        {
+            currentTick = target;
+            started = true;
+            return;
+        }
+        if (target > currentTick + SPAN)
+        {
+            // Idle for longer than the wheel covers: every slot has come
+            // due at least once, so fire them all and sort it out.
+            currentTick = target;
+            fireAll(onExpire);
+            return;
+        }
+        while (currentTick < target)
+        {
+            uint64_t next = target;
+            for (int level = 0; level < LEVELS; level++)
+                next = std::min(next, nextDue(level));
+            currentTick = next;
+            for (int level = LEVELS - 1; level > 0; level--)
+            {
+                uint64_t unit = 1ull << (SLOT_BITS * level);
+                if (currentTick % unit == 0)
+                    fire(level, (currentTick >> (SLOT_BITS * level)) & (SLOTS - 1), onExpire);
+            }
+            fire(0, currentTick & (SLOTS - 1), onExpire);
+        }
+    }
+
+    // Fires the entry closest to expiry (exact to the granularity of the slot
+    // it sits in) regardless of the clock; used to shed keys when the owner
+    // is over its memory ceiling. Returns false when the wheel is empty.
+    template <typename Fn>
+    bool expireEarliest(Fn onExpire)
+    {
+        if (count == 0)
+            return false;
+        for (int level = 0; level < LEVELS; level++)
+        {
+            // The slot at the current position has already fired; whatever
+            // it holds now is a full rotation away, so visit it last.
+            uint64_t base = currentTick >> (SLOT_BITS * level);
+            for (uint64_t i = 1; i <= SLOTS; i++)
+            {
+                uint64_t index = (base + i) & (SLOTS - 1);
+                std::vector<Entry> &slot = slots[level][index];
+                if (slot.empty())
+                    continue;
+                Entry entry = std::move(slot.back());
+                slot.pop_back();
+                if (slot.empty())
+                    occupied[level] &= ~(1ull << index);
+                count--;
+                int64_t next = onExpire(entry.key, entry.deadline);
+                if (next > 0)
+                    schedule(std::move(entry.key), next);
+                return true;
+            }
+        }
+        return false;
+    }
+};
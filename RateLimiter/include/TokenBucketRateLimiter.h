@@ -0,0 +1,67 @@
+#pragma once
+#include "RateLimiter.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+//-------------------token-bucket-----------------------------
+// Refills floor(elapsed * maxTokens / window) whole tokens, in integer
+// nanosecond arithmetic, and restarts the refill clock whenever it adds
+// any; the wait for a rejected request is the time the deficit takes.
+class TokenBucketRateLimiter : public RateLimiter {
+private:
+    std::unordered_map<std::string, int> tokens;
+    std::unordered_map<std::string, int64_t> lastRefill;
+
+    int maxTokens;
+    int64_t windowNanos;
+    Clock* clock;
+
+public:
+    TokenBucketRateLimiter(int maxReq, TimeWindow window, Clock& clock = systemClock())
+        : maxTokens(maxReq), windowNanos(window.nanos), clock(&clock) {}
+
+    bool allowRequest(const std::string& userId) override {
+        return tryAcquire(userId, 1).allowed;
+    }
+
+    AcquireResult tryAcquire(const std::string& userId, uint32_t cost) override {
+        int64_t now = clock->nowNanos();
+        if (lastRefill.find(userId) == lastRefill.end()) {
+            tokens[userId] = maxTokens;
+            lastRefill[userId] = now;
+        }
+        // A full window or more refills the bucket; below that the product
+        // fits in 128 bits for any window and token count.
+        int64_t elapsed = now - lastRefill[userId];
+        int64_t newTokens = windowNanos > 0 && elapsed < windowNanos
+                                ? static_cast<int64_t>(static_cast<__int128>(elapsed) * maxTokens / windowNanos)
+                                : maxTokens;
+
+        if (newTokens > 0) {
+            tokens[userId] = static_cast<int>(std::min<int64_t>(maxTokens, tokens[userId] + newTokens));
+            lastRefill[userId] = now;
+        }
+
+        AcquireResult result;
+        int64_t available = tokens[userId];
+        if (available >= cost) {
+            tokens[userId] -= cost;
+            result.allowed = true;
+            result.remaining = available - cost;
+            return result;
+        }
+        result.remaining = std::max<int64_t>(available, 0);
+        if (cost > static_cast<uint32_t>(std::max(maxTokens, 0)) || windowNanos <= 0) {
+            result.retryAfterNanos = AcquireResult::NEVER;
+            return result;
+        }
+        int64_t wait = static_cast<int64_t>(
+            (static_cast<__int128>(cost - available) * windowNanos + maxTokens - 1) / maxTokens);
+        result.retryAfterNanos = lastRefill[userId] + wait - now;
+        return result;
+    }
+
+    ~TokenBucketRateLimiter() = default;
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include "RateLimitPolicy.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------- Trace File ----------------
+// Timestamped request trace in a flat binary layout (host byte order) that
+// is read in place through mmap:
+//
+//   TraceHeader
+//   TraceUser[userCount]      where each user's name lives, and its tier
+//   TraceRecord[recordCount]  one per request, in timestamp order
+//   name bytes                namesBytes of concatenated user ids
+struct TraceHeader
+{
+    static constexpr char MAGIC[8] = {'R', 'L', 'T', 'R', 'A', 'C', 'E', '1'};
+    char magic[8];
+    uint32_t version;
+    uint32_t userCount;
+    uint64_t recordCount;
+    uint64_t namesBytes;
+};
+
+struct TraceUser
+{
+    uint32_t nameOffset;
+    uint16_t nameLength;
+    uint8_t type;       // UserType
+    uint8_t reserved;
+};
+
+struct TraceRecord
+{
+    int64_t timestampNanos;
+    uint32_t user;      // index into the TraceUser table
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TraceHeader) == 32 && sizeof(TraceUser) == 8 && sizeof(TraceRecord) == 16,
+              "Trace layout must not depend on the compiler");
+
+class TraceReader
+{
+private:
+    const char *base = nullptr;
+    size_t length = 0;
+    const TraceHeader *header = nullptr;
+    const TraceUser *userTable = nullptr;
+    const TraceRecord *recordTable = nullptr;
+    const char *names = nullptr;
+
+public:
+    explicit TraceReader(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open trace " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TraceHeader))
+        {
+            ::close(fd);
+            throw std::runtime_error("Trace too short: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            throw std::runtime_error("Cannot map trace " + path);
+        base = static_cast<const char *>(mapped);
+        ::madvise(mapped, length, MADV_SEQUENTIAL);
+
+        header = reinterpret_cast<const TraceHeader *>(base);
+        uint64_t expected = sizeof(TraceHeader) + uint64_t(header->userCount) * sizeof(TraceUser) +
+                            header->recordCount * sizeof(TraceRecord) + header->namesBytes;
+        if (std::memcmp(header->magic, TraceHeader::MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != 1 || expected != length)
+        {
+            ::munmap(mapped, length);
+            throw std::runtime_error("Not a version 1 trace: " + path);
+        }
+        userTable = reinterpret_cast<const TraceUser *>(base + sizeof(TraceHeader));
+        recordTable = reinterpret_cast<const TraceRecord *>(userTable + header->userCount);
+        names = reinterpret_cast<const char *>(recordTable + header->recordCount);
+    }
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    ~TraceReader()
+    {
+        ::munmap(const_cast<char *>(base), length);
+    }
+
+    uint32_t userCount() const { return header->userCount; }
+    uint64_t recordCount() const { return header->recordCount; }
+    const TraceRecord *records() const { return recordTable; }
+
+    std::string_view userName(uint32_t user) const
+    {
+        return std::string_view(names + userTable[user].nameOffset, userTable[user].nameLength);
+    }
+
+    UserType userType(uint32_t user) const
+    {
+        return static_cast<UserType>(userTable[user].type);
+    }
+
+    // Rejects user indices and name ranges that point outside the file, so
+    // the accessors above can skip the checks.
+    void validate() const
+    {
+        for (uint32_t u = 0; u < header->userCount; u++)
+        {
+            if (uint64_t(userTable[u].nameOffset) + userTable[u].nameLength > header->namesBytes ||
+                userTable[u].type >= TIER_COUNT)
+                throw std::runtime_error("Trace user " + std::to_string(u) + " is malformed");
+        }
+        for (uint64_t i = 0; i < header->recordCount; i++)
+        {
+            if (recordTable[i].user >= header->userCount)
+                throw std::runtime_error("Trace record " + std::to_string(i) + " names an unknown user");
+        }
+    }
+};
+
+// Writes a trace; records must already be in timestamp order.
+inline void writeTrace(const std::string &path, const std::vector<std::string> &userNames,
+                       const std::vector<UserType> &userTypes, const std::vector<TraceRecord> &records)
+{
+    if (userNames.size() != userTypes.size())
+        throw std::invalid_argument("Every trace user needs a type");
+    std::vector<TraceUser> users(userNames.size());
+    std::string names;
+    for (size_t u = 0; u < userNames.size(); u++)
+    {
+        if (userNames[u].size() > UINT16_MAX)
+            throw std::invalid_argument("Trace user name too long");
+        users[u] = TraceUser{static_cast<uint32_t>(names.size()), static_cast<uint16_t>(userNames[u].size()),
+                             static_cast<uint8_t>(userTypes[u]), 0};
+        names += userNames[u];
+    }
+
+    TraceHeader header{};
+    std::memcpy(header.magic, TraceHeader::MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.userCount = static_cast<uint32_t>(users.size());
+    header.recordCount = records.size();
+    header.namesBytes = names.size();
+
+    FILE *out = std::fopen(path.c_str(), "wb");
+    if (!out)
+        throw std::runtime_error("Cannot create trace " + path);
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+              std::fwrite(users.data(), sizeof(TraceUser), users.size(), out) == users.size() &&
+              std::fwrite(records.data(), sizeof(TraceRecord), records.size(), out) == records.size() &&
+              std::fwrite(names.data(), 1, names.size(), out) == names.size();
+    if (std::fclose(out) != 0 || !ok)
+        throw std::runtime_error("Failed writing trace " + path);
+}
@@ -0,0 +1,144 @@
+// Load generator for decision_server: closed-loop pipelined clients.
+//
+// Build: make tools   (or g++ -std=c++17 -O2 -pthread tools/decision_loadgen.cpp -o decision_loadgen)
+// Usage: ./decision_loadgen [port=7070] [connections=4] [depth=32] [seconds=5] [users=100000]
+//                           [--host 127.0.0.1] [--batch]
+//
+// Each connection runs on its own thread and keeps `depth` DECIDE requests
+// in flight: it writes them in one go, reads the `depth` replies, and
+// repeats. --batch sends each round as one BATCH frame instead. Users are
+// Zipf-skewed (s = 1.0) with a 70/15/10/5 tier mix. Latency is per request,
+// from the write of its round to the arrival of the round's last reply.
+#include <bits/stdc++.h>
+#include "../include/DecisionServer.h"
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    vector<string> positional;
+    string host = "127.0.0.1";
+    bool batch = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc)
+            host = argv[++i];
+        else if (arg == "--batch")
+            batch = true;
+        else
+            positional.push_back(arg);
+    }
+    uint16_t port = positional.size() > 0 ? static_cast<uint16_t>(stoul(positional[0])) : 7070;
+    int connections = positional.size() > 1 ? stoi(positional[1]) : 4;
+    size_t depth = positional.size() > 2 ? stoull(positional[2]) : 32;
+    double seconds = positional.size() > 3 ? stod(positional[3]) : 5;
+    size_t users = positional.size() > 4 ? stoull(positional[4]) : 100000;
+    depth = min<size_t>(max<size_t>(depth, 1), DecisionRequest::MAX_BATCH);
+
+    mt19937_64 rng(20);
+    discrete_distribution<int> tierMix({70, 15, 10, 5});
+    vector<string> keys(users);
+    vector<uint8_t> types(users);
+    vector<double> cdf(users);
+    double sum = 0;
+    for (size_t u = 0; u < users; u++)
+    {
+        keys[u] = "user_" + to_string(u);
+        types[u] = static_cast<uint8_t>(tierMix(rng));
+        cdf[u] = sum += 1.0 / (u + 1);
+    }
+    vector<uint32_t> stream(1 << 20);
+    uniform_real_distribution<double> pick(0, sum);
+    for (uint32_t &u : stream)
+        u = static_cast<uint32_t>(min<size_t>(lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin(), users - 1));
+
+    atomic<bool> stop{false};
+    vector<vector<uint32_t>> latencies(connections);
+    vector<uint64_t> admitted(connections), decided(connections);
+    vector<thread> pool;
+    for (int c = 0; c < connections; c++)
+    {
+        pool.emplace_back([&, c]
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+            if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+            {
+                cerr << "cannot connect to " << host << ":" << port << "\n";
+                exit(1);
+            }
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            string frame;
+            vector<uint8_t> replies(depth);
+            size_t at = static_cast<size_t>(c) * 104729;
+            while (!stop.load(memory_order_relaxed))
+            {
+                frame.clear();
+                if (batch)
+                {
+                    DecisionRequest header{DecisionRequest::BATCH, 0, 0, static_cast<uint32_t>(depth)};
+                    frame.append(reinterpret_cast<const char *>(&header), sizeof(header));
+                }
+                for (size_t i = 0; i < depth; i++)
+                {
+                    uint32_t u = stream[at++ & (stream.size() - 1)];
+                    uint16_t length = static_cast<uint16_t>(keys[u].size());
+                    if (batch)
+                    {
+                        BatchItem item{types[u], 0, length};
+                        frame.append(reinterpret_cast<const char *>(&item), sizeof(item));
+                    }
+                    else
+                    {
+                        DecisionRequest request{DecisionRequest::DECIDE, types[u], length, 1};
+                        frame.append(reinterpret_cast<const char *>(&request), sizeof(request));
+                    }
+                    frame += keys[u];
+                }
+                auto begin = chrono::steady_clock::now();
+                if (!lease_io::writeAll(fd, frame.data(), frame.size()) ||
+                    !lease_io::readAll(fd, replies.data(), replies.size()))
+                {
+                    cerr << "connection lost\n";
+                    exit(1);
+                }
+                uint32_t ns = static_cast<uint32_t>(min<int64_t>(
+                    chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count(),
+                    UINT32_MAX));
+                latencies[c].push_back(ns);
+                decided[c] += depth;
+                for (uint8_t r : replies)
+                    admitted[c] += r;
+            }
+            ::close(fd);
+        });
+    }
+
+    auto begin = chrono::steady_clock::now();
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    for (thread &th : pool)
+        th.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    // Every request of a round shares the round's latency.
+    vector<uint32_t> all;
+    for (auto &l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    sort(all.begin(), all.end());
+    auto at = [&](double q)
+    { return all.empty() ? 0.0 : all[min(all.size() - 1, static_cast<size_t>(q * all.size()))] / 1000.0; };
+    uint64_t total = accumulate(decided.begin(), decided.end(), uint64_t(0));
+    uint64_t accepted = accumulate(admitted.begin(), admitted.end(), uint64_t(0));
+    cout << fixed << setprecision(2) << connections << " connections x depth " << depth
+         << (batch ? " (batch frames)" : " (pipelined)") << ": " << total / elapsed / 1e6 << " M decisions/s, "
+         << 100.0 * accepted / max<uint64_t>(total, 1) << "% admitted\n"
+         << "latency us: p50 " << at(0.5) << "  p99 " << at(0.99) << "  p99.9 " << at(0.999) << "  max "
+         << (all.empty() ? 0.0 : all.back() / 1000.0) << "\n";
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Rate-limiter sidecar: serves RateLimiterService decisions over TCP with
+// the DecisionServer binary protocol.
+//
+// Build: make tools   (or g++ -std=c++17 -O2 -pthread tools/decision_server.cpp -o decision_server)
+// Usage: ./decision_server [port=7070] [loops=cores] [--host 127.0.0.1] [--policy FILE]
+//                          [--prefilter MiB] [--idle-ttl seconds]
+//
+// --policy loads a tier policy (see policy.conf) at start and again on
+// SIGHUP. Serves until SIGINT or SIGTERM, then prints decision counts and
+// the service's metrics.
+#include <bits/stdc++.h>
+#include <csignal>
+#include "../include/DecisionServer.h"
+using namespace std;
+
+static volatile sig_atomic_t stopRequested = 0, reloadRequested = 0;
+
+static void onStop(int) { stopRequested = 1; }
+static void onReload(int) { reloadRequested = 1; }
+
+int main(int argc, char **argv)
+{
+    vector<string> positional;
+    string host = "127.0.0.1", policyPath;
+    size_t prefilterMiB = 0;
+    int64_t idleTtlSeconds = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--host" && i + 1 < argc)
+            host = argv[++i];
+        else if (arg == "--policy" && i + 1 < argc)
+            policyPath = argv[++i];
+        else if (arg == "--prefilter" && i + 1 < argc)
+            prefilterMiB = stoull(argv[++i]);
+        else if (arg == "--idle-ttl" && i + 1 < argc)
+            idleTtlSeconds = stoll(argv[++i]);
+        else if (arg.rfind("--", 0) == 0)
+        {
+            cerr << "unknown flag " << arg << "\n";
+            return 2;
+        }
+        else
+            positional.push_back(arg);
+    }
+    uint16_t port = positional.size() > 0 ? static_cast<uint16_t>(stoul(positional[0])) : 7070;
+    size_t loops = positional.size() > 1 ? stoull(positional[1]) : max(1u, thread::hardware_concurrency());
+
+    PolicyStore &policies = PolicyStore::global();
+    if (!policyPath.empty())
+        policies.loadFile(policyPath);
+
+    EvictionPolicy eviction;
+    eviction.idleTtlNanos = idleTtlSeconds * 1000000000;
+    PrefilterPolicy prefilter;
+    prefilter.sketchBytes = prefilterMiB << 20;
+    RateLimiterService service(RateLimiterService::defaultShardCount(), eviction, systemClock(), policies, prefilter);
+
+    DecisionServer server(service, host, port, loops);
+    signal(SIGINT, onStop);
+    signal(SIGTERM, onStop);
+    signal(SIGHUP, onReload);
+    server.start();
+    cerr << "serving decisions on " << host << ":" << server.port() << " with " << loops << " loops\n";
+
+    while (!stopRequested)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        if (reloadRequested)
+        {
+            reloadRequested = 0;
+            if (policyPath.empty())
+                continue;
+            try
+            {
+                policies.loadFile(policyPath);
+                cerr << "reloaded " << policyPath << " (policy version " << policies.version() << ")\n";
+            }
+            catch (const exception &e)
+            {
+                cerr << "kept the current policy: " << e.what() << "\n";
+            }
+        }
+    }
+    server.stop();
+
+    DecisionServer::Stats stats = server.getStats();
+    cerr << stats.decisions << " decisions on " << stats.connections << " connections, " << stats.dropped
+         << " dropped for malformed frames\n";
+    cout << service.getMetrics().dump();
+    return 0;
+}
@@ -0,0 +1,40 @@
+// Central quota server for LeasedRateLimiterService nodes.
+//
+// Build: make tools   (or g++ -std=c++17 -O2 -pthread tools/quota_server.cpp -o quota_server)
+// Usage: ./quota_server SOCKET_PATH [leaseTtlMs=200]
+//
+// Serves until SIGINT or SIGTERM, then prints lease and return counts.
+#include <bits/stdc++.h>
+#include <csignal>
+#include "../include/QuotaLease.h"
+using namespace std;
+
+static QuotaServer *server = nullptr;
+
+static void onSignal(int)
+{
+    if (server)
+        server->stop();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cerr << "usage: " << argv[0] << " SOCKET_PATH [leaseTtlMs]\n";
+        return 2;
+    }
+    int64_t ttlMs = argc > 2 ? stoll(argv[2]) : 200;
+
+    QuotaServer quota(argv[1], ttlMs * 1000000);
+    server = &quota;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    cerr << "serving quota on " << argv[1] << " (lease TTL " << ttlMs << " ms)\n";
+    quota.run();
+
+    const QuotaServer::Stats &stats = quota.getStats();
+    cerr << stats.leases << " leases (" << stats.tokensGranted << " tokens), "
+         << stats.returns << " returns (" << stats.tokensReturned << " tokens)\n";
+    return 0;
+}